@@ -3,8 +3,23 @@
 
 #pragma region DEV
 
+#include <atomic>
 #include <fcntl.h>
 
+/**
+ * System calls the driver makes itself (SPI transfers, GPIO value and event
+ * I/O, sleeps, block handoff), counted at each call site through
+ * DEV_Syscall. Process-wide; calls inside bcm2835/wiringPi are not seen
+**/
+static std::atomic<uint64_t> DEV_Syscalls{ 0 };
+
+template <typename T>
+static inline T DEV_Syscall(T ret)
+{
+    DEV_Syscalls.fetch_add(1, std::memory_order_relaxed);
+    return ret;
+}
+
 /**
  * GPIO
 **/
@@ -13,341 +28,997 @@ int DEV_CS_PIN;
 int DEV_DRDY_PIN;
 
 /**
- * GPIO read and write
+ * One ADS1263 connection: SPI device, pin set and the GPIO lines requested for it
 **/
-void DEV_Digital_Write(UWORD Pin, UBYTE Value)
-{
-#ifdef RPI
-#ifdef USE_BCM2835_LIB
-    bcm2835_gpio_write(Pin, Value);
-#elif USE_WIRINGPI_LIB
-    digitalWrite(Pin, Value);
-#elif USE_DEV_LIB
-    SYSFS_GPIO_Write(Pin, Value);
-#endif
-#endif
-
-#ifdef JETSON
-#ifdef USE_DEV_LIB
-    SYSFS_GPIO_Write(Pin, Value);
-#elif USE_HARDWARE_LIB
-    Debug("not support");
-#endif
-#endif
-}
+struct DEV_PORT {
+    HARDWARE_SPI* spi;          // spidev; the library bus for bcm2835/wiringPi
+    int rst;
+    int cs;
+    int drdy;
+    UBYTE native_cs;            // see DEV_SPI_NATIVE_CS
+    DEV_BUS* bus;               // arbiter the transactions go through, NULL: caller's thread
+    GPIOCHIP_LINES gpio;        // DEV_BACKEND_SPIDEV_CHARDEV
+    HARDWARE_SPI own_spi;       // spidev opened by DEV_Port_Open
+    SIM_ADS1263* sim;           // DEV_BACKEND_SIM: chip behind the port
+    UBYTE own_sim;              // sim was created by DEV_Port_Open
+    DEV_BACKEND backend;        // resolved, never DEV_BACKEND_DEFAULT
+    GPIOMEM_MAP mem;            // DEV_BACKEND_SPIDEV_GPIOMEM
+};
 
-UBYTE DEV_Digital_Read(UWORD Pin)
-{
-    UBYTE Read_value = 0;
-#ifdef RPI
-#ifdef USE_BCM2835_LIB
-    Read_value = bcm2835_gpio_lev(Pin);
-#elif USE_WIRINGPI_LIB
-    Read_value = digitalRead(Pin);
-#elif USE_DEV_LIB
-    Read_value = SYSFS_GPIO_Read(Pin);
-#endif
-#endif
+/**
+ * Port set up by DEV_Module_Init, used by the DEV_* functions
+**/
+static DEV_PORT DEV_Default = { &hardware_SPI, 0, 0, 0, DEV_SPI_NATIVE_CS, NULL, { -1, -1, -1, -1, -1 }, {}, NULL, 0, DEV_BACKEND_DEFAULT, { NULL, -1, GPIOMEM_LAYOUT_AUTO, 0 } };
 
-#ifdef JETSON
-#ifdef USE_DEV_LIB
-    Read_value = SYSFS_GPIO_Read(Pin);
-#elif USE_HARDWARE_LIB
-    Debug("not support");
-#endif
+/**
+ * Backend used for DEV_BACKEND_DEFAULT: the build flags pick it, DEV_SetBackend overrides it
+**/
+#if defined(SIM)
+static const DEV_BACKEND DEV_Backend_Build = DEV_BACKEND_SIM;
+#elif defined(USE_BCM2835_LIB)
+static const DEV_BACKEND DEV_Backend_Build = DEV_BACKEND_BCM2835;
+#elif defined(USE_WIRINGPI_LIB)
+static const DEV_BACKEND DEV_Backend_Build = DEV_BACKEND_WIRINGPI;
+#elif defined(USE_GPIOCHIP)
+static const DEV_BACKEND DEV_Backend_Build = DEV_BACKEND_SPIDEV_CHARDEV;
+#elif defined(USE_GPIOMEM)
+static const DEV_BACKEND DEV_Backend_Build = DEV_BACKEND_SPIDEV_GPIOMEM;
+#else
+static const DEV_BACKEND DEV_Backend_Build = DEV_BACKEND_SPIDEV_SYSFS;
 #endif
-    return Read_value;
-}
+static DEV_BACKEND DEV_Backend_Default = DEV_Backend_Build;
 
 /**
- * SPI
+ * Backend policies. Each one is a set of static inline functions:
+ *   GPIO: Init, Exit, Mode, Write, Read, WaitFalling
+ *   SPI : Init, Exit, Transfer
+ * DEV_BACKEND_T pairs an SPI policy with a GPIO policy; the DEV_Port_*
+ * functions switch on port->backend once and run the instantiation for it,
+ * so a whole transaction (CS, transfer, CS) is inlined per backend.
 **/
-UBYTE DEV_SPI_WriteByte(uint8_t Value)
-{
-    UBYTE temp = 0;
-    // printf("write %x \r\n", Value);
-#ifdef RPI
-#ifdef USE_BCM2835_LIB
-    temp = bcm2835_spi_transfer(Value);
-#elif USE_WIRINGPI_LIB
-    wiringPiSPIDataRW(0, &Value, 1);
-    temp = Value;
-#elif USE_DEV_LIB
-    temp = DEV_HARDWARE_SPI_TransferByte(Value);
-#endif
-#endif
 
-#ifdef JETSON
-#ifdef USE_DEV_LIB
-    temp = SYSFS_software_spi_transfer(Value);
-#elif USE_HARDWARE_LIB
-    Debug("not support");
-#endif
-#endif
-    // printf("Read %x \r\n", temp);
-    return temp;
-}
+/**
+ * GPIO through /sys/class/gpio, one cached value fd per pin
+**/
+struct DEV_GPIO_SYSFS {
+    static inline void Mode(DEV_PORT*, UWORD Pin, UWORD Mode)
+    {
+        SYSFS_GPIO_Export(Pin);
+        if (Mode == 0 || Mode == SYSFS_GPIO_IN) {
+            SYSFS_GPIO_Direction(Pin, SYSFS_GPIO_IN);
+            SYSFS_GPIO_Open(Pin, SYSFS_GPIO_IN);
+        }
+        else {
+            SYSFS_GPIO_Direction(Pin, SYSFS_GPIO_OUT);
+            SYSFS_GPIO_Open(Pin, SYSFS_GPIO_OUT);
+        }
+    }
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG*)
+    {
+        Mode(port, port->rst, 1);
+        Mode(port, port->cs, 1);
+        Mode(port, port->drdy, 0);
+        return 0;
+    }
+    static inline void Exit(DEV_PORT* port)
+    {
+        SYSFS_GPIO_Close(port->rst);
+        SYSFS_GPIO_Close(port->cs);
+        SYSFS_GPIO_Close(port->drdy);
+    }
+    static inline void Write(DEV_PORT*, UWORD Pin, UBYTE Value)
+    {
+        SYSFS_GPIO_Write(Pin, Value);
+    }
+    static inline UBYTE Read(DEV_PORT*, UWORD Pin)
+    {
+        return SYSFS_GPIO_Read(Pin);
+    }
+    // no edge events, the level is polled
+    static inline int WaitFalling(DEV_PORT*, UWORD, uint64_t, uint64_t*)
+    {
+        return -1;
+    }
+};
 
-UBYTE DEV_SPI_ReadByte()
-{
-    return DEV_SPI_WriteByte(0x00);
-}
+/**
+ * GPIO character device, see the GPIOCHIP region
+**/
+struct DEV_GPIO_CHARDEV {
+    static inline void Mode(DEV_PORT*, UWORD, UWORD)
+    {
+        // directions are fixed by the line request
+    }
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG* config)
+    {
+        const char* chip = config->GpioChip != NULL ? config->GpioChip : getenv("ADS1263_GPIOCHIP");
+        if (GPIOCHIP_Lines_Open(&port->gpio, chip != NULL ? chip : GPIOCHIP_DEVICE, port->rst, port->cs, port->drdy) < 0) {
+            printf("gpiochip request failed !!! \r\n");
+            return -1;
+        }
+        return 0;
+    }
+    static inline void Exit(DEV_PORT* port)
+    {
+        GPIOCHIP_Lines_Close(&port->gpio);
+    }
+    static inline void Write(DEV_PORT* port, UWORD Pin, UBYTE Value)
+    {
+        GPIOCHIP_Lines_Write(&port->gpio, Pin, Value);
+    }
+    static inline UBYTE Read(DEV_PORT* port, UWORD Pin)
+    {
+        return GPIOCHIP_Lines_Read(&port->gpio, Pin);
+    }
+    // sleep until the kernel reports the edge, its timestamp is the DRDY time
+    static inline int WaitFalling(DEV_PORT* port, UWORD Pin, uint64_t DeadlineNs, uint64_t* TimestampNs)
+    {
+        return GPIOCHIP_Lines_WaitLow(&port->gpio, Pin, DeadlineNs, TimestampNs) == 0 ? 0 : -1;
+    }
+};
 
 /**
- * GPIO Mode
+ * GPIO registers mapped from /dev/gpiomem, see the GPIOMEM region.
+ * No edge events either, but a poll of DRDY is a load, not a syscall
 **/
-void DEV_GPIO_Mode(UWORD Pin, UWORD Mode)
-{
-#ifdef RPI
-#ifdef USE_BCM2835_LIB
-    if (Mode == 0 || Mode == BCM2835_GPIO_FSEL_INPT) {
-        bcm2835_gpio_fsel(Pin, BCM2835_GPIO_FSEL_INPT);
+struct DEV_GPIO_GPIOMEM {
+    static inline void Mode(DEV_PORT* port, UWORD Pin, UWORD Mode)
+    {
+        GPIOMEM_Map_Mode(&port->mem, Pin, Mode != 0);
     }
-    else {
-        bcm2835_gpio_fsel(Pin, BCM2835_GPIO_FSEL_OUTP);
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG* config)
+    {
+        const char* path = config->GpioMem != NULL ? config->GpioMem : getenv("ADS1263_GPIOMEM");
+        if (port->mem.base == NULL
+            && GPIOMEM_Map_Open(&port->mem, path != NULL ? path : GPIOMEM_DEVICE, GPIOMEM_LAYOUT_AUTO) < 0) {
+            return -1;
+        }
+        Mode(port, port->rst, 1);
+        Mode(port, port->cs, 1);
+        Mode(port, port->drdy, 0);
+        return 0;
     }
-#elif USE_WIRINGPI_LIB
-    if (Mode == 0 || Mode == INPUT) {
-        pinMode(Pin, INPUT);
-        pullUpDnControl(Pin, PUD_UP);
+    static inline void Exit(DEV_PORT* port)
+    {
+        GPIOMEM_Map_Close(&port->mem);
     }
-    else {
-        pinMode(Pin, OUTPUT);
-        // Debug (" %d OUT \r\n",Pin);
+    static inline void Write(DEV_PORT* port, UWORD Pin, UBYTE Value)
+    {
+        GPIOMEM_Map_Write(&port->mem, Pin, Value);
     }
-#elif USE_DEV_LIB
-    SYSFS_GPIO_Export(Pin);
-    if (Mode == 0 || Mode == SYSFS_GPIO_IN) {
-        SYSFS_GPIO_Direction(Pin, SYSFS_GPIO_IN);
-        // Debug("IN Pin = %d\r\n",Pin);
+    static inline UBYTE Read(DEV_PORT* port, UWORD Pin)
+    {
+        return GPIOMEM_Map_Read(&port->mem, Pin) != 0;
     }
-    else {
-        SYSFS_GPIO_Direction(Pin, SYSFS_GPIO_OUT);
-        // Debug("OUT Pin = %d\r\n",Pin);
+    static inline int WaitFalling(DEV_PORT*, UWORD, uint64_t, uint64_t*)
+    {
+        return -1;
     }
-#endif
-#endif
+};
 
-#ifdef JETSON
-#ifdef USE_DEV_LIB
-    SYSFS_GPIO_Export(Pin);
-    SYSFS_GPIO_Direction(Pin, Mode);
-#elif USE_HARDWARE_LIB
-    Debug("not support");
-#endif
-#endif
-}
+/**
+ * spidev. The DEV_Module_Init port keeps using hardware_SPI, which the
+ * DEV_HARDWARE_SPI_* calls act on; other ports open their own fd
+**/
+struct DEV_SPI_SPIDEV {
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG* config)
+    {
+        const char* device = config->SpiDevice != NULL ? config->SpiDevice : "/dev/spidev0.0";
+        UDOUBLE speed = config->Speed != 0 ? config->Speed : 1000000;
+        if (port == &DEV_Default) {
+            printf("Write and read %s \r\n", device);
+            DEV_HARDWARE_SPI_begin((char*)device);
+            DEV_HARDWARE_SPI_setSpeed(speed);
+            DEV_HARDWARE_SPI_Mode(SPI_MODE_1);
+            port->spi = &hardware_SPI;
+            return 0;
+        }
+        if (DEV_HARDWARE_SPI_Open(&port->own_spi, device, SPI_MODE1, speed) < 0) {
+            printf("Open %s failed !!! \r\n", device);
+            return -1;
+        }
+        port->spi = &port->own_spi;
+        return 0;
+    }
+    static inline void Exit(DEV_PORT* port)
+    {
+        if (port->spi == &port->own_spi)
+            DEV_HARDWARE_SPI_Close(&port->own_spi);
+        else if (port == &DEV_Default)
+            DEV_HARDWARE_SPI_end();
+        port->spi = &hardware_SPI;
+    }
+    static inline int Transfer(DEV_PORT* port, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+    {
+        return DEV_HARDWARE_SPI_TransferOn(port->spi, TxBuf, RxBuf, Len) < 0 ? -1 : 0;
+    }
+};
 
 /**
- * delay x ms
+ * In-process chip (SIM region). The GPIO half attaches it to the port
 **/
-void DEV_Delay_ms(UDOUBLE xms)
-{
-#ifdef RPI
-#ifdef USE_BCM2835_LIB
-    bcm2835_delay(xms);
-#elif USE_WIRINGPI_LIB
-    delay(xms);
-#elif USE_DEV_LIB
-    UDOUBLE i;
-    for (i = 0; i < xms; i++) {
-        usleep(1000);
+struct DEV_GPIO_SIM {
+    static inline void Mode(DEV_PORT*, UWORD, UWORD)
+    {
     }
-#endif
-#endif
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG* config)
+    {
+        port->sim = config->Sim;
+        if (port->sim == NULL) {
+            port->sim = SIM_Create(0);
+            if (port->sim == NULL)
+                return -1;
+            port->own_sim = 1;
+        }
+        return 0;
+    }
+    static inline void Exit(DEV_PORT* port)
+    {
+        if (port->own_sim)
+            SIM_Destroy(port->sim);
+        port->sim = NULL;
+        port->own_sim = 0;
+    }
+    static inline void Write(DEV_PORT* port, UWORD Pin, UBYTE Value)
+    {
+        if (Pin == port->rst)
+            SIM_Pin_Write(port->sim, SIM_PIN_RST, Value);
+        else if (Pin == port->cs)
+            SIM_Pin_Write(port->sim, SIM_PIN_CS, Value);
+    }
+    static inline UBYTE Read(DEV_PORT* port, UWORD Pin)
+    {
+        return SIM_Pin_Read(port->sim, Pin == port->drdy ? SIM_PIN_DRDY : Pin == port->rst ? SIM_PIN_RST : SIM_PIN_CS);
+    }
+    static inline int WaitFalling(DEV_PORT* port, UWORD, uint64_t DeadlineNs, uint64_t* TimestampNs)
+    {
+        return SIM_WaitDRDY(port->sim, DeadlineNs, TimestampNs);
+    }
+};
 
-#ifdef JETSON
-    UDOUBLE i;
-    for (i = 0; i < xms; i++) {
-        usleep(1000);
+struct DEV_SPI_SIM {
+    static inline int Init(DEV_PORT*, const ADS1263_PORT_CONFIG*)
+    {
+        printf("Simulated ADS1263 \r\n");
+        return 0;
     }
-#endif
-}
+    static inline void Exit(DEV_PORT*)
+    {
+    }
+    static inline int Transfer(DEV_PORT* port, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+    {
+        return SIM_Transfer(port->sim, TxBuf, RxBuf, Len);
+    }
+};
 
-static int DEV_Equipment_Testing()
-{
-    int i;
-    int fd;
-    char value_str[20];
-    fd = open("/etc/issue", O_RDONLY);
-    printf("Current environment: ");
-    while (1) {
-        if (fd < 0) {
-            Debug("Read failed Pin\n");
-            return -1;
+#ifdef USE_BCM2835_LIB
+/**
+ * bcm2835 library: one bus and one GPIO block for the whole process, so only
+ * the DEV_Module_Init port initializes and closes the library
+**/
+struct DEV_GPIO_BCM2835 {
+    static inline void Mode(DEV_PORT*, UWORD Pin, UWORD Mode)
+    {
+        if (Mode == 0 || Mode == BCM2835_GPIO_FSEL_INPT) {
+            bcm2835_gpio_fsel(Pin, BCM2835_GPIO_FSEL_INPT);
+        }
+        else {
+            bcm2835_gpio_fsel(Pin, BCM2835_GPIO_FSEL_OUTP);
         }
-        for (i = 0;; i++) {
-            if (read(fd, &value_str[i], 1) < 0) {
-                Debug("failed to read value!\n");
+    }
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG*)
+    {
+        if (port == &DEV_Default) {
+            if (!bcm2835_init()) {
+                printf("bcm2835 init failed  !!! \r\n");
                 return -1;
             }
-            if (value_str[i] == 32) {
-                printf("\r\n");
-                break;
-            }
-            printf("%c", value_str[i]);
+            printf("bcm2835 init success !!! \r\n");
         }
-        break;
+        Mode(port, port->rst, 1);
+        Mode(port, port->cs, 1);
+        Mode(port, port->drdy, 0);
+        return 0;
     }
-#ifdef RPI
-    if (i < 5) {
-        printf("Unrecognizable\r\n");
+    static inline void Exit(DEV_PORT* port)
+    {
+        if (port == &DEV_Default)
+            bcm2835_close();
     }
-    else {
-        char RPI_System[10] = { "Raspbian" };
-        for (i = 0; i < 6; i++) {
-            if (RPI_System[i] != value_str[i]) {
-                printf("Please make JETSON !!!!!!!!!!\r\n");
-                return -1;
-            }
+    static inline void Write(DEV_PORT*, UWORD Pin, UBYTE Value)
+    {
+        bcm2835_gpio_write(Pin, Value);
+    }
+    static inline UBYTE Read(DEV_PORT*, UWORD Pin)
+    {
+        return bcm2835_gpio_lev(Pin);
+    }
+    static inline int WaitFalling(DEV_PORT*, UWORD, uint64_t, uint64_t*)
+    {
+        return -1;
+    }
+};
+
+struct DEV_SPI_BCM2835 {
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG*)
+    {
+        if (port == &DEV_Default) {
+            bcm2835_spi_begin();                                         //Start spi interface, set spi pin for the reuse function
+            bcm2835_spi_setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);     //High first transmission
+            bcm2835_spi_setDataMode(BCM2835_SPI_MODE1);                  //spi mode 1, '0, 1'
+            bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_32);  //Frequency
+        }
+        return 0;
+    }
+    static inline void Exit(DEV_PORT* port)
+    {
+        if (port == &DEV_Default)
+            bcm2835_spi_end();
+    }
+    static inline int Transfer(DEV_PORT*, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+    {
+        UBYTE zero[ADS1263_MAX_FRAME_LEN];
+        if ((TxBuf == NULL || RxBuf == NULL) && Len > sizeof(zero)) {
+            printf("bcm2835 transfer of %u bytes too long !!! \r\n", (unsigned)Len);
+            return -1;
+        }
+        if (TxBuf == NULL) {
+            memset(zero, 0, Len);
+            TxBuf = zero;
+        }
+        if (RxBuf == NULL) {
+            RxBuf = zero;
         }
+        bcm2835_spi_transfernb((char*)TxBuf, (char*)RxBuf, Len);
+        return 0;
     }
+};
 #endif
-#ifdef JETSON
-    if (i < 5) {
-        Debug("Unrecognizable\r\n");
+
+#ifdef USE_WIRINGPI_LIB
+/**
+ * wiringPi library, BCM pin numbering, SPI channel 0 shared by all ports
+**/
+struct DEV_GPIO_WIRINGPI {
+    static inline void Mode(DEV_PORT*, UWORD Pin, UWORD Mode)
+    {
+        if (Mode == 0 || Mode == INPUT) {
+            pinMode(Pin, INPUT);
+            pullUpDnControl(Pin, PUD_UP);
+        }
+        else {
+            pinMode(Pin, OUTPUT);
+        }
     }
-    else {
-        char JETSON_System[10] = { "Ubuntu" };
-        for (i = 0; i < 6; i++) {
-            if (JETSON_System[i] != value_str[i]) {
-                printf("Please make RPI !!!!!!!!!!\r\n");
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG*)
+    {
+        if (port == &DEV_Default) {
+            // if(wiringPiSetup() < 0) {//use wiringpi Pin number table
+            if (wiringPiSetupGpio() < 0) { //use BCM2835 Pin number table
+                printf("set wiringPi lib failed	!!! \r\n");
                 return -1;
             }
+            printf("set wiringPi lib success !!! \r\n");
         }
+        Mode(port, port->rst, 1);
+        Mode(port, port->cs, 1);
+        Mode(port, port->drdy, 0);
+        return 0;
     }
-#endif
-    return 0;
-}
-
-void DEV_GPIO_Init()
-{
-#ifdef RPI
-    DEV_RST_PIN = 18;
-    DEV_CS_PIN = 22;
-    DEV_DRDY_PIN = 17;
-#elif JETSON
-    DEV_RST_PIN = GPIO18;
-    DEV_CS_PIN = GPIO22;
-    DEV_DRDY_PIN = GPIO17;
-#endif
-
-    DEV_GPIO_Mode(DEV_RST_PIN, 1);
-    DEV_GPIO_Mode(DEV_CS_PIN, 1);
-
-    DEV_GPIO_Mode(DEV_DRDY_PIN, 0);
-
-    DEV_Digital_Write(DEV_CS_PIN, 1);
-}
-
-/******************************************************************************
-function:	Module Initialize, the library and initialize the pins, SPI protocol
-parameter:
-Info:
-******************************************************************************/
-UBYTE DEV_Module_Init()
-{
-    printf("/***********************************/ \r\n");
-    if (DEV_Equipment_Testing() < 0) {
-        return 1;
+    static inline void Exit(DEV_PORT*)
+    {
     }
-#ifdef RPI
-#ifdef USE_BCM2835_LIB
-    if (!bcm2835_init()) {
-        printf("bcm2835 init failed  !!! \r\n");
-        return 1;
+    static inline void Write(DEV_PORT*, UWORD Pin, UBYTE Value)
+    {
+        digitalWrite(Pin, Value);
     }
-    else {
-        printf("bcm2835 init success !!! \r\n");
+    static inline UBYTE Read(DEV_PORT*, UWORD Pin)
+    {
+        return digitalRead(Pin);
+    }
+    static inline int WaitFalling(DEV_PORT*, UWORD, uint64_t, uint64_t*)
+    {
+        return -1;
     }
+};
+
+struct DEV_SPI_WIRINGPI {
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG* config)
+    {
+        if (port == &DEV_Default)
+            wiringPiSPISetupMode(0, config->Speed != 0 ? config->Speed : 1000000, 1);
+        return 0;
+    }
+    static inline void Exit(DEV_PORT*)
+    {
+    }
+    static inline int Transfer(DEV_PORT*, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+    {
+        UBYTE buf[ADS1263_MAX_FRAME_LEN];
+        int ret = 0;
+        if (Len > sizeof(buf)) {
+            printf("wiringPi transfer of %u bytes too long !!! \r\n", (unsigned)Len);
+            return -1;
+        }
+        if (TxBuf == NULL)
+            memset(buf, 0, Len);
+        else
+            memcpy(buf, TxBuf, Len);
+        if (wiringPiSPIDataRW(0, buf, Len) < 0)
+            ret = -1;
+        if (RxBuf != NULL)
+            memcpy(RxBuf, buf, Len);
+        return ret;
+    }
+};
+#endif
 
-    // GPIO Config
-    DEV_GPIO_Init();
+template <class Spi, class Gpio>
+struct DEV_BACKEND_T {
+    typedef Spi SPI;
+    typedef Gpio GPIO;
 
-    bcm2835_spi_begin();                                         //Start spi interface, set spi pin for the reuse function
-    bcm2835_spi_setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);     //High first transmission
-    bcm2835_spi_setDataMode(BCM2835_SPI_MODE1);                  //spi mode 1, '0, 1'
-    bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_32);  //Frequency
-#elif USE_WIRINGPI_LIB
-    // if(wiringPiSetup() < 0) {//use wiringpi Pin number table
-    if (wiringPiSetupGpio() < 0) { //use BCM2835 Pin number table
-        printf("set wiringPi lib failed	!!! \r\n");
-        return 1;
+    static inline int Init(DEV_PORT* port, const ADS1263_PORT_CONFIG* config)
+    {
+        if (Gpio::Init(port, config) != 0) {
+            return -1;
+        }
+        Gpio::Write(port, port->cs, 1);
+        if (Spi::Init(port, config) != 0) {
+            Gpio::Exit(port);
+            return -1;
+        }
+        return 0;
     }
-    else {
-        printf("set wiringPi lib success !!! \r\n");
+    static inline void Exit(DEV_PORT* port)
+    {
+        Spi::Exit(port);
+        Gpio::Exit(port);
+    }
+    static inline int Transaction(DEV_PORT* port, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+    {
+        int ret;
+        if (port->native_cs) {
+            return Spi::Transfer(port, TxBuf, RxBuf, Len);
+        }
+        Gpio::Write(port, port->cs, 0);
+        ret = Spi::Transfer(port, TxBuf, RxBuf, Len);
+        Gpio::Write(port, port->cs, 1);
+        return ret;
+    }
+    static inline int WaitLow(DEV_PORT* port, UWORD Pin, uint64_t DeadlineNs, uint64_t* TimestampNs)
+    {
+        if (Pin == port->drdy) {
+            int ret = Gpio::WaitFalling(port, Pin, DeadlineNs, TimestampNs);
+            if (ret >= 0)
+                return ret;
+        }
+        while (1) {
+            if (Gpio::Read(port, Pin) == 0) {
+                if (TimestampNs != NULL)
+                    *TimestampNs = DEV_Time_ns();
+                return 0;
+            }
+            if (DEV_Time_ns() >= DeadlineNs)
+                return 1;
+        }
     }
+};
 
-    // GPIO Config
-    DEV_GPIO_Init();
-    // wiringPiSPISetup(0,10000000);
-    wiringPiSPISetupMode(0, 1000000, 1);
-#elif USE_DEV_LIB
-    printf("Write and read /dev/spidev0.0 \r\n");
-    DEV_GPIO_Init();
-    DEV_HARDWARE_SPI_begin("/dev/spidev0.0");
-    DEV_HARDWARE_SPI_setSpeed(1000000);
-    DEV_HARDWARE_SPI_Mode(SPI_MODE_1);
+typedef DEV_BACKEND_T<DEV_SPI_SPIDEV, DEV_GPIO_SYSFS> DEV_SPIDEV_SYSFS;
+typedef DEV_BACKEND_T<DEV_SPI_SPIDEV, DEV_GPIO_CHARDEV> DEV_SPIDEV_CHARDEV;
+typedef DEV_BACKEND_T<DEV_SPI_SPIDEV, DEV_GPIO_GPIOMEM> DEV_SPIDEV_GPIOMEM;
+typedef DEV_BACKEND_T<DEV_SPI_SIM, DEV_GPIO_SIM> DEV_SIM_BACKEND;
+#ifdef USE_BCM2835_LIB
+typedef DEV_BACKEND_T<DEV_SPI_BCM2835, DEV_GPIO_BCM2835> DEV_BCM2835_BACKEND;
+#endif
+#ifdef USE_WIRINGPI_LIB
+typedef DEV_BACKEND_T<DEV_SPI_WIRINGPI, DEV_GPIO_WIRINGPI> DEV_WIRINGPI_BACKEND;
 #endif
 
-
-#elif JETSON
-#ifdef USE_DEV_LIB
-    DEV_GPIO_Init();
-    printf("Software spi\r\n");
-    SYSFS_software_spi_begin();
-    SYSFS_software_spi_setBitOrder(SOFTWARE_SPI_MSBFIRST);
-    SYSFS_software_spi_setDataMode(SOFTWARE_SPI_Mode1);
-    SYSFS_software_spi_setClockDivider(SOFTWARE_SPI_CLOCK_DIV16);
-#elif USE_HARDWARE_LIB
-    printf("Write and read /dev/spidev0.0 \r\n");
-    DEV_GPIO_Init();
-    DEV_HARDWARE_SPI_begin("/dev/spidev0.0");
+/**
+ * Run f(Backend()) with the policy type of the port's backend. f is a generic
+ * lambda returning int; each case is a separate, fully inlined instantiation
+**/
+template <class F>
+static inline int DEV_Dispatch(DEV_BACKEND Backend, F&& f)
+{
+    switch (Backend) {
+    case DEV_BACKEND_SPIDEV_CHARDEV:
+        return f(DEV_SPIDEV_CHARDEV());
+    case DEV_BACKEND_SPIDEV_GPIOMEM:
+        return f(DEV_SPIDEV_GPIOMEM());
+    case DEV_BACKEND_SIM:
+        return f(DEV_SIM_BACKEND());
+#ifdef USE_BCM2835_LIB
+    case DEV_BACKEND_BCM2835:
+        return f(DEV_BCM2835_BACKEND());
 #endif
+#ifdef USE_WIRINGPI_LIB
+    case DEV_BACKEND_WIRINGPI:
+        return f(DEV_WIRINGPI_BACKEND());
+#endif
+    default:
+        return f(DEV_SPIDEV_SYSFS());
+    }
+}
 
+/**
+ * 1 if the backend is compiled into this build
+**/
+UBYTE DEV_Backend_Available(DEV_BACKEND Backend)
+{
+    switch (Backend) {
+    case DEV_BACKEND_DEFAULT:
+    case DEV_BACKEND_SPIDEV_SYSFS:
+    case DEV_BACKEND_SPIDEV_CHARDEV:
+    case DEV_BACKEND_SPIDEV_GPIOMEM:
+    case DEV_BACKEND_SIM:
+        return 1;
+#ifdef USE_BCM2835_LIB
+    case DEV_BACKEND_BCM2835:
+        return 1;
 #endif
-    printf("/***********************************/ \r\n");
-    return 0;
+#ifdef USE_WIRINGPI_LIB
+    case DEV_BACKEND_WIRINGPI:
+        return 1;
+#endif
+    default:
+        return 0;
+    }
 }
 
 /******************************************************************************
-function:	Module exits, closes SPI and BCM2835 library
+function:   Choose the backend DEV_BACKEND_DEFAULT stands for
 parameter:
+    Backend : any available backend
 Info:
+    Call before DEV_Module_Init and ADS1263_Open; ports already open keep
+    theirs. DEV_BACKEND_DEFAULT restores the one the build flags select.
+    Return 0 success, 1 not available in this build
 ******************************************************************************/
-void DEV_Module_Exit()
+UBYTE DEV_SetBackend(DEV_BACKEND Backend)
 {
-#ifdef RPI
-#ifdef USE_BCM2835_LIB
-    DEV_Digital_Write(DEV_RST_PIN, LOW);
-    DEV_Digital_Write(DEV_CS_PIN, LOW);
-
-    bcm2835_spi_end();
-    bcm2835_close();
-#elif USE_WIRINGPI_LIB
-    DEV_Digital_Write(DEV_RST_PIN, 0);
-    DEV_Digital_Write(DEV_CS_PIN, 0);
-#elif USE_DEV_LIB
-    DEV_HARDWARE_SPI_end();
-    DEV_Digital_Write(DEV_RST_PIN, 0);
-    DEV_Digital_Write(DEV_CS_PIN, 0);
-#endif
-
-#elif JETSON
-#ifdef USE_DEV_LIB
-    SYSFS_GPIO_Unexport(DEV_RST_PIN);
-    SYSFS_GPIO_Unexport(DEV_CS_PIN);
-    SYSFS_GPIO_Unexport(DEV_DRDY_PIN);
-
-#elif USE_HARDWARE_LIB
-    Debug("not support");
-#endif
-#endif
+    if (!DEV_Backend_Available(Backend)) {
+        printf("Backend %d is not built in \r\n", Backend);
+        return 1;
+    }
+    DEV_Backend_Default = Backend != DEV_BACKEND_DEFAULT ? Backend : DEV_Backend_Build;
+    return 0;
 }
 
-#pragma endregion
-
-#pragma region SYSFS
+/**
+ * GPIO read and write
+**/
+static void DEV_Port_Write(DEV_PORT* port, UWORD Pin, UBYTE Value)
+{
+    DEV_Dispatch(port->backend, [&](auto B) {
+        decltype(B)::GPIO::Write(port, Pin, Value);
+        return 0;
+    });
+}
+
+void DEV_Digital_Write(UWORD Pin, UBYTE Value)
+{
+    DEV_Port_Write(&DEV_Default, Pin, Value);
+}
+
+static UBYTE DEV_Port_Read(DEV_PORT* port, UWORD Pin)
+{
+    return DEV_Dispatch(port->backend, [&](auto B) {
+        return (int)decltype(B)::GPIO::Read(port, Pin);
+    });
+}
+
+UBYTE DEV_Digital_Read(UWORD Pin)
+{
+    return DEV_Port_Read(&DEV_Default, Pin);
+}
+
+/**
+ * SPI
+**/
+UBYTE DEV_SPI_WriteByte(uint8_t Value)
+{
+    UBYTE temp = 0;
+    DEV_Dispatch(DEV_Default.backend, [&](auto B) {
+        return decltype(B)::SPI::Transfer(&DEV_Default, &Value, &temp, 1);
+    });
+    return temp;
+}
+
+UBYTE DEV_SPI_ReadByte()
+{
+    return DEV_SPI_WriteByte(0x00);
+}
+
+/******************************************************************************
+function:   Full-duplex transfer of a whole frame
+parameter:
+    TxBuf : bytes to send, NULL sends zeros
+    RxBuf : received bytes, NULL discards them
+    Len   : frame length
+Info:
+    One bus transfer (a single ioctl on spidev), CS is not touched.
+    Return 0 success, -1 failed
+******************************************************************************/
+static int DEV_Port_Transfer(DEV_PORT* port, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+{
+    return DEV_Dispatch(port->backend, [&](auto B) {
+        return decltype(B)::SPI::Transfer(port, TxBuf, RxBuf, Len);
+    });
+}
+
+int DEV_SPI_Transfer(const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+{
+    return DEV_Port_Transfer(&DEV_Default, TxBuf, RxBuf, Len);
+}
+
+/**
+ * spidev ports can hand several frames to the kernel in one ioctl
+**/
+static inline UBYTE DEV_Port_IsSpidev(const DEV_PORT* port)
+{
+    return port->backend == DEV_BACKEND_SPIDEV_SYSFS || port->backend == DEV_BACKEND_SPIDEV_CHARDEV
+        || port->backend == DEV_BACKEND_SPIDEV_GPIOMEM;
+}
+
+/**
+ * SPI chip select owner, see DEV_SPI_NATIVE_CS
+**/
+void DEV_SPI_SetNativeCS(UBYTE Enable)
+{
+    DEV_Default.native_cs = Enable ? 1 : 0;
+}
+
+/******************************************************************************
+function:   Send one command frame with chip select asserted around it
+parameter:
+    TxBuf : bytes to send, NULL sends zeros
+    RxBuf : received bytes, NULL discards them
+    Len   : frame length
+Info:
+    With native CS the controller frames the transfer itself, otherwise
+    the port's CS pin is pulled low for exactly the duration of the transfer.
+    Return 0 success, -1 failed
+******************************************************************************/
+static int DEV_Port_Transaction_Direct(DEV_PORT* port, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+{
+    return DEV_Dispatch(port->backend, [&](auto B) {
+        return decltype(B)::Transaction(port, TxBuf, RxBuf, Len);
+    });
+}
+/**
+ * A transaction from the driver: straight to the bus, or through the port's
+ * arbiter and back when the calling thread is not the arbiter itself
+**/
+static int DEV_Port_Transaction(DEV_PORT* port, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+{
+    DEV_SPI_REQUEST req;
+
+    if (port->bus == NULL || DEV_Bus_OnOwnerThread(port->bus)) {
+        return DEV_Port_Transaction_Direct(port, TxBuf, RxBuf, Len);
+    }
+    memset(&req, 0, sizeof(req));
+    req.TxBuf = TxBuf;
+    req.RxBuf = RxBuf;
+    req.Len = Len;
+    req.Port = port;
+    if (DEV_Bus_Submit(port->bus, &req) != 0) {
+        return -1;
+    }
+    return DEV_Bus_Wait(&req);
+}
+
+int DEV_SPI_Transaction(const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+{
+    return DEV_Port_Transaction(&DEV_Default, TxBuf, RxBuf, Len);
+}
+
+/******************************************************************************
+function:   Queue a transaction on the DEV_Module_Init port's arbiter
+parameter:
+    Request : frame, completion callback; stays owned by the arbiter until done
+Info:
+    See DEV_SPI_SetBus. Without an arbiter the transaction runs at once
+    on the calling thread.
+    Return 0 queued, -1 failed
+******************************************************************************/
+int DEV_SPI_Submit(DEV_SPI_REQUEST* Request)
+{
+    Request->Port = &DEV_Default;
+    if (DEV_Default.bus == NULL) {
+        Request->Result = DEV_Port_Transaction_Direct(&DEV_Default, Request->TxBuf, Request->RxBuf, Request->Len);
+        Request->Done = 1;
+        if (Request->Callback != NULL)
+            Request->Callback(Request);
+        return 0;
+    }
+    return DEV_Bus_Submit(DEV_Default.bus, Request);
+}
+
+/**
+ * Route the DEV_Module_Init port through an arbiter, NULL for direct transfers
+**/
+void DEV_SPI_SetBus(DEV_BUS* Bus)
+{
+    DEV_Default.bus = Bus;
+}
+
+/**
+ * GPIO Mode
+**/
+void DEV_GPIO_Mode(UWORD Pin, UWORD Mode)
+{
+    DEV_Dispatch(DEV_Default.backend, [&](auto B) {
+        decltype(B)::GPIO::Mode(&DEV_Default, Pin, Mode);
+        return 0;
+    });
+}
+
+/**
+ * delay x ms
+**/
+void DEV_Delay_ms(UDOUBLE xms)
+{
+    DEV_Delay_Until(DEV_Time_ns() + (uint64_t)xms * 1000000);
+}
+
+/**
+ * sleep until an absolute CLOCK_MONOTONIC time in ns; one deadline, so the
+ * error does not grow with the length of the delay
+**/
+void DEV_Delay_Until(uint64_t DeadlineNs)
+{
+    struct timespec ts;
+    ts.tv_sec = DeadlineNs / 1000000000ULL;
+    ts.tv_nsec = DeadlineNs % 1000000000ULL;
+    while (DEV_Syscall(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR);
+}
+
+/**
+ * delay x us
+**/
+void DEV_Delay_us(UDOUBLE xus)
+{
+#if defined(RPI) && defined(USE_BCM2835_LIB)
+    bcm2835_delayMicroseconds(xus);
+#elif defined(RPI) && defined(USE_WIRINGPI_LIB)
+    delayMicroseconds(xus);
+#else
+    struct timespec ts = { (time_t)(xus / 1000000), (long)(xus % 1000000) * 1000 };
+    while (DEV_Syscall(nanosleep(&ts, &ts)) < 0 && errno == EINTR);
+#endif
+}
+
+/**
+ * CLOCK_MONOTONIC in ns, the same clock GPIO line events are stamped with
+**/
+uint64_t DEV_Time_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * System calls counted by DEV_Syscall since the process started
+**/
+uint64_t DEV_GetSyscalls()
+{
+    return DEV_Syscalls.load(std::memory_order_relaxed);
+}
+
+/******************************************************************************
+function:   Wait for an input to be low
+parameter:
+    Pin         : GPIO number
+    TimeoutMs   : give up after this many ms
+    TimestampNs : CLOCK_MONOTONIC time the pin was seen low, may be NULL
+Info:
+    Returns at once if the pin is already low. Backends with edge events
+    (GPIO character device, simulator) sleep until the falling edge of DRDY
+    and return its timestamp, the others poll the level against a deadline.
+    Return 0 pin is low, 1 timed out
+******************************************************************************/
+static int DEV_Port_WaitLow(DEV_PORT* port, UWORD Pin, UDOUBLE TimeoutMs, uint64_t* TimestampNs)
+{
+    uint64_t deadline = DEV_Time_ns() + (uint64_t)TimeoutMs * 1000000ull;
+    return DEV_Dispatch(port->backend, [&](auto B) {
+        return decltype(B)::WaitLow(port, Pin, deadline, TimestampNs);
+    });
+}
+
+int DEV_Digital_WaitLow(UWORD Pin, UDOUBLE TimeoutMs, uint64_t* TimestampNs)
+{
+    return DEV_Port_WaitLow(&DEV_Default, Pin, TimeoutMs, TimestampNs);
+}
+
+/**
+ * Time the last DEV_Module_Init took, reported with the ADS1263 startup phases
+**/
+static uint64_t DEV_Module_Init_ns = 0;
+
+static int DEV_Equipment_Probe()
+{
+    char value_str[64];
+    int fd, len, i, result = 0;
+
+    if (DEV_Backend_Default == DEV_BACKEND_SIM) {
+        printf("Current environment: simulator\r\n");
+        return 0;
+    }
+
+    fd = open("/etc/issue", O_RDONLY);
+    printf("Current environment: ");
+    if (fd < 0) {
+        Debug("Read failed Pin\n");
+        return -1;
+    }
+    len = read(fd, value_str, sizeof(value_str) - 1);
+    close(fd);
+    if (len < 0) {
+        Debug("failed to read value!\n");
+        return -1;
+    }
+    for (i = 0; i < len && value_str[i] != 32; i++);
+    value_str[i] = 0;
+    printf("%s\r\n", value_str);
+
+#ifdef RPI
+    if (i < 5) {
+        printf("Unrecognizable\r\n");
+    }
+    else if (strncmp(value_str, "Raspbian", 6) != 0) {
+        printf("Please make JETSON !!!!!!!!!!\r\n");
+        result = -1;
+    }
+#endif
+#ifdef JETSON
+    if (i < 5) {
+        Debug("Unrecognizable\r\n");
+    }
+    else if (strncmp(value_str, "Ubuntu", 6) != 0) {
+        printf("Please make RPI !!!!!!!!!!\r\n");
+        result = -1;
+    }
+#endif
+    return result;
+}
+
+/**
+ * The platform probe runs once per process, whichever way it ends
+**/
+static int DEV_Equipment_Testing()
+{
+    static int probed = 0;
+    static int result = 0;
+
+    if (!probed) {
+        result = DEV_Equipment_Probe();
+        probed = 1;
+    }
+    return result;
+}
+
+void DEV_GPIO_Init()
+{
+#ifdef JETSON
+    DEV_RST_PIN = GPIO18;
+    DEV_CS_PIN = GPIO22;
+    DEV_DRDY_PIN = GPIO17;
+#else
+    DEV_RST_PIN = 18;
+    DEV_CS_PIN = 22;
+    DEV_DRDY_PIN = 17;
+#endif
+    DEV_Default.rst = DEV_RST_PIN;
+    DEV_Default.cs = DEV_CS_PIN;
+    DEV_Default.drdy = DEV_DRDY_PIN;
+}
+
+static int DEV_Port_Open(DEV_PORT* port, const ADS1263_PORT_CONFIG* config);
+static void DEV_Port_Close(DEV_PORT* port);
+
+/******************************************************************************
+function:	Module Initialize, the library and initialize the pins, SPI protocol
+parameter:
+Info:
+    Opens the default port on the backend DEV_SetBackend chose, the
+    build flags' one unless it was called.
+******************************************************************************/
+UBYTE DEV_Module_Init()
+{
+    uint64_t start = DEV_Time_ns();
+    ADS1263_PORT_CONFIG config;
+
+    printf("/***********************************/ \r\n");
+    if (DEV_Equipment_Testing() < 0) {
+        return 1;
+    }
+    DEV_GPIO_Init();
+    memset(&config, 0, sizeof(config));
+    config.RstPin = DEV_RST_PIN;
+    config.CsPin = DEV_CS_PIN;
+    config.DrdyPin = DEV_DRDY_PIN;
+    config.NativeCS = DEV_Default.native_cs;
+    config.Bus = DEV_Default.bus;
+    config.Sim = DEV_Backend_Default == DEV_BACKEND_SIM ? SIM_GetDefault() : NULL;
+    if (DEV_Port_Open(&DEV_Default, &config) != 0) {
+        return 1;
+    }
+    DEV_Module_Init_ns = DEV_Time_ns() - start;
+    printf("/***********************************/ \r\n");
+    return 0;
+}
+
+/******************************************************************************
+function:	Module exits, closes SPI and BCM2835 library
+parameter:
+Info:
+******************************************************************************/
+void DEV_Module_Exit()
+{
+    DEV_Digital_Write(DEV_RST_PIN, 0);
+    DEV_Digital_Write(DEV_CS_PIN, 0);
+    DEV_Port_Close(&DEV_Default);
+}
+
+/**
+ * Release what DEV_Port_Open acquired
+**/
+static void DEV_Port_Close(DEV_PORT* port)
+{
+    DEV_Dispatch(port->backend, [&](auto B) {
+        decltype(B)::Exit(port);
+        return 0;
+    });
+}
+
+/******************************************************************************
+function:   Open a port for one more ADS1263
+parameter:
+    port   : port to fill in
+    config : backend, spidev path, clock, pin set
+Info:
+    spidev ports get their own fd; the bcm2835 and wiringPi backends have
+    a single bus, shared by all ports, and only the pins differ.
+    DEV_Module_Init must have run for those.
+    Return 0 success, -1 failed
+******************************************************************************/
+static int DEV_Port_Open(DEV_PORT* port, const ADS1263_PORT_CONFIG* config)
+{
+    port->backend = config->Backend != DEV_BACKEND_DEFAULT ? config->Backend : DEV_Backend_Default;
+    if (!DEV_Backend_Available(port->backend)) {
+        printf("Backend %d is not built in \r\n", port->backend);
+        return -1;
+    }
+    port->spi = &hardware_SPI;
+    port->rst = config->RstPin;
+    port->cs = config->CsPin;
+    port->drdy = config->DrdyPin;
+    port->native_cs = config->NativeCS ? 1 : 0;
+    port->bus = config->Bus;
+    port->gpio.out_fd = -1;
+    port->gpio.drdy_fd = -1;
+    port->sim = NULL;
+    port->own_sim = 0;
+    port->mem.base = NULL;
+    port->mem.fd = -1;
+
+    // map first: an unknown SoC or a missing /dev/gpiomem falls back to sysfs
+    if (port->backend == DEV_BACKEND_SPIDEV_GPIOMEM && DEV_GPIO_GPIOMEM::Init(port, config) != 0) {
+        printf("gpiomem not available, using sysfs \r\n");
+        port->backend = DEV_BACKEND_SPIDEV_SYSFS;
+    }
+    return DEV_Dispatch(port->backend, [&](auto B) {
+        return decltype(B)::Init(port, config);
+    });
+}
+
+#pragma endregion
+
+#pragma region SYSFS
 
 int SYSFS_GPIO_Export(int Pin)
 {
@@ -362,7 +1033,7 @@ int SYSFS_GPIO_Export(int Pin)
     }
 
     len = snprintf(buffer, NUM_MAXBUF, "%d", Pin);
-    write(fd, buffer, len);
+    DEV_Syscall(write(fd, buffer, len));
 
     SYSFS_GPIO_Debug("Export: Pin%d\r\n", Pin);
 
@@ -376,6 +1047,7 @@ int SYSFS_GPIO_Unexport(int Pin)
     int len;
     int fd;
 
+    SYSFS_GPIO_Close(Pin);
     fd = open("/sys/class/gpio/unexport", O_WRONLY);
     if (fd < 0) {
         SYSFS_GPIO_Debug("unexport Failed: Pin%d\n", Pin);
@@ -383,7 +1055,7 @@ int SYSFS_GPIO_Unexport(int Pin)
     }
 
     len = snprintf(buffer, NUM_MAXBUF, "%d", Pin);
-    write(fd, buffer, len);
+    DEV_Syscall(write(fd, buffer, len));
 
     SYSFS_GPIO_Debug("Unexport: Pin%d\r\n", Pin);
 
@@ -404,7 +1076,7 @@ int SYSFS_GPIO_Direction(int Pin, int Dir)
         return -1;
     }
 
-    if (write(fd, &dir_str[Dir == SYSFS_GPIO_IN ? 0 : 3], Dir == SYSFS_GPIO_IN ? 2 : 3) < 0) {
+    if (DEV_Syscall(write(fd, &dir_str[Dir == SYSFS_GPIO_IN ? 0 : 3], Dir == SYSFS_GPIO_IN ? 2 : 3)) < 0) {
         SYSFS_GPIO_Debug("failed to set direction!\r\n");
         return -1;
     }
@@ -420,34 +1092,107 @@ int SYSFS_GPIO_Direction(int Pin, int Dir)
     return 0;
 }
 
-int SYSFS_GPIO_Read(int Pin)
+/**
+ * Cached value file descriptors, indexed by pin
+**/
+static struct {
+    int fd = -1;
+} SYSFS_GPIO_Value[SYSFS_GPIO_MAX_PIN];
+
+static inline int SYSFS_GPIO_CachedFd(int Pin)
+{
+    if (Pin < 0 || Pin >= SYSFS_GPIO_MAX_PIN) {
+        return -1;
+    }
+    return SYSFS_GPIO_Value[Pin].fd;
+}
+
+/******************************************************************************
+function:   Open the value file of an exported pin and keep it open
+parameter:
+    Pin : GPIO number
+    Dir : SYSFS_GPIO_IN or SYSFS_GPIO_OUT
+Info:
+    SYSFS_GPIO_Read/SYSFS_GPIO_Write use pread/pwrite on the cached
+    descriptor instead of open/read/close on every access.
+    Return 0 success, -1 failed
+******************************************************************************/
+int SYSFS_GPIO_Open(int Pin, int Dir)
 {
     char path[DIR_MAXSIZ];
-    char value_str[3];
     int fd;
 
-    snprintf(path, DIR_MAXSIZ, "/sys/class/gpio/gpio%d/value", Pin);
-    fd = open(path, O_RDONLY);
-    if (fd < 0) {
-        SYSFS_GPIO_Debug("Read failed Pin%d\n", Pin);
+    if (Pin < 0 || Pin >= SYSFS_GPIO_MAX_PIN) {
+        SYSFS_GPIO_Debug("Pin%d out of cache range\n", Pin);
         return -1;
     }
+    SYSFS_GPIO_Close(Pin);
 
-    if (read(fd, value_str, 3) < 0) {
-        SYSFS_GPIO_Debug("failed to read value!\n");
+    snprintf(path, DIR_MAXSIZ, "/sys/class/gpio/gpio%d/value", Pin);
+    fd = open(path, (Dir == SYSFS_GPIO_IN ? O_RDONLY : O_RDWR) | O_CLOEXEC);
+    if (fd < 0) {
+        SYSFS_GPIO_Debug("Open failed Pin%d\n", Pin);
         return -1;
     }
+    SYSFS_GPIO_Value[Pin].fd = fd;
+    return 0;
+}
 
-    close(fd);
-    return(atoi(value_str));
+void SYSFS_GPIO_Close(int Pin)
+{
+    int fd = SYSFS_GPIO_CachedFd(Pin);
+    if (fd >= 0) {
+        close(fd);
+        SYSFS_GPIO_Value[Pin].fd = -1;
+    }
 }
 
-int SYSFS_GPIO_Write(int Pin, int value)
+int SYSFS_GPIO_Read(int Pin)
 {
-    const char s_values_str[] = "01";
+    char path[DIR_MAXSIZ];
+    char value_str[3];
+    int fd;
+
+    fd = SYSFS_GPIO_CachedFd(Pin);
+    if (fd >= 0) {
+        if (DEV_Syscall(pread(fd, value_str, 1, 0)) < 1) {
+            SYSFS_GPIO_Debug("failed to read value!\n");
+            return -1;
+        }
+        return value_str[0] - '0';
+    }
+
+    snprintf(path, DIR_MAXSIZ, "/sys/class/gpio/gpio%d/value", Pin);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        SYSFS_GPIO_Debug("Read failed Pin%d\n", Pin);
+        return -1;
+    }
+
+    if (DEV_Syscall(read(fd, value_str, 3)) < 0) {
+        SYSFS_GPIO_Debug("failed to read value!\n");
+        return -1;
+    }
+
+    close(fd);
+    return(atoi(value_str));
+}
+
+int SYSFS_GPIO_Write(int Pin, int value)
+{
+    const char s_values_str[] = "01";
     char path[DIR_MAXSIZ];
     int fd;
 
+    fd = SYSFS_GPIO_CachedFd(Pin);
+    if (fd >= 0) {
+        if (DEV_Syscall(pwrite(fd, &s_values_str[value == SYSFS_GPIO_LOW ? 0 : 1], 1, 0)) < 0) {
+            SYSFS_GPIO_Debug("failed to write value!\n");
+            return -1;
+        }
+        return 0;
+    }
+
     snprintf(path, DIR_MAXSIZ, "/sys/class/gpio/gpio%d/value", Pin);
     fd = open(path, O_WRONLY);
     if (fd < 0) {
@@ -455,7 +1200,7 @@ int SYSFS_GPIO_Write(int Pin, int value)
         return -1;
     }
 
-    if (write(fd, &s_values_str[value == SYSFS_GPIO_LOW ? 0 : 1], 1) < 0) {
+    if (DEV_Syscall(write(fd, &s_values_str[value == SYSFS_GPIO_LOW ? 0 : 1], 1)) < 0) {
         SYSFS_GPIO_Debug("failed to write value!\n");
         return -1;
     }
@@ -466,6 +1211,430 @@ int SYSFS_GPIO_Write(int Pin, int value)
 
 #pragma endregion
 
+#pragma region GPIOCHIP
+
+/******************************************************************************
+function:   Request the ADS1263 lines from a GPIO chip
+parameter:
+    lines   : request state
+    Chip    : chip device, e.g. /dev/gpiochip0
+    RstPin  : RST line offset, output, idles high
+    CsPin   : CS line offset, output, idles high
+    DrdyPin : DRDY line offset, input with falling edge events
+Info:
+    Return 0 success, -1 failed
+******************************************************************************/
+int GPIOCHIP_Lines_Open(GPIOCHIP_LINES* lines, const char* Chip, int RstPin, int CsPin, int DrdyPin)
+{
+    struct gpio_v2_line_request req;
+    int chip_fd;
+
+    GPIOCHIP_Lines_Close(lines);
+    chip_fd = open(Chip, O_RDWR | O_CLOEXEC);
+    if (chip_fd < 0) {
+        GPIOCHIP_Debug("open %s failed\r\n", Chip);
+        return -1;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.offsets[0] = RstPin;
+    req.offsets[1] = CsPin;
+    req.num_lines = 2;
+    strncpy(req.consumer, GPIOCHIP_CONSUMER, sizeof(req.consumer) - 1);
+    req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    req.config.num_attrs = 1;
+    req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    req.config.attrs[0].attr.values = 0x3;      // RST and CS high
+    req.config.attrs[0].mask = 0x3;
+    if (DEV_Syscall(ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req)) < 0) {
+        GPIOCHIP_Debug("request RST/CS failed\r\n");
+        close(chip_fd);
+        return -1;
+    }
+    lines->out_fd = req.fd;
+
+    memset(&req, 0, sizeof(req));
+    req.offsets[0] = DrdyPin;
+    req.num_lines = 1;
+    strncpy(req.consumer, GPIOCHIP_CONSUMER, sizeof(req.consumer) - 1);
+    req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    if (DEV_Syscall(ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req)) < 0) {
+        GPIOCHIP_Debug("request DRDY failed\r\n");
+        close(chip_fd);
+        GPIOCHIP_Lines_Close(lines);
+        return -1;
+    }
+    lines->drdy_fd = req.fd;
+    close(chip_fd);
+
+    lines->rst = RstPin;
+    lines->cs = CsPin;
+    lines->drdy = DrdyPin;
+    return 0;
+}
+
+void GPIOCHIP_Lines_Close(GPIOCHIP_LINES* lines)
+{
+    if (lines->out_fd >= 0)
+        close(lines->out_fd);
+    if (lines->drdy_fd >= 0)
+        close(lines->drdy_fd);
+    lines->out_fd = -1;
+    lines->drdy_fd = -1;
+}
+
+int GPIOCHIP_Lines_Write(GPIOCHIP_LINES* lines, int Pin, int Value)
+{
+    struct gpio_v2_line_values values;
+
+    if (Pin == lines->rst)
+        values.mask = 0x1;
+    else if (Pin == lines->cs)
+        values.mask = 0x2;
+    else
+        return -1;
+    values.bits = Value ? values.mask : 0;
+    if (DEV_Syscall(ioctl(lines->out_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values)) < 0) {
+        GPIOCHIP_Debug("failed to write Pin%d\r\n", Pin);
+        return -1;
+    }
+    return 0;
+}
+
+int GPIOCHIP_Lines_Read(GPIOCHIP_LINES* lines, int Pin)
+{
+    struct gpio_v2_line_values values;
+    int fd;
+
+    if (Pin == lines->drdy) {
+        fd = lines->drdy_fd;
+        values.mask = 0x1;
+    }
+    else if (Pin == lines->rst || Pin == lines->cs) {
+        fd = lines->out_fd;
+        values.mask = Pin == lines->rst ? 0x1 : 0x2;
+    }
+    else {
+        return -1;
+    }
+    values.bits = 0;
+    if (DEV_Syscall(ioctl(fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values)) < 0) {
+        GPIOCHIP_Debug("failed to read Pin%d\r\n", Pin);
+        return -1;
+    }
+    return (values.bits & values.mask) ? 1 : 0;
+}
+
+/******************************************************************************
+function:   Block until a DRDY falling edge
+parameter:
+    lines       : request state
+    TimeoutMs   : poll timeout
+    TimestampNs : kernel edge timestamp (CLOCK_MONOTONIC), may be NULL
+Info:
+    Return 0 edge seen, 1 timed out, -1 failed
+******************************************************************************/
+int GPIOCHIP_Lines_WaitFalling(GPIOCHIP_LINES* lines, int TimeoutMs, uint64_t* TimestampNs)
+{
+    struct pollfd pfd;
+    struct gpio_v2_line_event event;
+    int ret;
+
+    pfd.fd = lines->drdy_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    do {
+        ret = DEV_Syscall(poll(&pfd, 1, TimeoutMs));
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+        return -1;
+    if (ret == 0)
+        return 1;
+
+    if (DEV_Syscall(read(lines->drdy_fd, &event, sizeof(event))) != sizeof(event)) {
+        GPIOCHIP_Debug("failed to read line event\r\n");
+        return -1;
+    }
+    if (TimestampNs != NULL)
+        *TimestampNs = event.timestamp_ns;
+    return 0;
+}
+
+/******************************************************************************
+function:   Consume the edges queued while nobody was waiting
+parameter:
+    lines       : request state
+    TimestampNs : kernel timestamp of the last falling edge, may be NULL
+Info:
+    Return 1 a falling edge was queued, 0 none
+******************************************************************************/
+int GPIOCHIP_Lines_Latest(GPIOCHIP_LINES* lines, uint64_t* TimestampNs)
+{
+    struct pollfd pfd;
+    struct gpio_v2_line_event event;
+    int found = 0;
+
+    pfd.fd = lines->drdy_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    while (DEV_Syscall(poll(&pfd, 1, 0)) > 0 && (pfd.revents & POLLIN)) {
+        if (DEV_Syscall(read(lines->drdy_fd, &event, sizeof(event))) != sizeof(event))
+            break;
+        if (event.id != GPIO_V2_LINE_EVENT_FALLING_EDGE)
+            continue;
+        if (TimestampNs != NULL)
+            *TimestampNs = event.timestamp_ns;
+        found = 1;
+    }
+    return found;
+}
+
+/**
+ * Drop edges queued while nobody was waiting, so a wait never returns on a stale one
+**/
+void GPIOCHIP_Lines_Flush(GPIOCHIP_LINES* lines)
+{
+    GPIOCHIP_Lines_Latest(lines, NULL);
+}
+
+/******************************************************************************
+function:   Wait until DRDY is low
+parameter:
+    lines       : request state
+    Pin         : DRDY line offset
+    DeadlineNs  : CLOCK_MONOTONIC limit
+    TimestampNs : time DRDY fell, may be NULL
+Info:
+    A reader that comes late finds DRDY already low and the edge queued:
+    the queued edge's kernel timestamp is the DRDY time, not the time of
+    the call. DRDY may fall between the drain and the level read, so a low
+    level with nothing queued drains once more for that edge. A level that
+    cannot be read (a test fd) counts as low when an edge is queued.
+    Return 0 DRDY low, 1 timed out, -1 failed
+******************************************************************************/
+int GPIOCHIP_Lines_WaitLow(GPIOCHIP_LINES* lines, int Pin, uint64_t DeadlineNs, uint64_t* TimestampNs)
+{
+    uint64_t now = DEV_Time_ns(), edge = now;
+    int queued = GPIOCHIP_Lines_Latest(lines, &edge);
+    int level = GPIOCHIP_Lines_Read(lines, Pin);
+
+    if (level == 0 || (level < 0 && queued)) {
+        if (level == 0 && !queued)
+            GPIOCHIP_Lines_Latest(lines, &edge);
+        if (TimestampNs != NULL)
+            *TimestampNs = edge;
+        return 0;
+    }
+    while (now < DeadlineNs) {
+        int ret = GPIOCHIP_Lines_WaitFalling(lines, (int)((DeadlineNs - now + 999999) / 1000000), TimestampNs);
+        if (ret <= 0)
+            return ret;
+        now = DEV_Time_ns();
+    }
+    return 1;
+}
+
+/******************************************************************************
+function:   Replace the DRDY event source
+parameter:
+    Fd : descriptor delivering struct gpio_v2_line_event records
+Info:
+    Test hook: a pipe or socketpair written by a test stands in for the
+    line request, so the wait path can be exercised without a Pi. The
+    level read on a fake fd fails and is treated as "not ready".
+    Return 0 success
+******************************************************************************/
+int GPIOCHIP_AttachEventFd(int Fd)
+{
+    if (DEV_Default.gpio.drdy_fd >= 0)
+        close(DEV_Default.gpio.drdy_fd);
+    DEV_Default.gpio.drdy_fd = Fd;
+    return 0;
+}
+
+/**
+ * The GPIOCHIP_* calls without a lines argument act on the DEV_Module_Init port
+**/
+int GPIOCHIP_Open(const char* Chip, int RstPin, int CsPin, int DrdyPin)
+{
+    return GPIOCHIP_Lines_Open(&DEV_Default.gpio, Chip, RstPin, CsPin, DrdyPin);
+}
+
+void GPIOCHIP_Close()
+{
+    GPIOCHIP_Lines_Close(&DEV_Default.gpio);
+}
+
+int GPIOCHIP_Write(int Pin, int Value)
+{
+    return GPIOCHIP_Lines_Write(&DEV_Default.gpio, Pin, Value);
+}
+
+int GPIOCHIP_Read(int Pin)
+{
+    return GPIOCHIP_Lines_Read(&DEV_Default.gpio, Pin);
+}
+
+int GPIOCHIP_WaitFalling(int TimeoutMs, uint64_t* TimestampNs)
+{
+    return GPIOCHIP_Lines_WaitFalling(&DEV_Default.gpio, TimeoutMs, TimestampNs);
+}
+
+void GPIOCHIP_Flush()
+{
+    GPIOCHIP_Lines_Flush(&DEV_Default.gpio);
+}
+
+int GPIOCHIP_WaitLow(int Pin, uint64_t DeadlineNs, uint64_t* TimestampNs)
+{
+    return GPIOCHIP_Lines_WaitLow(&DEV_Default.gpio, Pin, DeadlineNs, TimestampNs);
+}
+
+#pragma endregion
+
+#pragma region GPIOMEM
+
+#include <sys/mman.h>
+
+/******************************************************************************
+function:   Register layout of the GPIO block on this SoC
+parameter:
+Info:
+    Reads /proc/device-tree/compatible. BCM2835, 2836, 2837 and 2711 share
+    the GPFSEL/GPSET/GPCLR/GPLEV layout; anything else is unknown.
+******************************************************************************/
+GPIOMEM_LAYOUT GPIOMEM_Detect()
+{
+    static const char* bcm2835[] = { "brcm,bcm2835", "brcm,bcm2836", "brcm,bcm2837", "brcm,bcm2711" };
+    char compatible[256];
+    int fd, len, i, j;
+
+    fd = open("/proc/device-tree/compatible", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return GPIOMEM_LAYOUT_UNKNOWN;
+    }
+    len = read(fd, compatible, sizeof(compatible) - 1);
+    close(fd);
+    if (len <= 0) {
+        return GPIOMEM_LAYOUT_UNKNOWN;
+    }
+    compatible[len] = 0;
+    // NUL-separated list, most specific first
+    for (i = 0; i < len; i += strlen(compatible + i) + 1) {
+        for (j = 0; j < (int)(sizeof(bcm2835) / sizeof(bcm2835[0])); j++) {
+            if (strcmp(compatible + i, bcm2835[j]) == 0)
+                return GPIOMEM_LAYOUT_BCM2835;
+        }
+    }
+    return GPIOMEM_LAYOUT_UNKNOWN;
+}
+
+/******************************************************************************
+function:   Map the GPIO block
+parameter:
+    map    : mapping state
+    Path   : /dev/gpiomem, or an ordinary file used as a register image
+    Layout : GPIOMEM_LAYOUT_AUTO to detect it
+Info:
+    A register image shorter than GPIOMEM_BLOCK_SIZE is extended with
+    zeros; its layout defaults to BCM2835 when detection finds none.
+    Return 0 success, -1 failed (no device, unknown layout)
+******************************************************************************/
+int GPIOMEM_Map_Open(GPIOMEM_MAP* map, const char* Path, GPIOMEM_LAYOUT Layout)
+{
+    struct stat st;
+    void* base;
+
+    GPIOMEM_Map_Close(map);
+    map->fd = open(Path, O_RDWR | O_SYNC | O_CLOEXEC);
+    if (map->fd < 0) {
+        GPIOMEM_Debug("open %s failed\r\n", Path);
+        return -1;
+    }
+    map->image = fstat(map->fd, &st) == 0 && S_ISREG(st.st_mode);
+    if (Layout == GPIOMEM_LAYOUT_AUTO) {
+        Layout = GPIOMEM_Detect();
+        if (Layout == GPIOMEM_LAYOUT_UNKNOWN && map->image)
+            Layout = GPIOMEM_LAYOUT_BCM2835;
+    }
+    if (Layout != GPIOMEM_LAYOUT_BCM2835) {
+        GPIOMEM_Debug("unknown GPIO register layout\r\n");
+        GPIOMEM_Map_Close(map);
+        return -1;
+    }
+    if (map->image && st.st_size < GPIOMEM_BLOCK_SIZE && ftruncate(map->fd, GPIOMEM_BLOCK_SIZE) < 0) {
+        GPIOMEM_Map_Close(map);
+        return -1;
+    }
+
+    base = mmap(NULL, GPIOMEM_BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0);
+    if (base == MAP_FAILED) {
+        GPIOMEM_Debug("mmap %s failed\r\n", Path);
+        GPIOMEM_Map_Close(map);
+        return -1;
+    }
+    map->base = (volatile uint32_t*)base;
+    map->layout = Layout;
+    return 0;
+}
+
+void GPIOMEM_Map_Close(GPIOMEM_MAP* map)
+{
+    if (map->base != NULL)
+        munmap((void*)map->base, GPIOMEM_BLOCK_SIZE);
+    if (map->fd >= 0)
+        close(map->fd);
+    map->base = NULL;
+    map->fd = -1;
+}
+
+/******************************************************************************
+function:   Set a pin's function to input or output
+parameter:
+    map    : mapping
+    Pin    : BCM number
+    Output : 1 output, 0 input
+Info:
+    Read-modify-write of GPFSELn (3 bits per pin, 10 pins per register),
+    only done while opening a port.
+    Return 0 success, -1 bad pin
+******************************************************************************/
+int GPIOMEM_Map_Mode(GPIOMEM_MAP* map, int Pin, int Output)
+{
+    volatile uint32_t* fsel;
+    int shift;
+
+    if (map->base == NULL || Pin < 0 || Pin >= GPIOMEM_MAX_PIN) {
+        return -1;
+    }
+    fsel = map->base + GPIOMEM_GPFSEL0 / 4 + Pin / 10;
+    shift = (Pin % 10) * 3;
+    *fsel = (*fsel & ~(7u << shift)) | ((Output ? 1u : 0u) << shift);
+    return 0;
+}
+
+/**
+ * GPSETn/GPCLRn only act on the bits written as 1, no read-modify-write
+**/
+int GPIOMEM_Map_Write(GPIOMEM_MAP* map, int Pin, int Value)
+{
+    if (map->base == NULL || Pin < 0 || Pin >= GPIOMEM_MAX_PIN) {
+        return -1;
+    }
+    map->base[(Value ? GPIOMEM_GPSET0 : GPIOMEM_GPCLR0) / 4 + Pin / 32] = 1u << (Pin % 32);
+    return 0;
+}
+
+int GPIOMEM_Map_Read(GPIOMEM_MAP* map, int Pin)
+{
+    if (map->base == NULL || Pin < 0 || Pin >= GPIOMEM_MAX_PIN) {
+        return -1;
+    }
+    return (map->base[GPIOMEM_GPLEV0 / 4 + Pin / 32] >> (Pin % 32)) & 1;
+}
+
+#pragma endregion
+
 #pragma region HardwareSPI
 
 HARDWARE_SPI hardware_SPI;
@@ -515,12 +1684,12 @@ void DEV_HARDWARE_SPI_begin(char* SPI_device)
     }
     hardware_SPI.mode = 0;
 
-    ret = ioctl(hardware_SPI.fd, SPI_IOC_WR_BITS_PER_WORD, &bits);
+    ret = DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_WR_BITS_PER_WORD, &bits));
     if (ret == -1) {
         DEV_HARDWARE_SPI_Debug("can't set bits per word\r\n");
     }
 
-    ret = ioctl(hardware_SPI.fd, SPI_IOC_RD_BITS_PER_WORD, &bits);
+    ret = DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_RD_BITS_PER_WORD, &bits));
     if (ret == -1) {
         DEV_HARDWARE_SPI_Debug("can't get bits per word\r\n");
     }
@@ -546,11 +1715,11 @@ void DEV_HARDWARE_SPI_beginSet(char* SPI_device, SPIMode mode, uint32_t speed)
         DEV_HARDWARE_SPI_Debug("open : %s\r\n", SPI_device);
     }
 
-    ret = ioctl(hardware_SPI.fd, SPI_IOC_WR_BITS_PER_WORD, &bits);
+    ret = DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_WR_BITS_PER_WORD, &bits));
     if (ret == -1)
         DEV_HARDWARE_SPI_Debug("can't set bits per word\r\n");
 
-    ret = ioctl(hardware_SPI.fd, SPI_IOC_RD_BITS_PER_WORD, &bits);
+    ret = DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_RD_BITS_PER_WORD, &bits));
     if (ret == -1)
         DEV_HARDWARE_SPI_Debug("can't get bits per word\r\n");
 
@@ -588,14 +1757,14 @@ int DEV_HARDWARE_SPI_setSpeed(uint32_t speed)
     hardware_SPI.speed = speed;
 
     //Write speed
-    if (ioctl(hardware_SPI.fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) == -1) {
+    if (DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed)) == -1) {
         DEV_HARDWARE_SPI_Debug("can't set max speed hz\r\n");
         hardware_SPI.speed = speed1;//Setting failure rate unchanged
         return -1;
     }
 
     //Read the speed of just writing
-    if (ioctl(hardware_SPI.fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed) == -1) {
+    if (DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed)) == -1) {
         DEV_HARDWARE_SPI_Debug("can't get max speed hz\r\n");
         hardware_SPI.speed = speed1;//Setting failure rate unchanged
         return -1;
@@ -624,7 +1793,7 @@ int DEV_HARDWARE_SPI_Mode(SPIMode mode)
     hardware_SPI.mode |= mode;//Setting mode
 
     //Write device
-    if (ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode) == -1) {
+    if (DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode)) == -1) {
         DEV_HARDWARE_SPI_Debug("can't set spi mode\r\n");
         return -1;
     }
@@ -651,7 +1820,7 @@ int DEV_HARDWARE_SPI_CSEN(SPICSEN EN)
         hardware_SPI.mode &= ~SPI_NO_CS;
     }
     //Write device
-    if (ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode) == -1) {
+    if (DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode)) == -1) {
         DEV_HARDWARE_SPI_Debug("can't set spi CS EN\r\n");
         return -1;
     }
@@ -685,7 +1854,7 @@ int DEV_HARDWARE_SPI_ChipSelect(SPIChipSelect CS_Mode)
         hardware_SPI.mode |= SPI_NO_CS;
     }
 
-    if (ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode) == -1) {
+    if (DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode)) == -1) {
         DEV_HARDWARE_SPI_Debug("can't set spi mode\r\n");
         return -1;
     }
@@ -715,7 +1884,7 @@ int DEV_HARDWARE_SPI_SetBitOrder(SPIBitOrder Order)
     }
 
     // DEV_HARDWARE_SPI_Debug("hardware_SPI.mode = 0x%02x\r\n", hardware_SPI.mode);
-    int fd = ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode);
+    int fd = DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode));
     DEV_HARDWARE_SPI_Debug("fd = %d\r\n", fd);
     if (fd == -1) {
         DEV_HARDWARE_SPI_Debug("can't set spi SPI_LSB_FIRST\r\n");
@@ -743,7 +1912,7 @@ int DEV_HARDWARE_SPI_SetBusMode(BusMode mode)
     else if (mode == SPI_4WIRE_Mode) {
         hardware_SPI.mode &= ~SPI_3WIRE;
     }
-    if (ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode) == -1) {
+    if (DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_WR_MODE, &hardware_SPI.mode)) == -1) {
         DEV_HARDWARE_SPI_Debug("can't set spi mode\r\n");
         return -1;
     }
@@ -777,7 +1946,7 @@ uint8_t DEV_HARDWARE_SPI_TransferByte(uint8_t buf)
     tr.rx_buf = (unsigned long)rbuf;
 
     //ioctl Operation, transmission of data
-    if (ioctl(hardware_SPI.fd, SPI_IOC_MESSAGE(1), &tr) < 1)
+    if (DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_MESSAGE(1), &tr)) < 1)
         DEV_HARDWARE_SPI_Debug("can't send spi message\r\n");
     return rbuf[0];
 }
@@ -794,7 +1963,7 @@ int DEV_HARDWARE_SPI_Transfer(uint8_t* buf, uint32_t len)
     tr.rx_buf = (unsigned long)buf;
 
     //ioctl Operation, transmission of data
-    if (ioctl(hardware_SPI.fd, SPI_IOC_MESSAGE(1), &tr) < 1) {
+    if (DEV_Syscall(ioctl(hardware_SPI.fd, SPI_IOC_MESSAGE(1), &tr)) < 1) {
         DEV_HARDWARE_SPI_Debug("can't send spi message\r\n");
         return -1;
     }
@@ -802,600 +1971,6066 @@ int DEV_HARDWARE_SPI_Transfer(uint8_t* buf, uint32_t len)
     return 1;
 }
 
-#pragma endregion
-
-#pragma region ADS1263
-
-UBYTE ScanMode = 0;
-
 /******************************************************************************
-function:   Module reset
+function: Full-duplex transfer of a frame in a single ioctl
 parameter:
-Info:
+    txbuf : Sent data, NULL clocks out zeros
+    rxbuf : Received data, NULL discards it
+    len :   Frame length
+Info: Return 1 success
+      Return -1 failed
 ******************************************************************************/
-static void ADS1263_reset()
+int DEV_HARDWARE_SPI_TransferFullDuplex(const uint8_t* txbuf, uint8_t* rxbuf, uint32_t len)
 {
-    DEV_Digital_Write(DEV_RST_PIN, 1);
-    DEV_Delay_ms(300);
-    DEV_Digital_Write(DEV_RST_PIN, 0);
-    DEV_Delay_ms(300);
-    DEV_Digital_Write(DEV_RST_PIN, 1);
-    DEV_Delay_ms(300);
+    return DEV_HARDWARE_SPI_TransferOn(&hardware_SPI, txbuf, rxbuf, len);
 }
 
 /******************************************************************************
-function:   send command
+function: Full-duplex transfer on a given spidev
 parameter:
-        Cmd: command
-Info:
+    spi :   device from DEV_HARDWARE_SPI_Open (or hardware_SPI)
+    txbuf : Sent data, NULL clocks out zeros
+    rxbuf : Received data, NULL discards it
+    len :   Frame length
+Info: The transfer descriptor lives on the stack, so devices can be
+      driven from different threads.
+      Return 1 success
+      Return -1 failed
 ******************************************************************************/
-static void ADS1263_WriteCmd(UBYTE Cmd)
+int DEV_HARDWARE_SPI_TransferOn(const HARDWARE_SPI* spi, const uint8_t* txbuf, uint8_t* rxbuf, uint32_t len)
 {
-    DEV_Digital_Write(DEV_CS_PIN, 0);
-    DEV_SPI_WriteByte(Cmd);
-    DEV_Digital_Write(DEV_CS_PIN, 1);
+    struct spi_ioc_transfer xfer;
+
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.len = len;
+    xfer.tx_buf = (unsigned long)txbuf;
+    xfer.rx_buf = (unsigned long)rxbuf;
+    xfer.speed_hz = spi->speed;
+    xfer.delay_usecs = spi->delay;
+    xfer.bits_per_word = bits;
+
+    //ioctl Operation, transmission of data
+    if (DEV_Syscall(ioctl(spi->fd, SPI_IOC_MESSAGE(1), &xfer)) < 1) {
+        DEV_HARDWARE_SPI_Debug("can't send spi message\r\n");
+        return -1;
+    }
+    return 1;
 }
 
 /******************************************************************************
-function:   Write a data to the destination register
+function: Several frames in one ioctl, chip select released between them
 parameter:
-        Reg : Target register
-        data: Written data
-Info:
+    spi   : device
+    tx    : per frame, NULL entries clock out zeros
+    rx    : per frame, NULL entries discard
+    len   : per frame
+    n     : frames, at most DEV_HARDWARE_SPI_MAX_BATCH
+Info: Only for controller-driven chip select (cs_change between transfers).
+      Return 1 success
+      Return -1 failed
 ******************************************************************************/
-static void ADS1263_WriteReg(UBYTE Reg, UBYTE data)
+int DEV_HARDWARE_SPI_TransferBatch(const HARDWARE_SPI* spi, const uint8_t* const* tx, uint8_t* const* rx, const uint32_t* len, uint32_t n)
 {
-    DEV_Digital_Write(DEV_CS_PIN, 0);
-    DEV_SPI_WriteByte(CMD_WREG | Reg);
-    DEV_SPI_WriteByte(0x00);
-    DEV_SPI_WriteByte(data);
-    DEV_Digital_Write(DEV_CS_PIN, 1);
+    struct spi_ioc_transfer xfer[DEV_HARDWARE_SPI_MAX_BATCH];
+    uint32_t i;
+
+    if (n == 0 || n > DEV_HARDWARE_SPI_MAX_BATCH) {
+        return -1;
+    }
+    memset(xfer, 0, n * sizeof(xfer[0]));
+    for (i = 0; i < n; i++) {
+        xfer[i].len = len[i];
+        xfer[i].tx_buf = (unsigned long)tx[i];
+        xfer[i].rx_buf = (unsigned long)rx[i];
+        xfer[i].speed_hz = spi->speed;
+        xfer[i].delay_usecs = spi->delay;
+        xfer[i].bits_per_word = bits;
+        xfer[i].cs_change = i + 1 < n;
+    }
+    if (DEV_Syscall(ioctl(spi->fd, SPI_IOC_MESSAGE(n), xfer)) < 1) {
+        DEV_HARDWARE_SPI_Debug("can't send spi message\r\n");
+        return -1;
+    }
+    return 1;
 }
 
 /******************************************************************************
-function:   Read a data from the destination register
+function:   Open one more spidev with its own settings
 parameter:
-        Reg : Target register
+    spi        : device state to fill in
+    SPI_device : e.g. /dev/spidev1.0
+    mode       : SPI mode
+    speed      : clock in Hz
 Info:
-    Return the read data
+    Unlike DEV_HARDWARE_SPI_begin this does not touch hardware_SPI and
+    does not exit on failure.
+    Return 1 success, -1 failed
 ******************************************************************************/
-static UBYTE ADS1263_Read_data(UBYTE Reg)
+int DEV_HARDWARE_SPI_Open(HARDWARE_SPI* spi, const char* SPI_device, SPIMode mode, uint32_t speed)
 {
-    UBYTE temp = 0;
-    DEV_Digital_Write(DEV_CS_PIN, 0);
-    DEV_SPI_WriteByte(CMD_RREG | Reg);
-    DEV_SPI_WriteByte(0x00);
-    // DEV_Delay_ms(1);
-    temp = DEV_SPI_ReadByte();
-    DEV_Digital_Write(DEV_CS_PIN, 1);
-    return temp;
+    uint8_t word = bits;
+    uint8_t spi_mode = mode;
+
+    memset(spi, 0, sizeof(*spi));
+    if ((spi->fd = open(SPI_device, O_RDWR | O_CLOEXEC)) < 0) {
+        DEV_HARDWARE_SPI_Debug("Failed to open SPI device\r\n");
+        return -1;
+    }
+    spi->mode = mode;
+    spi->speed = speed;
+    if (DEV_Syscall(ioctl(spi->fd, SPI_IOC_WR_BITS_PER_WORD, &word)) == -1
+        || DEV_Syscall(ioctl(spi->fd, SPI_IOC_WR_MODE, &spi_mode)) == -1
+        || DEV_Syscall(ioctl(spi->fd, SPI_IOC_WR_MAX_SPEED_HZ, &spi->speed)) == -1) {
+        DEV_HARDWARE_SPI_Debug("can't configure %s\r\n", SPI_device);
+        close(spi->fd);
+        spi->fd = -1;
+        return -1;
+    }
+    return 1;
 }
 
-/******************************************************************************
-function:   Check data
-parameter:
-        val : 4 bytes(ADC2 is 3 bytes) data
-        byt : CRC byte
-Info:
-        Check success, return 0
-******************************************************************************/
-static UBYTE ADS1263_Checksum(UDOUBLE val, UBYTE byt)
+void DEV_HARDWARE_SPI_Close(HARDWARE_SPI* spi)
 {
-    UBYTE sum = 0;
-    UBYTE mask = -1;        // 8 bits mask, 0xff
-    while (val) {
-        sum += val & mask;  // only add the lower values
-        val >>= 8;          // shift down
+    if (spi->fd >= 0 && close(spi->fd) != 0) {
+        DEV_HARDWARE_SPI_Debug("Failed to close SPI device\r\n");
     }
-    sum += 0x9b;
-    // printf("--- %x %x--- \r\n", sum, byt);
-    return sum ^ byt;       // if equal, this will be 0
+    spi->fd = -1;
 }
 
-/******************************************************************************
-function:   Waiting for a busy end
-parameter:
-Info:
-    Timeout indicates that the operation is not working properly.
-******************************************************************************/
-static void ADS1263_WaitDRDY()
+#pragma endregion
+
+#pragma region Bus
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include <sched.h>
+#include <pthread.h>
+
+/**
+ * SPI bus arbiter: one owner thread runs every queued transaction in order.
+ * Callers never touch the bus or its chip selects themselves, so transfers
+ * from different threads (or different ports on one bus) cannot interleave.
+**/
+struct DEV_BUS {
+    std::mutex lock;
+    std::condition_variable queued;     // owner: work arrived or stop
+    std::condition_variable completed;  // DEV_Bus_Wait: a batch finished
+    DEV_SPI_REQUEST* head = NULL;
+    DEV_SPI_REQUEST* tail = NULL;
+    bool running = false;
+    std::thread thread;
+    std::thread::id owner;
+};
+
+static void DEV_Bus_Run(DEV_SPI_REQUEST* req, UDOUBLE n)
 {
-    // printf("ADS1263_WaitDRDY \r\n");
-    UDOUBLE i = 0;
+    // back-to-back frames for one controller-selected port: one ioctl, CS toggled by the kernel
+    if (n > 1 && DEV_Port_IsSpidev(req->Port)) {
+        const uint8_t* tx[DEV_HARDWARE_SPI_MAX_BATCH];
+        uint8_t* rx[DEV_HARDWARE_SPI_MAX_BATCH];
+        uint32_t len[DEV_HARDWARE_SPI_MAX_BATCH];
+        DEV_SPI_REQUEST* r = req;
+        UDOUBLE i;
+        for (i = 0; i < n; i++, r = r->Next) {
+            tx[i] = r->TxBuf;
+            rx[i] = r->RxBuf;
+            len[i] = r->Len;
+        }
+        int ret = DEV_HARDWARE_SPI_TransferBatch(req->Port->spi, tx, rx, len, n) < 0 ? -1 : 0;
+        for (i = 0, r = req; i < n; i++, r = r->Next)
+            r->Result = ret;
+        return;
+    }
+    for (; n > 0; n--, req = req->Next)
+        req->Result = DEV_Port_Transaction_Direct(req->Port, req->TxBuf, req->RxBuf, req->Len);
+}
+
+static void DEV_Bus_Loop(DEV_BUS* bus)
+{
+    DEV_SPI_REQUEST* list;
+    DEV_SPI_REQUEST* req;
+    DEV_SPI_REQUEST* next;
+
     while (1) {
-        if (DEV_Digital_Read(DEV_DRDY_PIN) == 0)
-            break;
-        if (i >= 4000000) {
-            printf("Time Out ...\r\n");
-            break;
+        {
+            std::unique_lock<std::mutex> guard(bus->lock);
+            bus->queued.wait(guard, [bus] { return bus->head != NULL || !bus->running; });
+            if (bus->head == NULL)
+                return;
+            // take everything queued so far as one batch
+            list = bus->head;
+            bus->head = bus->tail = NULL;
+        }
+
+        for (req = list; req != NULL; ) {
+            UDOUBLE n = 1, bytes = req->Len;
+            DEV_SPI_REQUEST* last = req;
+            if (req->Port->native_cs) {
+                while (n < DEV_HARDWARE_SPI_MAX_BATCH && last->Next != NULL && last->Next->Port == req->Port
+                    && bytes + last->Next->Len <= DEV_BUS_MAX_BATCH_BYTES) {
+                    last = last->Next;
+                    bytes += last->Len;
+                    n++;
+                }
+            }
+            DEV_Bus_Run(req, n);
+            next = last->Next;
+
+            // completion: the callback owns the request from here, waiters are woken below
+            for (UDOUBLE i = 0; i < n; i++) {
+                DEV_SPI_REQUEST* done = req;
+                req = req->Next;
+                if (done->Callback != NULL) {
+                    done->Done = 1;
+                    done->Callback(done);
+                }
+                else {
+                    std::lock_guard<std::mutex> guard(bus->lock);
+                    done->Done = 1;
+                }
+            }
+            req = next;
+            bus->completed.notify_all();
         }
     }
-    // printf("ADS1263_WaitDRDY Release \r\n");
 }
 
 /******************************************************************************
-function:  Read device ID
+function:   Create an SPI bus arbiter and start its owner thread
 parameter:
+    Priority : SCHED_FIFO priority of the owner thread, 0 keeps the default
 Info:
+    Attach ports with DEV_SPI_SetBus or ADS1263_PORT_CONFIG.Bus. Every port
+    that shares a physical bus (and its chip-select lines) should use the
+    same arbiter.
+    Return the arbiter, NULL on failure
 ******************************************************************************/
-UBYTE ADS1263_ReadChipID()
+DEV_BUS* DEV_Bus_Create(int Priority)
 {
-    UBYTE id;
-    id = ADS1263_Read_data(REG_ID);
-    return id >> 5;
+    DEV_BUS* bus = new (std::nothrow) DEV_BUS;
+    if (bus == NULL) {
+        return NULL;
+    }
+    bus->running = true;
+    bus->thread = std::thread(DEV_Bus_Loop, bus);
+    bus->owner = bus->thread.get_id();
+    if (Priority > 0) {
+        struct sched_param param;
+        param.sched_priority = Priority;
+        if (pthread_setschedparam(bus->thread.native_handle(), SCHED_FIFO, &param) != 0)
+            printf("Bus SCHED_FIFO %d not permitted \r\n", Priority);
+    }
+    return bus;
 }
 
-/******************************************************************************
-function:  Setting mode
-parameter:
-    Mode : 0 Single-ended input
-           1 channel1 Differential input
-Info:
-******************************************************************************/
-void ADS1263_SetMode(UBYTE Mode)
+/**
+ * Drain the queue, stop the owner thread and free the arbiter; detach ports first
+**/
+void DEV_Bus_Destroy(DEV_BUS* Bus)
 {
-    if (Mode == 0) {
-        ScanMode = 0;
+    if (Bus == NULL) {
+        return;
     }
-    else {
-        ScanMode = 1;
+    {
+        std::lock_guard<std::mutex> guard(Bus->lock);
+        Bus->running = false;
     }
+    Bus->queued.notify_one();
+    if (Bus->thread.joinable())
+        Bus->thread.join();
+    delete Bus;
 }
 
 /******************************************************************************
-function:  Configure ADC gain and sampling speed
+function:   Queue a transaction
 parameter:
-    gain : Enumeration type gain
-    drate: Enumeration type sampling speed
+    Bus     : arbiter
+    Request : frame, port and completion; must stay valid until done
 Info:
+    Transactions run in submission order. Completion is either the
+    Callback (called on the owner thread, after which the arbiter no longer
+    touches the request) or, without a callback, DEV_Bus_Wait.
+    Return 0 queued, -1 arbiter stopped
 ******************************************************************************/
-void ADS1263_ConfigADC1(ADS1263_GAIN gain, ADS1263_DRATE drate, ADS1263_DELAY delay)
+int DEV_Bus_Submit(DEV_BUS* Bus, DEV_SPI_REQUEST* Request)
 {
-    UBYTE MODE2 = 0x80;             //0x80:PGA bypassed, 0x00:PGA enabled
-    MODE2 |= (gain << 4) | drate;
-    ADS1263_WriteReg(REG_MODE2, MODE2);
-    DEV_Delay_ms(1);
-    if (ADS1263_Read_data(REG_MODE2) == MODE2)
-        printf("REG_MODE2 success \r\n");
-    else
-        printf("REG_MODE2 unsuccess \r\n");
-
-    UBYTE REFMUX = 0x24;        //0x00:+-2.5V as REF, 0x24:VDD,VSS as REF
-    ADS1263_WriteReg(REG_REFMUX, REFMUX);
-    DEV_Delay_ms(1);
-    if (ADS1263_Read_data(REG_REFMUX) == REFMUX)
-        printf("REG_REFMUX success \r\n");
-    else
-        printf("REG_REFMUX unsuccess \r\n");
+    Request->Next = NULL;
+    Request->Done = 0;
+    Request->Result = -1;
+    Request->Bus = Bus;
+    {
+        std::lock_guard<std::mutex> guard(Bus->lock);
+        if (!Bus->running) {
+            return -1;
+        }
+        if (Bus->tail != NULL)
+            Bus->tail->Next = Request;
+        else
+            Bus->head = Request;
+        Bus->tail = Request;
+    }
+    Bus->queued.notify_one();
+    return 0;
+}
 
-    UBYTE MODE0 = delay;
-    ADS1263_WriteReg(REG_MODE0, MODE0);
-    DEV_Delay_ms(1);
-    if (ADS1263_Read_data(REG_MODE0) == MODE0)
-        printf("REG_MODE0 success \r\n");
-    else
-        printf("REG_MODE0 unsuccess \r\n");
+/**
+ * Block until a request submitted without a callback has run, return its Result
+**/
+int DEV_Bus_Wait(DEV_SPI_REQUEST* Request)
+{
+    DEV_BUS* bus = Request->Bus;
+    if (bus == NULL) {
+        return Request->Result;
+    }
+    std::unique_lock<std::mutex> guard(bus->lock);
+    bus->completed.wait(guard, [Request] { return Request->Done != 0; });
+    return Request->Result;
+}
 
-    UBYTE MODE1 = 0x84; // Digital Filter; 0x84:FIR, 0x64:Sinc4, 0x44:Sinc3, 0x24:Sinc2, 0x04:Sinc1
-    ADS1263_WriteReg(REG_MODE1, MODE1);
-    DEV_Delay_ms(1);
-    if (ADS1263_Read_data(REG_MODE1) == MODE1)
-        printf("REG_MODE1 success \r\n");
-    else
-        printf("REG_MODE1 unsuccess \r\n");
+/**
+ * 1 when called from the arbiter's own thread (e.g. inside a completion callback)
+**/
+int DEV_Bus_OnOwnerThread(DEV_BUS* Bus)
+{
+    return std::this_thread::get_id() == Bus->owner;
 }
 
-/******************************************************************************
-function:  Configure ADC gain and sampling speed
-parameter:
-    gain : Enumeration type gain
-    drate: Enumeration type sampling speed
-Info:
-******************************************************************************/
-void ADS1263_ConfigADC2(ADS1263_ADC2_GAIN gain, ADS1263_ADC2_DRATE drate, ADS1263_DELAY delay)
+#pragma endregion
+
+#pragma region SIM
+
+#include <math.h>
+#include <mutex>
+#include <new>
+
+/**
+ * ADC2 conversion period in ns per ADC2CFG rate, first conversion after this many
+**/
+static const uint64_t SIM_ADC2_Period_ns[4] = { 100000000, 10000000, 2500000, 1250000 };
+#define SIM_ADC2_FIRST_PERIODS 3
+
+/**
+ * One ADC's conversion schedule: conversion k completes at start + first + k * period
+**/
+typedef struct
 {
-    UBYTE ADC2CFG = 0x20;               //REF, 0x20:VAVDD and VAVSS, 0x00:+-2.5V
-    ADC2CFG |= (drate << 6) | gain;
-    ADS1263_WriteReg(REG_ADC2CFG, ADC2CFG);
-    DEV_Delay_ms(1);
-    if (ADS1263_Read_data(REG_ADC2CFG) == ADC2CFG)
-        printf("REG_ADC2CFG success \r\n");
-    else
-        printf("REG_ADC2CFG unsuccess \r\n");
+    uint64_t start;         // restart time, 0 while stopped
+    uint64_t first;
+    uint64_t period;
+    int64_t read;           // index of the last conversion read, -1 none
+}SIM_CONV;
+
+struct SIM_ADS1263 {
+    std::mutex lock;
+    uint64_t seed;
+    uint64_t epoch;                 // waveform time origin
+    UBYTE Regs[ADS1263_REG_COUNT];
+    SIM_INPUT Inputs[SIM_INPUTS];
+    SIM_FAULTS Faults;
+    SIM_STATS Stats;
+    SIM_CONV Adc1, Adc2;
+    UBYTE rst;                      // last RST level, a rising edge resets
+    UBYTE cs;
+    uint64_t frames;                // data frames sent, for CrcErrorEvery
+
+    /**
+     * Playback of a recording, see SIM_Replay. Recorded samples are applied
+     * in file order as their time comes; hold keeps the latest code per ADC
+     * and channel, latest/read count the ADC1 conversions like SIM_CONV.
+    **/
+    struct {
+        UBYTE active;
+        SIM_REPLAY config;
+        ADS1263_REC_READER reader;
+        ADS1263_SAMPLE* buf;        // decoded block
+        int count;
+        int pos;                    // next sample of buf to apply
+        uint64_t next;              // offset of the block after buf, 0 at the end
+        uint64_t first_ts;          // recorded time that maps to start
+        uint64_t last1;             // recorded time of the last ADC1 sample applied
+        uint64_t step;              // last ADC1 period, the gap left when looping
+        uint64_t loop_ns;           // recorded time added per pass
+        UBYTE has1;                 // this pass applied an ADC1 sample
+        uint64_t start;             // CLOCK_MONOTONIC of first_ts, 0 until the driver first waits
+        uint64_t due;               // CLOCK_MONOTONIC of the latest ADC1 conversion
+        int64_t latest;
+        int64_t read;
+        int32_t hold[2][ADS1263_REC_TAG_CHANNEL + 1];
+    } Replay;
+};
+
+static SIM_ADS1263* SIM_Default = NULL;
+
+static const UBYTE SIM_RegDefault[ADS1263_REG_COUNT] = {
+    SIM_CHIP_ID, 0x11, 0x05, 0x00, 0x80, 0x04, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0xBB,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x40,
+};
 
-    UBYTE MODE0 = delay;
-    ADS1263_WriteReg(REG_MODE0, MODE0);
-    DEV_Delay_ms(1);
-    if (ADS1263_Read_data(REG_MODE0) == MODE0)
-        printf("REG_MODE0 success \r\n");
-    else
-        printf("REG_MODE0 unsuccess \r\n");
+/**
+ * splitmix64: a stateless hash, so every noise draw is a function of its key
+**/
+static uint64_t SIM_Hash(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
 }
 
-/******************************************************************************
-function:  Device initialization
-parameter:
-Info:
-******************************************************************************/
-UBYTE ADS1263_init_ADC1(ADS1263_DRATE rate)
+static double SIM_Gauss(uint64_t key)
 {
-    ADS1263_reset();
-    if (ADS1263_ReadChipID() == 1) {
-        printf("ID Read success \r\n");
-    }
-    else {
-        printf("ID Read failed \r\n");
-        return 1;
-    }
-    ADS1263_WriteCmd(CMD_STOP1);
-    ADS1263_ConfigADC1(ADS1263_GAIN_1, rate, ADS1263_DELAY_35us);
-    ADS1263_WriteCmd(CMD_START1);
-    return 0;
+    double u1 = ((SIM_Hash(key) >> 11) + 1) * (1.0 / 9007199254740993.0);
+    double u2 = (SIM_Hash(key ^ 0x5851f42d4c957f2dull) >> 11) * (1.0 / 9007199254740992.0);
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
 }
-UBYTE ADS1263_init_ADC2(ADS1263_ADC2_DRATE rate)
+
+/**
+ * Voltage on a mux input (INPMUX/ADC2MUX nibble) at time t, in volts
+**/
+static double SIM_Input(SIM_ADS1263* sim, UBYTE Mux, double t, uint64_t key)
 {
-    ADS1263_reset();
-    if (ADS1263_ReadChipID() == 1) {
-        printf("ID Read success \r\n");
+    const SIM_INPUT* in;
+    double v, phase;
+
+    if (Mux >= SIM_INPUTS) {
+        return Mux == 0x0b ? 0.122 : 0.0;     // temperature sensor about 25 C; monitors, TDAC, float: 0
     }
-    else {
-        printf("ID Read failed \r\n");
-        return 1;
+    in = &sim->Inputs[Mux];
+    phase = in->Frequency * t;
+    phase -= floor(phase);
+    switch (in->Wave) {
+    case SIM_WAVE_SINE:
+        v = in->Offset + in->Amplitude * sin(2.0 * M_PI * phase);
+        break;
+    case SIM_WAVE_SQUARE:
+        v = in->Offset + (phase < 0.5 ? in->Amplitude : -in->Amplitude);
+        break;
+    case SIM_WAVE_RAMP:
+        v = in->Offset + in->Amplitude * (2.0 * phase - 1.0);
+        break;
+    default:
+        v = in->Offset;
+        break;
     }
-    ADS1263_WriteCmd(CMD_STOP2);
-    ADS1263_ConfigADC2(ADS1263_ADC2_GAIN_1, rate, ADS1263_DELAY_35us);
-    return 0;
+    if (in->Noise != 0)
+        v += in->Noise * SIM_Gauss(sim->seed ^ SIM_Hash(key * SIM_INPUTS + Mux));
+    return v;
 }
 
-/******************************************************************************
-function:  Set the channel to be read
-parameter:
-    Channal : Set channel number
-Info:
-******************************************************************************/
-static void ADS1263_SetChannal(UBYTE Channal)
+/**
+ * Reference voltage for a REFMUX-style selection: P/N 0 internal 2.5 V,
+ * 1..3 AIN0/2/4 (P) or AIN1/3/5 (N), 4 AVDD 5 V / AVSS 0 V
+**/
+static double SIM_Vref(SIM_ADS1263* sim, UBYTE P, UBYTE N, double t, uint64_t key)
 {
-    if (Channal > 10) {
-        return;
-    }
-    UBYTE INPMUX = (Channal << 4) | 0x0a;       //0x0a:VCOM as Negative Input
-    ADS1263_WriteReg(REG_INPMUX, INPMUX);
-    if (ADS1263_Read_data(REG_INPMUX) == INPMUX) {
-        // printf("ADS1263_ADC1_SetChannal success \r\n");
-    }
-    else {
-        printf("ADS1263_ADC1_SetChannal unsuccess \r\n");
-    }
+    double vp = P == 0 ? 2.5 : P == 4 ? 5.0 : SIM_Input(sim, (P - 1) * 2, t, key);
+    double vn = N == 0 || N == 4 ? 0.0 : SIM_Input(sim, (N - 1) * 2 + 1, t, key);
+    return vp - vn > 1e-6 ? vp - vn : 1e-6;
 }
 
-/******************************************************************************
-function:  Set the channel to be read
-parameter:
-    Channal : Set channel number
-Info:
-******************************************************************************/
-static void ADS1263_SetChannal_ADC2(UBYTE Channal)
+static int64_t SIM_Clamp(double v, int64_t lo, int64_t hi)
 {
-    if (Channal > 10) {
-        return;
-    }
-    UBYTE INPMUX = (Channal << 4) | 0x0a;       //0x0a:VCOM as Negative Input
-    ADS1263_WriteReg(REG_ADC2MUX, INPMUX);
-    if (ADS1263_Read_data(REG_ADC2MUX) == INPMUX) {
-        // printf("ADS1263_ADC2_SetChannal success \r\n");
-    }
-    else {
-        printf("ADS1263_ADC2_SetChannal unsuccess \r\n");
-    }
+    if (v <= (double)lo)
+        return lo;
+    if (v >= (double)hi)
+        return hi;
+    return (int64_t)llround(v);
 }
 
-/******************************************************************************
-function:  Set the channel to be read
-parameter:
-    Channal : Set channel number
-Info:
-******************************************************************************/
-void ADS1263_SetDiffChannal(UBYTE Channal)
+/**
+ * Noise bandwidth of the ADC1 filter as a fraction of the data rate, per ADS1263_FILTER
+**/
+static const double SIM_Filter_ENBW[5] = { 0.5, 0.333, 0.275, 0.240, 0.4 };
+
+/**
+ * NoiseDensity of both mux inputs through the ADC1 filter, in volts
+**/
+static double SIM_Filtered_Noise(SIM_ADS1263* sim, UBYTE Mux, uint64_t key)
 {
-    UBYTE INPMUX;
-    if (Channal == 0) {
-        INPMUX = (0 << 4) | 1;    //DiffChannal   AIN0-AIN1
-    }
-    else if (Channal == 1) {
-        INPMUX = (2 << 4) | 3;    //DiffChannal   AIN2-AIN3
-    }
-    else if (Channal == 2) {
-        INPMUX = (4 << 4) | 5;    //DiffChannal   AIN4-AIN5
-    }
-    else if (Channal == 3) {
-        INPMUX = (6 << 4) | 7;    //DiffChannal   AIN6-AIN7
-    }
-    else if (Channal == 4) {
-        INPMUX = (8 << 4) | 9;    //DiffChannal   AIN8-AIN9
-    }
-    ADS1263_WriteReg(REG_INPMUX, INPMUX);
-    if (ADS1263_Read_data(REG_INPMUX) == INPMUX) {
-        // printf("ADS1263_SetDiffChannal success \r\n");
-    }
-    else {
-        printf("ADS1263_SetDiffChannal unsuccess \r\n");
+    UBYTE p = Mux >> 4, n = Mux & 0x0f, filter = sim->Regs[REG_MODE1] >> 5;
+    double dp = p < SIM_INPUTS ? sim->Inputs[p].NoiseDensity : 0.0;
+    double dn = n < SIM_INPUTS && n != p ? sim->Inputs[n].NoiseDensity : 0.0;
+    double bw;
+
+    if ((dp == 0 && dn == 0) || sim->Adc1.period == 0) {
+        return 0.0;
     }
+    bw = SIM_Filter_ENBW[filter > 4 ? 0 : filter] * 1e9 / sim->Adc1.period;
+    return sqrt((dp * dp + dn * dn) * bw) * SIM_Gauss(sim->seed ^ SIM_Hash(~key * SIM_INPUTS + Mux));
 }
 
-/******************************************************************************
-function:  Set the channel to be read
-parameter:
-    Channal : Set channel number
-Info:
-******************************************************************************/
-void ADS1263_SetDiffChannal_ADC2(UBYTE Channal)
+/**
+ * ADC1 code of a conversion completed at time T, before calibration
+**/
+static int32_t SIM_Convert1(SIM_ADS1263* sim, uint64_t T, uint64_t key)
 {
-    UBYTE INPMUX;
-    if (Channal == 0) {
-        INPMUX = (0 << 4) | 1;    //DiffChannal   AIN0-AIN1
-    }
-    else if (Channal == 1) {
-        INPMUX = (2 << 4) | 3;    //DiffChannal   AIN2-AIN3
-    }
-    else if (Channal == 2) {
-        INPMUX = (4 << 4) | 5;    //DiffChannal   AIN4-AIN5
-    }
-    else if (Channal == 3) {
-        INPMUX = (6 << 4) | 7;    //DiffChannal   AIN6-AIN7
-    }
-    else if (Channal == 4) {
-        INPMUX = (8 << 4) | 9;    //DiffChannal   AIN8-AIN9
-    }
-    ADS1263_WriteReg(REG_ADC2MUX, INPMUX);
-    if (ADS1263_Read_data(REG_ADC2MUX) == INPMUX) {
-        // printf("ADS1263_SetDiffChannal_ADC2 success \r\n");
-    }
-    else {
-        printf("ADS1263_SetDiffChannal_ADC2 unsuccess \r\n");
-    }
+    UBYTE mux = sim->Regs[REG_INPMUX], mode2 = sim->Regs[REG_MODE2], ref = sim->Regs[REG_REFMUX];
+    double t = (T - sim->epoch) * 1e-9;
+    double gain = (mode2 & 0x80) ? 1.0 : (double)(1 << ((mode2 >> 4) & 0x07));
+    double v = SIM_Input(sim, mux >> 4, t, key) - SIM_Input(sim, mux & 0x0f, t, key) + SIM_Filtered_Noise(sim, mux, key);
+    double vref = SIM_Vref(sim, (ref >> 3) & 0x07, ref & 0x07, t, key);
+    return (int32_t)SIM_Clamp(v * gain / vref * 2147483648.0, INT32_MIN, INT32_MAX);
 }
 
-/******************************************************************************
-function:  Read ADC data
-parameter:
-Info:
-******************************************************************************/
-static UDOUBLE ADS1263_Read_ADC1_Data()
+static int32_t SIM_Convert2(SIM_ADS1263* sim, uint64_t T, uint64_t key)
 {
-    UDOUBLE read = 0;
-    UBYTE buf[4] = { 0, 0, 0, 0 };
-    UBYTE Status, CRC;
-    DEV_Digital_Write(DEV_CS_PIN, 0);
-    do {
-        DEV_SPI_WriteByte(CMD_RDATA1);
-        // DEV_Delay_ms(10);
-        Status = DEV_SPI_ReadByte();
-    } while ((Status & 0x40) == 0);
-
-    buf[0] = DEV_SPI_ReadByte();
-    buf[1] = DEV_SPI_ReadByte();
-    buf[2] = DEV_SPI_ReadByte();
-    buf[3] = DEV_SPI_ReadByte();
-    CRC = DEV_SPI_ReadByte();
-    DEV_Digital_Write(DEV_CS_PIN, 1);
-    read |= ((UDOUBLE)buf[0] << 24);
-    read |= ((UDOUBLE)buf[1] << 16);
-    read |= ((UDOUBLE)buf[2] << 8);
-    read |= (UDOUBLE)buf[3];
-    // printf("%x %x %x %x %x %x\r\n", Status, buf[0], buf[1], buf[2], buf[3], CRC);
-    if (ADS1263_Checksum(read, CRC) != 0)
-        printf("ADC1 Data read error! \r\n");
-    return read;
+    UBYTE mux = sim->Regs[REG_ADC2MUX], cfg = sim->Regs[REG_ADC2CFG];
+    double t = (T - sim->epoch) * 1e-9;
+    double gain = (double)(1 << (cfg & 0x07));
+    double v = SIM_Input(sim, mux >> 4, t, key) - SIM_Input(sim, mux & 0x0f, t, key);
+    UBYTE ref = (cfg >> 3) & 0x07;
+    double vref = SIM_Vref(sim, ref, ref, t, key);    // REF2 pairs AIN0/1, AIN2/3, AIN4/5 like REFMUX
+    return (int32_t)SIM_Clamp(v * gain / vref * 8388608.0, -8388608, 8388607);
 }
 
-/******************************************************************************
-function:  Read ADC data
-parameter:
-Info:
-******************************************************************************/
-static UDOUBLE ADS1263_Read_ADC2_Data()
+/**
+ * Offset and full-scale calibration registers applied as the chip does:
+ * (code - OFC) * FSC / FSC(1.0)
+**/
+static int32_t SIM_Calibrate1(SIM_ADS1263* sim, int32_t code)
 {
-    UDOUBLE read = 0;
-    UBYTE buf[4] = { 0, 0, 0, 0 };
-    UBYTE Status, CRC;
+    int64_t ofc = (int32_t)(((UDOUBLE)sim->Regs[REG_OFCAL2] << 24) | ((UDOUBLE)sim->Regs[REG_OFCAL1] << 16)
+        | ((UDOUBLE)sim->Regs[REG_OFCAL0] << 8));
+    int64_t fsc = ((int64_t)sim->Regs[REG_FSCAL2] << 16) | (sim->Regs[REG_FSCAL1] << 8) | sim->Regs[REG_FSCAL0];
+    return (int32_t)SIM_Clamp((double)(((int64_t)code - ofc) * fsc) / 0x400000, INT32_MIN, INT32_MAX);
+}
 
-    DEV_Digital_Write(DEV_CS_PIN, 0);
-    do {
-        DEV_SPI_WriteByte(CMD_RDATA2);
-        // DEV_Delay_ms(10);
-        Status = DEV_SPI_ReadByte();
-    } while ((Status & 0x80) == 0);
-
-    buf[0] = DEV_SPI_ReadByte();
-    buf[1] = DEV_SPI_ReadByte();
-    buf[2] = DEV_SPI_ReadByte();
-    buf[3] = DEV_SPI_ReadByte();
-    CRC = DEV_SPI_ReadByte();
-    DEV_Digital_Write(DEV_CS_PIN, 1);
-    read |= ((UDOUBLE)buf[0] << 16);
-    read |= ((UDOUBLE)buf[1] << 8);
-    read |= (UDOUBLE)buf[2];
-    // printf("%x %x %x %x %x\r\n", Status, buf[0], buf[1], buf[2], CRC);
-    if (ADS1263_Checksum(read, CRC) != 0)
-        printf("ADC2 Data read error! \r\n");
-    return read;
+static int32_t SIM_Calibrate2(SIM_ADS1263* sim, int32_t code)
+{
+    int64_t ofc = (int16_t)((sim->Regs[REG_ADC2OFC1] << 8) | sim->Regs[REG_ADC2OFC0]) * 256;
+    int64_t fsc = (sim->Regs[REG_ADC2FSC1] << 8) | sim->Regs[REG_ADC2FSC0];
+    return (int32_t)SIM_Clamp((double)(((int64_t)code - ofc) * fsc) / 0x4000, -8388608, 8388607);
 }
 
-/******************************************************************************
-function:  Read ADC specified channel data
-parameter:
-    Channel: Channel number
-Info:
-******************************************************************************/
-UDOUBLE ADS1263_GetChannalValue(UBYTE Channel)
+static void SIM_Restart1(SIM_ADS1263* sim, uint64_t now)
 {
-    UDOUBLE Value = 0;
-    if (ScanMode == 0) {// 0  Single-ended input  10 channel1 Differential input  5 channe 
-        if (Channel > 10) {
-            return 0;
-        }
-        ADS1263_SetChannal(Channel);
-        // DEV_Delay_ms(2);
-        // ADS1263_WriteCmd(CMD_START1);
-        // DEV_Delay_ms(2);
-        ADS1263_WaitDRDY();
-        Value = ADS1263_Read_ADC1_Data();
+    UBYTE drate = sim->Regs[REG_MODE2] & 0x0f, filter = sim->Regs[REG_MODE1] >> 5;
+    UBYTE delay = sim->Regs[REG_MODE0] & 0x0f, chop = (sim->Regs[REG_MODE0] >> 4) & 0x01;
+    sim->Adc1.start = now;
+    sim->Adc1.first = (uint64_t)ADS1263_ConversionTime((ADS1263_DRATE)drate, (ADS1263_FILTER)filter, (ADS1263_DELAY)delay, 1) * 1000;
+    sim->Adc1.period = (uint64_t)ADS1263_ConversionTime((ADS1263_DRATE)drate, (ADS1263_FILTER)filter, (ADS1263_DELAY)delay, 0) * 1000;
+    if (chop) {
+        sim->Adc1.first *= 2;
+        sim->Adc1.period *= 2;
+    }
+    sim->Adc1.read = -1;
+}
+
+static void SIM_Restart2(SIM_ADS1263* sim, uint64_t now)
+{
+    sim->Adc2.start = now;
+    sim->Adc2.period = SIM_ADC2_Period_ns[sim->Regs[REG_ADC2CFG] >> 6];
+    sim->Adc2.first = sim->Adc2.period * SIM_ADC2_FIRST_PERIODS;
+    sim->Adc2.read = -1;
+}
+
+/**
+ * Index of the latest completed conversion, -1 if none yet or stopped
+**/
+static int64_t SIM_Latest(const SIM_CONV* conv, uint64_t now)
+{
+    if (conv->start == 0 || now < conv->start + conv->first) {
+        return -1;
+    }
+    return (int64_t)((now - conv->start - conv->first) / conv->period);
+}
+
+static uint64_t SIM_Completed(const SIM_CONV* conv, int64_t k)
+{
+    return conv->start + conv->first + (uint64_t)k * conv->period;
+}
+
+static void SIM_Reset(SIM_ADS1263* sim)
+{
+    memcpy(sim->Regs, SIM_RegDefault, ADS1263_REG_COUNT);
+    if (sim->Faults.ChipID != 0)
+        sim->Regs[REG_ID] = sim->Faults.ChipID;
+    memset(&sim->Adc1, 0, sizeof(sim->Adc1));
+    memset(&sim->Adc2, 0, sizeof(sim->Adc2));
+    sim->Adc1.read = sim->Adc2.read = -1;
+}
+
+/**
+ * Channel number of a mux setting, the inverse of ADS1263_ChannalMux:
+ * AINn-AINCOM is channel n, AIN2n-AIN2n+1 is channel n
+**/
+static UBYTE SIM_Replay_Channel(UBYTE Mux)
+{
+    return (Mux & 0x0f) == 0x0a ? Mux >> 4 : (Mux >> 4) / 2;
+}
+
+/**
+ * Next recorded sample to apply, decoding the following block or starting
+ * the next pass as needed. NULL once the replay has ended
+**/
+static const ADS1263_SAMPLE* SIM_Replay_Head(SIM_ADS1263* sim)
+{
+    uint64_t offset;
+
+    while (sim->Replay.pos >= sim->Replay.count) {
+        offset = sim->Replay.next;
+        if (offset == 0) {
+            // a pass without ADC1 samples would loop without end
+            if (!sim->Replay.config.Loop || !sim->Replay.has1) {
+                sim->Stats.ReplayDone = 1;
+                return NULL;
+            }
+            sim->Replay.loop_ns += sim->Replay.last1 - sim->Replay.first_ts + sim->Replay.step;
+            sim->Replay.last1 = 0;
+            sim->Replay.has1 = 0;
+            offset = ADS1263_Rec_First(&sim->Replay.reader);
+        }
+        sim->Replay.count = ADS1263_Rec_Decode(&sim->Replay.reader, offset, sim->Replay.buf,
+            sim->Replay.reader.Header->BlockSamples, &sim->Replay.next);
+        sim->Replay.pos = 0;
+        if (sim->Replay.count < 0) {
+            sim->Replay.count = 0;
+            sim->Replay.next = 0;
+            sim->Replay.config.Loop = 0;
+        }
+    }
+    return &sim->Replay.buf[sim->Replay.pos];
+}
+
+/**
+ * CLOCK_MONOTONIC time a recorded sample is due at
+**/
+static uint64_t SIM_Replay_Due(SIM_ADS1263* sim, const ADS1263_SAMPLE* s)
+{
+    return sim->Replay.start + (uint64_t)((s->Timestamp - sim->Replay.first_ts + sim->Replay.loop_ns) / sim->Replay.config.Speed);
+}
+
+static void SIM_Replay_Apply(SIM_ADS1263* sim, const ADS1263_SAMPLE* s, uint64_t due)
+{
+    UBYTE a = s->Flags & ADS1263_SAMPLE_ADC2 ? 1 : 0;
+
+    sim->Replay.hold[a][s->Channel & ADS1263_REC_TAG_CHANNEL] = a ? (int32_t)(s->Value << 8) >> 8 : (int32_t)s->Value;
+    if (!a) {
+        if (sim->Replay.last1 != 0 && s->Timestamp > sim->Replay.last1)
+            sim->Replay.step = s->Timestamp - sim->Replay.last1;
+        sim->Replay.last1 = s->Timestamp;
+        sim->Replay.has1 = 1;
+        sim->Replay.latest++;
+        sim->Replay.due = due;
+    }
+    sim->Replay.pos++;
+}
+
+/**
+ * Apply every recorded sample due by now; at Speed 0 the next ADC1
+ * conversion is ready as soon as the previous one was read.
+ * Return 1 if an ADC1 conversion is ready and unread
+**/
+static UBYTE SIM_Replay_Pending(SIM_ADS1263* sim, uint64_t now)
+{
+    const ADS1263_SAMPLE* s;
+
+    if (sim->Adc1.start == 0) {
+        return 0;
+    }
+    if (sim->Replay.start == 0)
+        sim->Replay.start = now;       // the replay clock runs from the first look at DRDY on
+    if (sim->Replay.config.Speed <= 0) {
+        while (sim->Replay.latest == sim->Replay.read && (s = SIM_Replay_Head(sim)) != NULL)
+            SIM_Replay_Apply(sim, s, now);
     }
     else {
-        if (Channel > 4) {
-            return 0;
+        while ((s = SIM_Replay_Head(sim)) != NULL && SIM_Replay_Due(sim, s) <= now)
+            SIM_Replay_Apply(sim, s, SIM_Replay_Due(sim, s));
+    }
+    return sim->Replay.latest > sim->Replay.read;
+}
+
+/**
+ * A time of ns at the programmed rate as the chip runs it: divided by the
+ * replay speed, 0 replaying as fast as possible, ns otherwise
+**/
+static UDOUBLE SIM_Scale_ns(SIM_ADS1263* sim, UDOUBLE ns)
+{
+    std::lock_guard<std::mutex> guard(sim->lock);
+    if (!sim->Replay.active) {
+        return ns;
+    }
+    return sim->Replay.config.Speed > 0 ? (UDOUBLE)(ns / sim->Replay.config.Speed) : 0;
+}
+
+static UBYTE SIM_DRDY_Low(SIM_ADS1263* sim, uint64_t now)
+{
+    if (sim->Replay.active)
+        return !sim->Faults.StuckDRDY && SIM_Replay_Pending(sim, now);
+    return !sim->Faults.StuckDRDY && SIM_Latest(&sim->Adc1, now) > sim->Adc1.read;
+}
+
+static UBYTE SIM_Status(SIM_ADS1263* sim, uint64_t now)
+{
+    UBYTE status = (sim->Regs[REG_POWER] >> 4) & 0x01;     // RESET flag
+    if (sim->Replay.active ? SIM_Replay_Pending(sim, now) : SIM_Latest(&sim->Adc1, now) > sim->Adc1.read)
+        status |= 0x40;
+    if (SIM_Latest(&sim->Adc2, now) > sim->Adc2.read)
+        status |= 0x80;
+    return status;
+}
+
+/**
+ * Build a data frame per INTERFACE: [status] data[4] [checksum].
+ * Return its length
+**/
+static UBYTE SIM_DataFrame(SIM_ADS1263* sim, UBYTE Adc, uint64_t now, UBYTE* out)
+{
+    SIM_CONV* conv = Adc == 1 ? &sim->Adc1 : &sim->Adc2;
+    UBYTE status = SIM_Status(sim, now), INTERFACE = sim->Regs[REG_INTERFACE];
+    int64_t k = SIM_Latest(conv, now);
+    UBYTE data[4] = { 0, 0, 0, 0 };
+    UBYTE sum = 0x9b, len = 0, i;
+    UDOUBLE code = 0;
+
+    if (sim->Replay.active) {
+        // recorded codes were calibrated when they were read; ADC2 keeps its own schedule
+        UBYTE ready = SIM_Replay_Pending(sim, now);
+        code = (UDOUBLE)sim->Replay.hold[Adc - 1][SIM_Replay_Channel(sim->Regs[Adc == 1 ? REG_INPMUX : REG_ADC2MUX])];
+        if (Adc == 1 && ready) {
+            sim->Stats.Overruns1 += sim->Replay.latest - sim->Replay.read - 1;
+            sim->Stats.Replayed++;
+            sim->Replay.read = sim->Replay.latest;
+        }
+        if (Adc == 2) {
+            code <<= 8;
+            if (k >= 0)
+                conv->read = k;
         }
-        ADS1263_SetDiffChannal(Channel);
-        // DEV_Delay_ms(2);
-        // ADS1263_WriteCmd(CMD_START1);
-        // DEV_Delay_ms(2);
-        ADS1263_WaitDRDY();
-        Value = ADS1263_Read_ADC1_Data();
     }
-    // printf("Get IN%d value success \r\n", Channel);
-    return Value;
+    else if (k >= 0) {
+        uint64_t key = Adc == 1 ? sim->Stats.Reads1 * 2 : sim->Stats.Reads2 * 2 + 1;
+        if (Adc == 1) {
+            code = (UDOUBLE)SIM_Calibrate1(sim, SIM_Convert1(sim, SIM_Completed(conv, k), key));
+            if (k > conv->read + 1)
+                sim->Stats.Overruns1 += k - conv->read - 1;
+        }
+        else {
+            code = (UDOUBLE)SIM_Calibrate2(sim, SIM_Convert2(sim, SIM_Completed(conv, k), key)) << 8;
+        }
+        conv->read = k;
+    }
+    if (Adc == 1)
+        sim->Stats.Reads1++;
+    else
+        sim->Stats.Reads2++;
+    data[0] = code >> 24;
+    data[1] = code >> 16;
+    data[2] = code >> 8;
+    data[3] = Adc == 1 ? code : 0;      // ADC2: 24 bits and a pad byte
+    for (i = 0; i < (Adc == 1 ? 4 : 3); i++)
+        sum += data[i];
+    if (sim->Faults.CrcErrorEvery != 0 && ++sim->frames % sim->Faults.CrcErrorEvery == 0)
+        sum ^= 0x01;
+
+    if (INTERFACE & 0x04)
+        out[len++] = status;
+    memcpy(&out[len], data, 4);
+    len += 4;
+    if (INTERFACE & 0x03)
+        out[len++] = sum;               // CRC mode is sent as the checksum too
+    return len;
+}
+
+static void SIM_Calibration(SIM_ADS1263* sim, UBYTE Cmd, uint64_t now)
+{
+    uint64_t key = sim->Stats.Reads1 * 2;
+    int32_t code;
+    if (Cmd == CMD_SFOCAL1 || Cmd == CMD_SYOCAL1) {
+        // the simulated front end has no offset of its own
+        code = Cmd == CMD_SYOCAL1 ? SIM_Convert1(sim, now, key) >> 8 : 0;
+        sim->Regs[REG_OFCAL0] = code;
+        sim->Regs[REG_OFCAL1] = code >> 8;
+        sim->Regs[REG_OFCAL2] = code >> 16;
+        SIM_Restart1(sim, now);
+    }
+    else if (Cmd == CMD_SYGCAL1) {
+        code = SIM_Convert1(sim, now, key);
+        if (code > 0) {
+            int64_t fsc = (int64_t)0x400000 * INT32_MAX / code;
+            sim->Regs[REG_FSCAL0] = fsc;
+            sim->Regs[REG_FSCAL1] = fsc >> 8;
+            sim->Regs[REG_FSCAL2] = fsc >> 16;
+        }
+        SIM_Restart1(sim, now);
+    }
+    else if (Cmd == CMD_SFOCAL2 || Cmd == CMD_SYOCAL2) {
+        code = Cmd == CMD_SYOCAL2 ? SIM_Convert2(sim, now, key + 1) >> 8 : 0;
+        sim->Regs[REG_ADC2OFC0] = code;
+        sim->Regs[REG_ADC2OFC1] = code >> 8;
+        SIM_Restart2(sim, now);
+    }
+    else if (Cmd == CMD_SYGCAL2) {
+        code = SIM_Convert2(sim, now, key + 1);
+        if (code > 0) {
+            int64_t fsc = (int64_t)0x4000 * 8388607 / code;
+            sim->Regs[REG_ADC2FSC0] = fsc;
+            sim->Regs[REG_ADC2FSC1] = fsc >> 8;
+        }
+        SIM_Restart2(sim, now);
+    }
+}
+
+/**
+ * A register write as the chip applies it: ID is read-only, writing POWER
+ * with RESET clear clears the status flag, conversion settings restart their ADC
+**/
+static void SIM_WriteReg(SIM_ADS1263* sim, UBYTE Reg, UBYTE Value, uint64_t now)
+{
+    if (Reg == REG_ID || Reg >= ADS1263_REG_COUNT) {
+        return;
+    }
+    sim->Regs[Reg] = Value;
+    if (Reg >= REG_MODE0 && Reg <= REG_REFMUX && Reg != REG_IDACMUX && Reg != REG_IDACMAG && sim->Adc1.start != 0)
+        SIM_Restart1(sim, now);
+    if ((Reg == REG_ADC2CFG || Reg == REG_ADC2MUX) && sim->Adc2.start != 0)
+        SIM_Restart2(sim, now);
 }
 
 /******************************************************************************
-function:  Read ADC specified channel data
+function:   Clock a CS-framed transaction through the simulated chip
 parameter:
-    Channel: Channel number
+    TxBuf : DIN bytes, NULL sends zeros
+    RxBuf : DOUT bytes, NULL discards them
+    Len   : frame length
 Info:
+    Every DIN byte that is not an RREG/WREG argument is decoded as a
+    command, the way the chip treats NOPs clocked during a data read.
+    A frame that opens with a NOP while ADC1 has new data is a direct
+    data read. Each call is one frame.
+    Return 0
 ******************************************************************************/
-UDOUBLE ADS1263_GetChannalValue_ADC2(UBYTE Channel)
+int SIM_Transfer(SIM_ADS1263* sim, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
 {
-    UDOUBLE Value = 0;
-    if (ScanMode == 0) {// 0  Single-ended input  10 channel1 Differential input  5 channe 
-        if (Channel > 10) {
-            return 0;
+    std::lock_guard<std::mutex> guard(sim->lock);
+    UBYTE out[ADS1263_REG_COUNT + 8];
+    UDOUBLE out_len = 0, out_pos = 0, i;
+    UBYTE op = 0, reg = 0, count = 0, args = 0;    // RREG/WREG in progress: args 1 count byte, 2 data bytes
+    uint64_t now = DEV_Time_ns();
+
+    sim->Stats.Transactions++;
+    sim->Stats.Bytes += Len;
+    for (i = 0; i < Len; i++) {
+        UBYTE din = TxBuf != NULL ? TxBuf[i] : 0x00;
+        UBYTE dout = 0;
+
+        if (i == 0 && din == 0x00 && SIM_DRDY_Low(sim, now))
+            out_len = SIM_DataFrame(sim, 1, now, out);
+        if (out_pos < out_len)
+            dout = out[out_pos++];
+        if (RxBuf != NULL)
+            RxBuf[i] = dout;
+
+        if (args == 1) {
+            count = (din & 0x1f) + 1;
+            args = 2;
+            if (op == CMD_RREG) {
+                // register contents shift out on the following bytes
+                for (out_len = out_pos = 0; count > 0 && reg < ADS1263_REG_COUNT; count--, reg++)
+                    out[out_len++] = sim->Regs[reg];
+                args = 0;
+            }
+            continue;
         }
-        ADS1263_SetChannal_ADC2(Channel);
-        // DEV_Delay_ms(2);
-        ADS1263_WriteCmd(CMD_START2);
-        // DEV_Delay_ms(2);
-        Value = ADS1263_Read_ADC2_Data();
-    }
-    else {
-        if (Channel > 4) {
-            return 0;
+        if (args == 2) {
+            SIM_WriteReg(sim, reg++, din, now);
+            if (--count == 0)
+                args = 0;
+            continue;
+        }
+
+        if ((din & 0xe0) == CMD_RREG || (din & 0xe0) == CMD_WREG) {
+            op = din & 0xe0;
+            reg = din & 0x1f;
+            args = 1;
+        }
+        else if ((din & 0xfe) == CMD_RESET) {
+            SIM_Reset(sim);
+        }
+        else if ((din & 0xfe) == CMD_START1) {
+            SIM_Restart1(sim, now);
+        }
+        else if ((din & 0xfe) == CMD_STOP1) {
+            sim->Adc1.start = 0;
+        }
+        else if ((din & 0xfe) == CMD_START2) {
+            SIM_Restart2(sim, now);
+        }
+        else if ((din & 0xfe) == CMD_STOP2) {
+            sim->Adc2.start = 0;
+        }
+        else if ((din & 0xfe) == CMD_RDATA1 || (din & 0xfe) == CMD_RDATA2) {
+            out_len = SIM_DataFrame(sim, (din & 0xfe) == CMD_RDATA1 ? 1 : 2, now, out);
+            out_pos = 0;
+        }
+        else if (din == CMD_SYOCAL1 || din == CMD_SYGCAL1 || din == CMD_SFOCAL1
+            || din == CMD_SYOCAL2 || din == CMD_SYGCAL2 || din == CMD_SFOCAL2) {
+            SIM_Calibration(sim, din, now);
         }
-        ADS1263_SetDiffChannal_ADC2(Channel);
-        // DEV_Delay_ms(2);
-        ADS1263_WriteCmd(CMD_START2);
-        // DEV_Delay_ms(2);
-        Value = ADS1263_Read_ADC2_Data();
     }
-    // printf("Get IN%d value success \r\n", Channel);
-    return Value;
+    return 0;
+}
+
+void SIM_Pin_Write(SIM_ADS1263* sim, SIM_PIN Pin, UBYTE Value)
+{
+    std::lock_guard<std::mutex> guard(sim->lock);
+    if (Pin == SIM_PIN_RST) {
+        if (Value && !sim->rst)
+            SIM_Reset(sim);
+        sim->rst = Value ? 1 : 0;
+    }
+    else if (Pin == SIM_PIN_CS) {
+        sim->cs = Value ? 1 : 0;
+    }
+}
+
+UBYTE SIM_Pin_Read(SIM_ADS1263* sim, SIM_PIN Pin)
+{
+    std::lock_guard<std::mutex> guard(sim->lock);
+    if (Pin == SIM_PIN_DRDY)
+        return SIM_DRDY_Low(sim, DEV_Time_ns()) ? 0 : 1;
+    return Pin == SIM_PIN_RST ? sim->rst : sim->cs;
 }
 
 /******************************************************************************
-function:  Read data from all channels
+function:   Sleep until DRDY falls
 parameter:
-    ADC_Value : ADC Value
+    DeadlineNs  : CLOCK_MONOTONIC time to give up at
+    TimestampNs : the simulated falling edge, may be NULL
 Info:
+    The next edge is known from the conversion schedule, so this sleeps
+    straight to it instead of polling.
+    Return 0 DRDY is low, 1 timed out
 ******************************************************************************/
-void ADS1263_GetAll(UBYTE* List, UDOUBLE* Value, int Number)
+int SIM_WaitDRDY(SIM_ADS1263* sim, uint64_t DeadlineNs, uint64_t* TimestampNs)
 {
-    UBYTE i;
-    for (i = 0; i < Number; i++) {
-        Value[i] = ADS1263_GetChannalValue(List[i]);
-        // ADS1263_WriteCmd(CMD_STOP1);
-        // DEV_Delay_ms(20);
+    while (1) {
+        uint64_t now = DEV_Time_ns(), next = 0;
+        {
+            std::lock_guard<std::mutex> guard(sim->lock);
+            if (SIM_DRDY_Low(sim, now)) {
+                if (TimestampNs != NULL)
+                    *TimestampNs = sim->Replay.active ? sim->Replay.due : SIM_Completed(&sim->Adc1, SIM_Latest(&sim->Adc1, now));
+                return 0;
+            }
+            if (sim->Replay.active) {
+                const ADS1263_SAMPLE* head = SIM_Replay_Head(sim);
+                if (sim->Adc1.start != 0 && head != NULL && !sim->Faults.StuckDRDY)
+                    next = SIM_Replay_Due(sim, head);
+            }
+            else if (sim->Adc1.start != 0 && !sim->Faults.StuckDRDY)
+                next = SIM_Completed(&sim->Adc1, sim->Adc1.read + 1 > SIM_Latest(&sim->Adc1, now) + 1
+                    ? sim->Adc1.read + 1 : SIM_Latest(&sim->Adc1, now) + 1);
+        }
+        if (now >= DeadlineNs) {
+            return 1;
+        }
+        // restarted or stopped meanwhile is picked up on the next pass
+        DEV_Delay_Until(next != 0 && next < DeadlineNs ? next : DeadlineNs);
     }
 }
 
 /******************************************************************************
-function:  Read data from all channels
+function:   Create a simulated ADS1263
 parameter:
-    ADC_Value : ADC Value
+    Seed : noise seed
 Info:
+    Inputs start at 0 V DC without noise, faults off.
+    Return the chip, NULL on allocation failure
 ******************************************************************************/
-void ADS1263_GetAll_ADC2(UDOUBLE* ADC_Value)
+SIM_ADS1263* SIM_Create(uint64_t Seed)
 {
-    UBYTE i;
-    for (i = 0; i < 10; i++) {
-        ADC_Value[i] = ADS1263_GetChannalValue_ADC2(i);
-        ADS1263_WriteCmd(CMD_STOP2);
-        // DEV_Delay_ms(20);
+    SIM_ADS1263* sim = new (std::nothrow) SIM_ADS1263;
+    if (sim == NULL) {
+        printf("SIM allocation failed \r\n");
+        return NULL;
     }
-    // printf("----------Read ADC2 value success----------\r\n");
+    sim->seed = SIM_Hash(Seed);
+    sim->epoch = DEV_Time_ns();
+    memset(sim->Inputs, 0, sizeof(sim->Inputs));
+    memset(&sim->Faults, 0, sizeof(sim->Faults));
+    memset(&sim->Stats, 0, sizeof(sim->Stats));
+    sim->rst = 1;
+    sim->cs = 1;
+    sim->frames = 0;
+    sim->Replay.active = 0;
+    sim->Replay.buf = NULL;
+    sim->Replay.reader.Base = NULL;
+    SIM_Reset(sim);
+    return sim;
+}
+
+void SIM_Destroy(SIM_ADS1263* sim)
+{
+    if (sim == NULL || sim == SIM_Default) {
+        return;
+    }
+    SIM_Replay(sim, NULL);
+    delete sim;
+}
+
+/**
+ * The chip behind the DEV_Module_Init port
+**/
+SIM_ADS1263* SIM_GetDefault()
+{
+    if (SIM_Default == NULL)
+        SIM_Default = SIM_Create(0);
+    return SIM_Default;
+}
+
+/**
+ * Signal on input 0..SIM_INPUTS-1 (AIN0..AIN9, AINCOM)
+**/
+void SIM_SetInput(SIM_ADS1263* sim, int Input, const SIM_INPUT* input)
+{
+    if (Input < 0 || Input >= SIM_INPUTS) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(sim->lock);
+    sim->Inputs[Input] = *input;
+}
+
+/**
+ * Fault injection; a ChipID fault shows from the next reset
+**/
+void SIM_SetFaults(SIM_ADS1263* sim, const SIM_FAULTS* faults)
+{
+    std::lock_guard<std::mutex> guard(sim->lock);
+    sim->Faults = *faults;
+}
+
+void SIM_GetStats(SIM_ADS1263* sim, SIM_STATS* stats)
+{
+    std::lock_guard<std::mutex> guard(sim->lock);
+    *stats = sim->Stats;
+}
+
+void SIM_ResetStats(SIM_ADS1263* sim)
+{
+    std::lock_guard<std::mutex> guard(sim->lock);
+    memset(&sim->Stats, 0, sizeof(sim->Stats));
 }
 
 /******************************************************************************
-function:  RTD Test function
+function:   Play a recording through the chip
 parameter:
-    delay : Conversion delay
-    gain :  Conversion gain
-    drate : speed
+    replay : recording, speed and looping; NULL ends a replay
 Info:
+    Replaces the input signals until ended. The replay clock starts when
+    the driver first looks at DRDY with ADC1 running; from then on it sees
+    recorded conversions only, at the recorded DRDY times divided by Speed,
+    and misses the ones it does not read in time as it would on hardware.
+    The register map stays the driver's, program the rates the recording
+    used. The file is mapped, blocks are decoded as they come due.
+    Return 0 success, 1 failed
 ******************************************************************************/
-UDOUBLE ADS1263_RTD(ADS1263_DELAY delay, ADS1263_GAIN gain, ADS1263_DRATE drate)
+UBYTE SIM_Replay(SIM_ADS1263* sim, const SIM_REPLAY* replay)
 {
-    UDOUBLE Value;
+    std::lock_guard<std::mutex> guard(sim->lock);
 
-    //MODE0 (CHOP OFF)
-    UBYTE MODE0 = delay;
-    ADS1263_WriteReg(REG_MODE0, MODE0);
-    DEV_Delay_ms(1);
+    if (sim->Replay.active) {
+        ADS1263_Rec_Close(&sim->Replay.reader);
+        free(sim->Replay.buf);
+        sim->Replay.buf = NULL;
+        sim->Replay.active = 0;
+    }
+    if (replay == NULL) {
+        return 0;
+    }
+    if (replay->Path == NULL || ADS1263_Rec_Open(&sim->Replay.reader, replay->Path) != 0) {
+        return 1;
+    }
+    sim->Replay.buf = (ADS1263_SAMPLE*)malloc(sim->Replay.reader.Header->BlockSamples * sizeof(ADS1263_SAMPLE));
+    if (sim->Replay.buf == NULL || ADS1263_Rec_First(&sim->Replay.reader) == 0) {
+        printf("Replay of %s failed \r\n", replay->Path);
+        ADS1263_Rec_Close(&sim->Replay.reader);
+        free(sim->Replay.buf);
+        sim->Replay.buf = NULL;
+        return 1;
+    }
+    sim->Replay.config = *replay;
+    sim->Replay.count = 0;
+    sim->Replay.pos = 0;
+    sim->Replay.next = ADS1263_Rec_First(&sim->Replay.reader);
+    sim->Replay.first_ts = ((const ADS1263_REC_BLOCK*)(sim->Replay.reader.Base + sim->Replay.next))->FirstTimestamp;
+    sim->Replay.last1 = 0;
+    sim->Replay.step = 0;
+    sim->Replay.loop_ns = 0;
+    sim->Replay.has1 = 0;
+    sim->Replay.start = 0;
+    sim->Replay.due = 0;
+    sim->Replay.latest = -1;
+    sim->Replay.read = -1;
+    memset(sim->Replay.hold, 0, sizeof(sim->Replay.hold));
+    sim->Stats.Replayed = 0;
+    sim->Stats.ReplayDone = 0;
+    sim->Replay.active = 1;
+    return 0;
+}
 
-    //(IDACMUX) IDAC2 AINCOM,IDAC1 AIN3
-    UBYTE IDACMUX = (0x0a << 4) | 0x03;
-    ADS1263_WriteReg(REG_IDACMUX, IDACMUX);
-    DEV_Delay_ms(1);
+#pragma endregion
 
-    //((IDACMAG)) IDAC2 = IDAC1 = 250uA
-    UBYTE IDACMAG = (0x03 << 4) | 0x03;
-    ADS1263_WriteReg(REG_IDACMAG, IDACMAG);
-    DEV_Delay_ms(1);
+#pragma region ADS1263
 
-    UBYTE MODE2 = (gain << 4) | drate;
-    ADS1263_WriteReg(REG_MODE2, MODE2);
-    DEV_Delay_ms(1);
+#include <atomic>
+#include <mutex>
 
-    //INPMUX (AINP = AIN7, AINN = AIN6)
-    UBYTE INPMUX = (0x07 << 4) | 0x06;
-    ADS1263_WriteReg(REG_INPMUX, INPMUX);
-    DEV_Delay_ms(1);
+/**
+ * Nominal ADC1 first-conversion latency in us, MODE0 delay 0, fCLK 7.3728 MHz
+ * Columns: sinc1, sinc2, sinc3, sinc4, FIR (FIR only exists up to 20 SPS)
+**/
+static const UDOUBLE ADS1263_FirstConversion_us[16][5] = {
+    { 400400, 800400, 1200400, 1600400, 402200 },  // 2.5 SPS
+    { 200400, 400400, 600400, 800400, 202200 },    // 5 SPS
+    { 100400, 200400, 300400, 400400, 102200 },    // 10 SPS
+    { 60400, 120400, 180400, 240400, 62200 },      // 16.6 SPS
+    { 50400, 100400, 150400, 200400, 52200 },      // 20 SPS
+    { 20400, 40400, 60400, 80400, 20400 },         // 50 SPS
+    { 17070, 33730, 50400, 67070, 17070 },         // 60 SPS
+    { 10400, 20400, 30400, 40400, 10400 },         // 100 SPS
+    { 2900, 5400, 7900, 10400, 2900 },             // 400 SPS
+    { 1230, 2070, 2900, 3730, 1230 },              // 1200 SPS
+    { 820, 1230, 1650, 2070, 820 },                // 2400 SPS
+    { 610, 820, 1020, 1230, 610 },                 // 4800 SPS
+    { 540, 680, 820, 950, 540 },                   // 7200 SPS
+    { 470, 540, 610, 680, 470 },                   // 14400 SPS
+    { 450, 500, 560, 610, 450 },                   // 19200 SPS
+    { 420, 450, 480, 500, 420 },                   // 38400 SPS
+};
 
-    // REFMUX AIN4 AIN5
-    UBYTE REFMUX = (0x03 << 3) | 0x03;
-    ADS1263_WriteReg(REG_REFMUX, REFMUX);
-    DEV_Delay_ms(1);
+/**
+ * Steady-state conversion period in ns, one per ADS1263_DRATE
+**/
+static const UDOUBLE ADS1263_Period_ns[16] = {
+    400000000, 200000000, 100000000, 60000000, 50000000, 20000000, 16666667, 10000000,
+    2500000, 833333, 416667, 208333, 138889, 69444, 52083, 26042,
+};
 
-    //Read one conversion
-    ADS1263_WriteCmd(CMD_START1);
-    DEV_Delay_ms(10);
-    ADS1263_WaitDRDY();
-    Value = ADS1263_Read_ADC1_Data();
-    ADS1263_WriteCmd(CMD_STOP1);
+/**
+ * MODE0 conversion start delay in ns, one per ADS1263_DELAY
+**/
+static const UDOUBLE ADS1263_Delay_ns[16] = {
+    0, 8700, 17000, 35000, 69000, 139000, 278000, 555000,
+    1100000, 2200000, 4400000, 8800000, 0, 0, 0, 0,
+};
 
-    return Value;
+/**
+ * Register values after reset, see ADS1263_REG
+**/
+static const UBYTE ADS1263_RegDefault[ADS1263_REG_COUNT] = {
+    0x00, 0x11, 0x05, 0x00, 0x80, 0x04, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0xBB,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x40,
+};
+
+/**
+ * ADC2 conversion period in ns, one per ADS1263_ADC2_DRATE
+**/
+static const UDOUBLE ADS1263_ADC2_Period_ns[4] = {
+    100000000, 10000000, 2500000, 1250000,
+};
+
+/**
+ * Single-producer/single-consumer sample ring.
+ * head is written only by the acquisition thread, tail only by the reader;
+ * each sits on its own cache line so neither side bounces the other's.
+**/
+typedef struct
+{
+    alignas(ADS1263_CACHE_LINE) std::atomic<uint64_t> head{ 0 };
+    alignas(ADS1263_CACHE_LINE) std::atomic<uint64_t> tail{ 0 };
+    alignas(ADS1263_CACHE_LINE) std::atomic<uint64_t> overflows{ 0 };
+    ADS1263_SAMPLE* buf = NULL;
+    uint64_t mask = 0;
+}ADS1263_RING;
+
+/**
+ * Single-producer/single-consumer queue of blocks. It holds at most the
+ * ADS1263_BLOCK_MAX blocks attached, so it never fills.
+**/
+typedef struct
+{
+    alignas(ADS1263_CACHE_LINE) std::atomic<uint64_t> head{ 0 };
+    alignas(ADS1263_CACHE_LINE) std::atomic<uint64_t> tail{ 0 };
+    ADS1263_BLOCK* slot[ADS1263_BLOCK_MAX];
+}ADS1263_BLOCK_QUEUE;
+
+/**
+ * One ADS1263: the port it sits on and everything the driver tracks about it.
+ * Handles share no state, so each can be driven from its own thread.
+ * Within one handle, an ADC1 reader and an ADC2 thread may run side by side
+ * (each frame through the port's DEV_Bus, if it has one): RegLock makes
+ * every shadow check-and-write atomic. Conv belongs to the thread reading
+ * ADC1, Conv2 to the one reading ADC2.
+**/
+struct ads1263_s {
+    DEV_PORT* port = &DEV_Default;
+    DEV_PORT own_port;          // port of a handle from ADS1263_Open
+
+    UBYTE ScanMode = 0;
+    uint64_t DRDY_Time = 0;
+    ADS1263_INIT_MODE InitMode = ADS1263_INIT_COLD;
+    ADS1263_READ_MODE ReadMode = ADS1263_READ_RDATA;
+    ADS1263_STARTUP_TIMING Startup = {};
+
+    /**
+     * Host-side shadow of the register map: what the chip holds, as far as this driver wrote it
+    **/
+    UBYTE Shadow[ADS1263_REG_COUNT] = {
+        0x00, 0x11, 0x05, 0x00, 0x80, 0x04, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0xBB,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x40,
+    };
+    uint32_t Stale = 0;             // bit per register whose last write failed: the chip may hold anything
+    std::recursive_mutex RegLock;   // Shadow and Stale, held from the shadow check to its update
+
+    /**
+     * ADC1 conversion timing as programmed, used to predict the next DRDY
+    **/
+    struct {
+        uint64_t next_ns = 0;       // predicted DRDY, 0 while ADC1 is stopped
+        UDOUBLE latency_ns = 0;     // time from the restart or last DRDY to next_ns
+    } Conv;
+
+    /**
+     * ADC2 conversion timing. ADC2 has no DRDY pin, so this is the only
+     * hint of when its status byte will flag new data.
+    **/
+    struct {
+        uint64_t next_ns = 0;       // predicted data ready, 0 while ADC2 is stopped
+    } Conv2;
+
+    ADS1263_RING Ring;              // ADC1 samples
+    ADS1263_RING Ring2;             // ADC2 samples of a dual stream
+
+    struct {
+        std::atomic<bool> running{ false };
+        std::thread thread;
+        ADS1263_STREAM_CONFIG config;
+        UBYTE Mux[ADS1263_STREAM_MAX_CHANNELS];     // INPMUX of each channel, checked at start
+        uint64_t sequence = 0;
+        uint64_t last_ns = 0;           // DRDY time of the last single-channel read, 0 none
+        std::atomic<uint64_t> missed{ 0 };
+    } Stream;
+
+    /**
+     * ADC2 side of a dual stream, touched only by the acquisition thread while it runs
+    **/
+    struct {
+        UBYTE active = 0;
+        ADS1263_STREAM_CONFIG config;
+        UBYTE Mux[ADS1263_STREAM_MAX_CHANNELS];
+        int index = 0;
+        uint64_t sequence = 0;
+    } Stream2;
+
+    /**
+     * Block delivery, see ADS1263_AttachBlocks. current and first_ns belong
+     * to the acquisition thread; the queues pass blocks between it and the
+     * consumer.
+    **/
+    struct {
+        UBYTE attached = 0;
+        ADS1263_BLOCK_CONFIG config;
+        ADS1263_CONVERTER conv;
+        ADS1263_CONVERTER conv2;
+        ADS1263_BLOCK_QUEUE free;       // consumer to acquisition thread
+        ADS1263_BLOCK_QUEUE ready;      // acquisition thread to consumer
+        ADS1263_BLOCK* current = NULL;  // being filled
+        uint64_t first_ns = 0;          // timestamp of its first sample
+        uint64_t index = 0;
+        int fd = -1;                    // eventfd, signalled once per delivered block
+        std::atomic<bool> running{ false };
+        std::thread thread;             // delivery thread of the callback mode
+        std::atomic<uint64_t> overflows{ 0 };
+    } Blocks;
+
+    /**
+     * Shared-memory publisher, written only by the acquisition thread while
+     * the stream runs
+    **/
+    struct {
+        ADS1263_SHM_HEADER* header = NULL;
+        ADS1263_SHM_SLOT* slots = NULL;
+        size_t size = 0;
+        uint64_t head = 0;
+        char name[64];
+        ADS1263_CONVERTER conv;
+        ADS1263_CONVERTER conv2;
+    } Shm;
+
+    /**
+     * Recorder, see ADS1263_StartRecord. The acquisition thread encodes into
+     * buffer produced % Buffers of the pool; the writer thread appends the
+     * buffers from written to produced and gives them back by advancing
+     * written. The writer alone touches the file, the index and the totals.
+    **/
+    struct {
+        UBYTE active = 0;
+        ADS1263_REC_CONFIG config;
+        int fd = -1;
+        UBYTE* pool = NULL;
+        size_t stride = 0;              // bytes per pool buffer
+        std::atomic<uint64_t> produced{ 0 };
+        std::atomic<uint64_t> written{ 0 };
+        std::atomic<uint64_t> drops{ 0 };
+        std::atomic<bool> running{ false };
+        std::mutex lock;
+        std::condition_variable wake;
+        std::thread thread;
+        // encoder, acquisition thread
+        ADS1263_REC_BLOCK* current = NULL;
+        UBYTE* pos = NULL;
+        uint64_t prev_ts = 0;
+        uint64_t prev_seq[2] = {};
+        UBYTE seq_set[2] = {};
+        UBYTE prev_status = 0;
+        int32_t prev_code[2][ADS1263_REC_TAG_CHANNEL + 1] = {};
+        // writer thread
+        uint64_t offset = 0;            // file size
+        uint64_t blocks = 0;
+        uint64_t samples = 0;
+        ADS1263_REC_INDEX* index = NULL;
+        uint64_t index_count = 0;
+        uint64_t index_cap = 0;
+        UBYTE error = 0;
+    } Rec;
+
+    /**
+     * Scheduler thread state. The thread keeps its statistics privately and
+     * publishes a copy each period; a reader holding the lock only delays the
+     * publish to the next period, never the scan.
+    **/
+    struct {
+        std::atomic<bool> running{ false };
+        std::atomic<bool> reset{ false };
+        std::thread thread;
+        std::mutex lock;
+        ADS1263_SCHEDULE_CONFIG config;
+        ADS1263_PROFILE profile;        // copy of config.Profile
+        ADS1263_SCHEDULE_STATS published;
+    } Schedule;
+
+    /**
+     * Hot-path counters, see ADS1263_STATS. Relaxed atomics: an update is one
+     * uncontended add on the sampling thread, readers never take a lock.
+    **/
+    struct {
+        std::atomic<uint64_t> Transactions{ 0 };
+        std::atomic<uint64_t> Bytes{ 0 };
+        std::atomic<uint64_t> TransferErrors{ 0 };
+        std::atomic<uint64_t> ChecksumErrors{ 0 };
+        std::atomic<uint64_t> DRDYWaits{ 0 };
+        std::atomic<uint64_t> DRDYTimeouts{ 0 };
+        std::atomic<uint64_t> StatusRetries{ 0 };
+        std::atomic<uint64_t> Overflows{ 0 };
+        std::atomic<uint64_t> Missed{ 0 };
+        std::atomic<uint64_t> DRDYWait[ADS1263_STATS_BINS] = {};
+        std::atomic<uint64_t> Transaction[ADS1263_STATS_BINS] = {};
+    } Stats;
+};
+
+/**
+ * The instance behind the handle-less API
+**/
+static ads1263_t ADS1263_DefaultDev;
+
+static inline void ADS1263_Count(std::atomic<uint64_t>& counter, uint64_t n = 1)
+{
+    counter.fetch_add(n, std::memory_order_relaxed);
+}
+
+/**
+ * Histogram bin of a duration, see ADS1263_STATS
+**/
+static inline void ADS1263_Count_Time(std::atomic<uint64_t>* hist, uint64_t ns)
+{
+    int bin = ns >= 1000 ? 64 - __builtin_clzll(ns / 1000) : 0;
+    ADS1263_Count(hist[bin < ADS1263_STATS_BINS ? bin : ADS1263_STATS_BINS - 1]);
+}
+
+/**
+ * A driver transaction on the device's port, counted and timed
+**/
+static int ADS1263_Transaction(ads1263_t* dev, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len)
+{
+    uint64_t start = DEV_Time_ns();
+    int ret = DEV_Port_Transaction(dev->port, TxBuf, RxBuf, Len);
+    ADS1263_Count_Time(dev->Stats.Transaction, DEV_Time_ns() - start);
+    ADS1263_Count(dev->Stats.Transactions);
+    ADS1263_Count(dev->Stats.Bytes, Len);
+    if (ret != 0)
+        ADS1263_Count(dev->Stats.TransferErrors);
+    return ret;
 }
 
 /******************************************************************************
-function:  DAC Test function
+function:   Open an ADS1263 on its own SPI device and pins
 parameter:
-    volt :          output volt value
-    isPositive :    postive or negative
-    isOpen :        open or close
+    config : spidev path, clock, pin set
 Info:
+    The handle owns its spidev fd and GPIO lines. Handles on different
+    buses or chip selects can be used from different threads at once.
+    Return the handle, NULL on failure
 ******************************************************************************/
-void ADS1263_DAC(ADS1263_DAC_VOLT volt, UBYTE isPositive, UBYTE isOpen)
+ads1263_t* ADS1263_Open(const ADS1263_PORT_CONFIG* config)
 {
-    UBYTE Reg, Value;
+    ads1263_t* dev;
 
-    if (isPositive)
-        Reg = REG_TDACP;        // IN6
-    else
-        Reg = REG_TDACN;        // IN7
+    if (config == NULL) {
+        return NULL;
+    }
+    dev = new (std::nothrow) ads1263_t;
+    if (dev == NULL) {
+        printf("ADS1263 handle allocation failed \r\n");
+        return NULL;
+    }
+    dev->port = &dev->own_port;
+    if (DEV_Port_Open(dev->port, config) != 0) {
+        delete dev;
+        return NULL;
+    }
+    return dev;
+}
 
-    if (isOpen)
-        Value = volt | 0x80;
-    else
+/******************************************************************************
+function:   Stop a handle's threads, release its port and free it
+parameter:
+    dev : handle from ADS1263_Open, the default instance is ignored
+Info:
+******************************************************************************/
+void ADS1263_Close(ads1263_t* dev)
+{
+    if (dev == NULL || dev == &ADS1263_DefaultDev) {
+        return;
+    }
+    ADS1263_Dev_StopSchedule(dev);
+    ADS1263_Dev_StopStream(dev);
+    ADS1263_Dev_DetachBlocks(dev);
+    ADS1263_Dev_StopPublish(dev);
+    ADS1263_Dev_StopRecord(dev);
+    DEV_Port_Close(dev->port);
+    free(dev->Ring.buf);
+    free(dev->Ring2.buf);
+    delete dev;
+}
+
+/******************************************************************************
+function:   Route a handle's transactions through an SPI bus arbiter
+parameter:
+    dev : handle
+    Bus : arbiter from DEV_Bus_Create, NULL for direct transfers
+Info:
+    Set while the handle is idle. ADS1263_Dev_Submit queues raw frames on
+    the same arbiter, ordered with the driver's own transactions.
+******************************************************************************/
+void ADS1263_Dev_SetBus(ads1263_t* dev, DEV_BUS* Bus)
+{
+    dev->port->bus = Bus;
+}
+
+/**
+ * Queue a raw frame for the handle's chip, see DEV_Bus_Submit
+**/
+int ADS1263_Dev_Submit(ads1263_t* dev, DEV_SPI_REQUEST* Request)
+{
+    DEV_PORT* port = dev->port;
+    Request->Port = port;
+    ADS1263_Count(dev->Stats.Transactions);
+    ADS1263_Count(dev->Stats.Bytes, Request->Len);
+    if (port->bus == NULL) {
+        Request->Result = DEV_Port_Transaction_Direct(port, Request->TxBuf, Request->RxBuf, Request->Len);
+        Request->Done = 1;
+        if (Request->Callback != NULL)
+            Request->Callback(Request);
+        return 0;
+    }
+    return DEV_Bus_Submit(port->bus, Request);
+}
+
+/**
+ * Handle of the default instance, on the port set up by DEV_Module_Init
+**/
+ads1263_t* ADS1263_GetDefault()
+{
+    return &ADS1263_DefaultDev;
+}
+
+/******************************************************************************
+function:  Conversion time of ADC1
+parameter:
+    drate  : data rate
+    filter : digital filter
+    delay  : conversion start delay
+    first  : 1 first conversion after a start or restart, 0 steady state
+Info:
+    Return time in us
+******************************************************************************/
+UDOUBLE ADS1263_ConversionTime(ADS1263_DRATE drate, ADS1263_FILTER filter, ADS1263_DELAY delay, UBYTE first)
+{
+    UDOUBLE us;
+    if (!first) {
+        return (ADS1263_Period_ns[drate & 0x0f] + 500) / 1000;
+    }
+    us = ADS1263_FirstConversion_us[drate & 0x0f][filter > ADS1263_FIR ? ADS1263_SINC1 : filter];
+    return us + ADS1263_Delay_ns[delay & 0x0f] / 1000;
+}
+
+/**
+ * Expected time from restart (first = 1) or from the last DRDY (first = 0), in ns
+**/
+static UDOUBLE ADS1263_Conv_Latency(ads1263_t* dev, UBYTE first)
+{
+    UBYTE drate = dev->Shadow[REG_MODE2] & 0x0f;
+    UBYTE filter = dev->Shadow[REG_MODE1] >> 5;
+    UBYTE delay = dev->Shadow[REG_MODE0] & 0x0f;
+    UBYTE chop = (dev->Shadow[REG_MODE0] >> 4) & 0x03;
+    UDOUBLE ns;
+
+    if (first)
+        ns = ADS1263_ConversionTime((ADS1263_DRATE)drate, (ADS1263_FILTER)filter, (ADS1263_DELAY)delay, 1) * 1000;
+    else
+        ns = ADS1263_Period_ns[drate];
+    if (chop & 0x01)
+        ns *= 2;        // input chop averages two conversions
+    if (dev->port->sim != NULL)
+        ns = SIM_Scale_ns(dev->port->sim, ns);     // a replay keeps its own pace
+    return ns;
+}
+
+/**
+ * ADC1 restarted (START1 or a write to its configuration), first-conversion latency applies
+**/
+static void ADS1263_Conv_Restart(ads1263_t* dev)
+{
+    dev->Conv.latency_ns = ADS1263_Conv_Latency(dev, 1);
+    dev->Conv.next_ns = DEV_Time_ns() + dev->Conv.latency_ns;
+}
+
+/**
+ * A conversion was consumed at Time, the next one follows one period later
+**/
+static void ADS1263_Conv_Advance(ads1263_t* dev, uint64_t Time)
+{
+    if (dev->Conv.next_ns == 0)
+        return;
+    dev->Conv.latency_ns = ADS1263_Conv_Latency(dev, 0);
+    dev->Conv.next_ns = Time + dev->Conv.latency_ns;
+}
+
+/**
+ * Registers Reg..Reg+Count-1 were written: the shadow holds the new values,
+ * a write to the ADC1 configuration restarts its conversion
+**/
+static void ADS1263_Conv2_Restart(ads1263_t* dev);
+
+static void ADS1263_Conv_RegsWritten(ads1263_t* dev, UBYTE Reg, UBYTE Count)
+{
+    if (Reg <= REG_REFMUX && Reg + Count > REG_MODE0 && dev->Conv.next_ns != 0)
+        ADS1263_Conv_Restart(dev);
+    if (Reg <= REG_ADC2MUX && Reg + Count > REG_ADC2CFG && dev->Conv2.next_ns != 0)
+        ADS1263_Conv2_Restart(dev);
+}
+
+/**
+ * ADC2 restarted (START2 or a write to ADC2CFG/ADC2MUX), the sinc3 filter refills
+**/
+static void ADS1263_Conv2_Restart(ads1263_t* dev)
+{
+    UDOUBLE period = ADS1263_ADC2_Period_ns[dev->Shadow[REG_ADC2CFG] >> 6];
+    dev->Conv2.next_ns = DEV_Time_ns() + (uint64_t)period * ADS1263_ADC2_SETTLE_PERIODS;
+}
+
+/**
+ * An ADC2 conversion was consumed at Time, the next one follows one period later
+**/
+static void ADS1263_Conv2_Advance(ads1263_t* dev, uint64_t Time)
+{
+    if (dev->Conv2.next_ns == 0)
+        return;
+    dev->Conv2.next_ns = Time + ADS1263_ADC2_Period_ns[dev->Shadow[REG_ADC2CFG] >> 6];
+}
+
+/******************************************************************************
+function:   Module reset
+parameter:
+Info:
+******************************************************************************/
+static void ADS1263_reset(ads1263_t* dev)
+{
+    DEV_Port_Write(dev->port, dev->port->rst, 1);
+    DEV_Port_Write(dev->port, dev->port->rst, 0);
+    DEV_Delay_us(ADS1263_RESET_PULSE_US);
+    DEV_Port_Write(dev->port, dev->port->rst, 1);
+    DEV_Delay_us(ADS1263_RESET_WAIT_US);
+    memcpy(dev->Shadow, ADS1263_RegDefault, ADS1263_REG_COUNT);
+    dev->Stale = 0;
+    dev->Conv.next_ns = 0;
+    dev->Conv2.next_ns = 0;
+}
+
+/******************************************************************************
+function:   send command
+parameter:
+        Cmd: command
+Info:
+******************************************************************************/
+static void ADS1263_WriteCmd(ads1263_t* dev, UBYTE Cmd)
+{
+    ADS1263_Transaction(dev, &Cmd, NULL, 1);
+    if ((Cmd & 0xfe) == CMD_START1)
+        ADS1263_Conv_Restart(dev);
+    else if ((Cmd & 0xfe) == CMD_STOP1)
+        dev->Conv.next_ns = 0;
+    else if ((Cmd & 0xfe) == CMD_START2)
+        ADS1263_Conv2_Restart(dev);
+    else if ((Cmd & 0xfe) == CMD_STOP2)
+        dev->Conv2.next_ns = 0;
+    else if ((Cmd & 0xfe) == CMD_RESET) {
+        memcpy(dev->Shadow, ADS1263_RegDefault, ADS1263_REG_COUNT);
+        dev->Stale = 0;
+        dev->Conv.next_ns = 0;
+        dev->Conv2.next_ns = 0;
+    }
+}
+
+/**
+ * The chip holds Value in Reg as far as the driver knows: the shadow
+ * matches and no write to Reg has failed since
+**/
+static inline UBYTE ADS1263_Shadow_Holds(ads1263_t* dev, UBYTE Reg, UBYTE Value)
+{
+    return dev->Shadow[Reg] == Value && !(dev->Stale & (1u << Reg));
+}
+
+/**
+ * Registers Reg..Reg+Count-1 were sent: the shadow takes the values only if
+ * the transfer succeeded, else the range is stale until written again
+**/
+static void ADS1263_Shadow_Written(ads1263_t* dev, UBYTE Reg, const UBYTE* data, UBYTE Count, int ret)
+{
+    uint32_t mask = ((1u << Count) - 1) << Reg;
+
+    if (ret != 0) {
+        dev->Stale |= mask;
+        return;
+    }
+    memcpy(&dev->Shadow[Reg], data, Count);
+    dev->Stale &= ~mask;
+}
+
+/******************************************************************************
+function:   Write a data to the destination register
+parameter:
+        Reg : Target register
+        data: Written data
+Info:
+******************************************************************************/
+static void ADS1263_WriteReg(ads1263_t* dev, UBYTE Reg, UBYTE data)
+{
+    ADS1263_Dev_WriteRegisters(dev, Reg, &data, 1);
+}
+
+/******************************************************************************
+function:   Write a register only if the shadow says it differs
+parameter:
+        Reg : Target register
+        data: Written data
+Info:
+******************************************************************************/
+static void ADS1263_SetReg(ads1263_t* dev, UBYTE Reg, UBYTE data)
+{
+    std::lock_guard<std::recursive_mutex> lock(dev->RegLock);
+    if (!ADS1263_Shadow_Holds(dev, Reg, data))
+        ADS1263_WriteReg(dev, Reg, data);
+}
+
+/******************************************************************************
+function:   Write consecutive registers with one WREG
+parameter:
+        Reg  : first register
+        data : values
+        Count: number of registers, 1..ADS1263_REG_COUNT
+Info:
+    The shadow takes the values only if the transfer succeeds; after a
+    failure the range is resent by the next write, whatever the shadow says.
+    Return 0 success, 1 invalid range or transfer failed
+******************************************************************************/
+UBYTE ADS1263_Dev_WriteRegisters(ads1263_t* dev, UBYTE Reg, const UBYTE* data, UBYTE Count)
+{
+    UBYTE tx[ADS1263_MAX_FRAME_LEN];
+    int ret;
+
+    if (Count == 0 || Reg + Count > ADS1263_REG_COUNT) {
+        return 1;
+    }
+    tx[0] = CMD_WREG | Reg;
+    tx[1] = CMD_WREG2 | (Count - 1);
+    memcpy(&tx[2], data, Count);
+    std::lock_guard<std::recursive_mutex> lock(dev->RegLock);
+    ret = ADS1263_Transaction(dev, tx, NULL, Count + 2);
+    ADS1263_Shadow_Written(dev, Reg, data, Count, ret);
+    // a failed write may still have reached the chip, assume the restart
+    ADS1263_Conv_RegsWritten(dev, Reg, Count);
+    return ret != 0 ? 1 : 0;
+}
+
+/******************************************************************************
+function:   Read consecutive registers with one RREG
+parameter:
+        Reg  : first register
+        data : values read
+        Count: number of registers, 1..ADS1263_REG_COUNT
+Info:
+    The shadow is not touched, compare against it with ADS1263_GetRegisters.
+    Return 0 success, 1 invalid range or transfer failed (data not written)
+******************************************************************************/
+UBYTE ADS1263_Dev_ReadRegisters(ads1263_t* dev, UBYTE Reg, UBYTE* data, UBYTE Count)
+{
+    UBYTE tx[ADS1263_MAX_FRAME_LEN];
+    UBYTE rx[ADS1263_MAX_FRAME_LEN];
+
+    if (Count == 0 || Reg + Count > ADS1263_REG_COUNT) {
+        return 1;
+    }
+    memset(tx, 0, Count + 2);
+    tx[0] = CMD_RREG | Reg;
+    tx[1] = CMD_RREG2 | (Count - 1);
+    if (ADS1263_Transaction(dev, tx, rx, Count + 2) != 0) {
+        return 1;
+    }
+    memcpy(data, &rx[2], Count);
+    return 0;
+}
+
+/******************************************************************************
+function:   Copy of the shadow register map
+parameter:
+        Regs : ADS1263_REG_COUNT bytes
+Info:
+******************************************************************************/
+void ADS1263_Dev_GetRegisters(ads1263_t* dev, UBYTE* Regs)
+{
+    memcpy(Regs, dev->Shadow, ADS1263_REG_COUNT);
+}
+
+/******************************************************************************
+function:   Bring the chip to a desired register map
+parameter:
+        Regs : ADS1263_REG_COUNT bytes, REG_ID is ignored
+Info:
+    Only registers that differ from the shadow are sent. Changed registers
+    are grouped into WREG runs (short unchanged gaps are rewritten rather
+    than paying for a new opcode) and all runs go out in one transaction.
+    Registers whose last write failed count as changed.
+    Return number of registers written, ADS1263_COMMIT_FAILED if the
+    transfer failed (the shadow is then left as it was)
+******************************************************************************/
+UBYTE ADS1263_Dev_CommitRegisters(ads1263_t* dev, const UBYTE* Regs)
+{
+    UBYTE tx[ADS1263_MAX_FRAME_LEN];
+    UDOUBLE len = 0;
+    UBYTE Reg = REG_POWER, first, last, r, written = 0;
+    uint32_t mask = 0;
+    int restart = 0, restart2 = 0, ret;
+    std::lock_guard<std::recursive_mutex> lock(dev->RegLock);
+
+    while (Reg < ADS1263_REG_COUNT) {
+        if (ADS1263_Shadow_Holds(dev, Reg, Regs[Reg])) {
+            Reg++;
+            continue;
+        }
+        first = last = Reg;
+        for (r = Reg + 1; r < ADS1263_REG_COUNT; r++) {
+            if (!ADS1263_Shadow_Holds(dev, r, Regs[r]))
+                last = r;
+            else if (r - last > ADS1263_WREG_GAP)
+                break;
+        }
+        tx[len++] = CMD_WREG | first;
+        tx[len++] = CMD_WREG2 | (last - first);
+        memcpy(&tx[len], &Regs[first], last - first + 1);
+        len += last - first + 1;
+        written += last - first + 1;
+        mask |= ((1u << (last - first + 1)) - 1) << first;
+        if (first <= REG_REFMUX && last >= REG_MODE0)
+            restart = 1;
+        if (first <= REG_ADC2MUX && last >= REG_ADC2CFG)
+            restart2 = 1;
+        Reg = last + 1;
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    ret = ADS1263_Transaction(dev, tx, NULL, len);
+    // a failed write may still have reached the chip, assume the restart
+    if (restart)
+        ADS1263_Conv_RegsWritten(dev, REG_MODE0, 1);
+    if (restart2)
+        ADS1263_Conv_RegsWritten(dev, REG_ADC2CFG, 1);
+    if (ret != 0) {
+        dev->Stale |= mask;
+        return ADS1263_COMMIT_FAILED;
+    }
+    memcpy(&dev->Shadow[REG_POWER], &Regs[REG_POWER], ADS1263_REG_COUNT - REG_POWER);
+    dev->Stale &= ~mask;
+    return written;
+}
+
+/******************************************************************************
+function:   Check the chip's register map against the shadow
+parameter:
+Info:
+    One RREG burst of the whole map. REG_ID and the POWER reset flag are
+    not compared.
+    Return number of mismatched registers, ADS1263_REG_COUNT if the map
+    could not be read
+******************************************************************************/
+UBYTE ADS1263_Dev_VerifyRegisters(ads1263_t* dev)
+{
+    UBYTE Regs[ADS1263_REG_COUNT];
+    UBYTE Reg, mismatch = 0;
+
+    if (ADS1263_Dev_ReadRegisters(dev, REG_ID, Regs, ADS1263_REG_COUNT) != 0) {
+        printf("Register read failed \r\n");
+        return ADS1263_REG_COUNT;
+    }
+    dev->Shadow[REG_ID] = Regs[REG_ID];
+    for (Reg = REG_POWER; Reg < ADS1263_REG_COUNT; Reg++) {
+        UBYTE mask = Reg == REG_POWER ? 0xef : 0xff;
+        if ((Regs[Reg] & mask) != (dev->Shadow[Reg] & mask)) {
+            printf("REG %02x: read %02x, expected %02x \r\n", Reg, Regs[Reg], dev->Shadow[Reg]);
+            mismatch++;
+        }
+    }
+    return mismatch;
+}
+
+/******************************************************************************
+function:   Read a data from the destination register
+parameter:
+        Reg : Target register
+Info:
+    Return the read data
+******************************************************************************/
+static UBYTE ADS1263_Read_data(ads1263_t* dev, UBYTE Reg)
+{
+    UBYTE tx[ADS1263_REG_FRAME_LEN] = { (UBYTE)(CMD_RREG | Reg), CMD_RREG2, 0x00 };
+    UBYTE rx[ADS1263_REG_FRAME_LEN] = { 0, 0, 0 };
+    ADS1263_Transaction(dev, tx, rx, ADS1263_REG_FRAME_LEN);
+    return rx[2];
+}
+
+/******************************************************************************
+function:   Check data
+parameter:
+        val : 4 bytes(ADC2 is 3 bytes) data
+        byt : CRC byte
+Info:
+        Check success, return 0
+******************************************************************************/
+static UBYTE ADS1263_Checksum(UDOUBLE val, UBYTE byt)
+{
+    UBYTE sum = 0;
+    UBYTE mask = -1;        // 8 bits mask, 0xff
+    while (val) {
+        sum += val & mask;  // only add the lower values
+        val >>= 8;          // shift down
+    }
+    sum += 0x9b;
+    // printf("--- %x %x--- \r\n", sum, byt);
+    return sum ^ byt;       // if equal, this will be 0
+}
+
+/******************************************************************************
+function:   Waiting for a busy end
+parameter:
+Info:
+    Timeout indicates that the operation is not working properly.
+******************************************************************************/
+static UBYTE ADS1263_WaitDRDY(ads1263_t* dev)
+{
+    // printf("ADS1263_WaitDRDY \r\n");
+    UDOUBLE timeout_ms = ADS1263_DRDY_TIMEOUT_MS;
+    uint64_t now = DEV_Time_ns(), start = now;
+    uint64_t expected = dev->Conv.next_ns;
+
+    if (expected != 0) {
+        // sleep through most of the conversion, then wait for the edge itself
+        UDOUBLE guard = ADS1263_DRDY_GUARD_NS + dev->Conv.latency_ns / 16;
+        if (expected > now + guard) {
+            struct timespec ts;
+            uint64_t wake = expected - guard;
+            ts.tv_sec = wake / 1000000000ull;
+            ts.tv_nsec = wake % 1000000000ull;
+            while (DEV_Syscall(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR);
+            now = DEV_Time_ns();
+        }
+        // deadline: the predicted edge plus half a conversion of slack, never past the hard limit
+        uint64_t deadline = expected + dev->Conv.latency_ns / 2 + ADS1263_DRDY_SLACK_NS;
+        if (deadline > now && (deadline - now) / 1000000 + 1 < timeout_ms)
+            timeout_ms = (UDOUBLE)((deadline - now) / 1000000 + 1);
+    }
+    if (DEV_Port_WaitLow(dev->port, dev->port->drdy, timeout_ms, &dev->DRDY_Time) != 0) {
+        printf("Time Out ...\r\n");
+        now = DEV_Time_ns();
+        ADS1263_Conv_Advance(dev, now);
+        ADS1263_Count(dev->Stats.DRDYWaits);
+        ADS1263_Count(dev->Stats.DRDYTimeouts);
+        ADS1263_Count_Time(dev->Stats.DRDYWait, now - start);
+        return 1;
+    }
+    ADS1263_Conv_Advance(dev, dev->DRDY_Time);
+    ADS1263_Count(dev->Stats.DRDYWaits);
+    ADS1263_Count_Time(dev->Stats.DRDYWait, DEV_Time_ns() - start);
+    // printf("ADS1263_WaitDRDY Release \r\n");
+    return 0;
+}
+
+/******************************************************************************
+function:  Time of the last DRDY falling edge
+parameter:
+Info:
+    CLOCK_MONOTONIC ns, from the kernel edge event when available
+******************************************************************************/
+uint64_t ADS1263_Dev_GetDRDYTimestamp(ads1263_t* dev)
+{
+    return dev->DRDY_Time;
+}
+
+/******************************************************************************
+function:  Read device ID
+parameter:
+Info:
+******************************************************************************/
+UBYTE ADS1263_Dev_ReadChipID(ads1263_t* dev)
+{
+    UBYTE id;
+    id = ADS1263_Read_data(dev, REG_ID);
+    dev->Shadow[REG_ID] = id;
+    return id >> 5;
+}
+
+/******************************************************************************
+function:  Setting mode
+parameter:
+    Mode : 0 Single-ended input
+           1 channel1 Differential input
+Info:
+******************************************************************************/
+void ADS1263_Dev_SetMode(ads1263_t* dev, UBYTE Mode)
+{
+    if (Mode == 0) {
+        dev->ScanMode = 0;
+    }
+    else {
+        dev->ScanMode = 1;
+    }
+}
+
+/******************************************************************************
+function:   Apply the ADC1 configuration to a register map
+parameter:
+        Regs : ADS1263_REG_COUNT bytes, modified in place
+Info:
+******************************************************************************/
+static void ADS1263_ConfigADC1_Map(UBYTE* Regs, ADS1263_GAIN gain, ADS1263_DRATE drate, ADS1263_DELAY delay)
+{
+    UBYTE MODE2 = 0x80;             //0x80:PGA bypassed, 0x00:PGA enabled
+    MODE2 |= (gain << 4) | drate;
+    Regs[REG_MODE2] = MODE2;
+
+    UBYTE REFMUX = 0x24;        //0x00:+-2.5V as REF, 0x24:VDD,VSS as REF
+    Regs[REG_REFMUX] = REFMUX;
+
+    UBYTE MODE0 = delay;
+    Regs[REG_MODE0] = MODE0;
+
+    UBYTE MODE1 = 0x84; // Digital Filter; 0x84:FIR, 0x64:Sinc4, 0x44:Sinc3, 0x24:Sinc2, 0x04:Sinc1
+    Regs[REG_MODE1] = MODE1;
+}
+
+/******************************************************************************
+function:  Configure ADC gain and sampling speed
+parameter:
+    gain : Enumeration type gain
+    drate: Enumeration type sampling speed
+Info:
+******************************************************************************/
+void ADS1263_Dev_ConfigADC1(ads1263_t* dev, ADS1263_GAIN gain, ADS1263_DRATE drate, ADS1263_DELAY delay)
+{
+    UBYTE Regs[ADS1263_REG_COUNT];
+    ADS1263_Dev_GetRegisters(dev, Regs);
+    ADS1263_ConfigADC1_Map(Regs, gain, drate, delay);
+    ADS1263_Dev_CommitRegisters(dev, Regs);
+}
+
+/******************************************************************************
+function:   Apply the ADC2 configuration to a register map
+parameter:
+        Regs : ADS1263_REG_COUNT bytes, modified in place
+Info:
+******************************************************************************/
+static void ADS1263_ConfigADC2_Map(UBYTE* Regs, ADS1263_ADC2_GAIN gain, ADS1263_ADC2_DRATE drate, ADS1263_DELAY delay)
+{
+    UBYTE ADC2CFG = 0x20;               //REF, 0x20:VAVDD and VAVSS, 0x00:+-2.5V
+    ADC2CFG |= (drate << 6) | gain;
+    Regs[REG_ADC2CFG] = ADC2CFG;
+
+    UBYTE MODE0 = delay;
+    Regs[REG_MODE0] = MODE0;
+}
+
+/******************************************************************************
+function:  Configure ADC gain and sampling speed
+parameter:
+    gain : Enumeration type gain
+    drate: Enumeration type sampling speed
+Info:
+******************************************************************************/
+void ADS1263_Dev_ConfigADC2(ads1263_t* dev, ADS1263_ADC2_GAIN gain, ADS1263_ADC2_DRATE drate, ADS1263_DELAY delay)
+{
+    UBYTE Regs[ADS1263_REG_COUNT];
+    ADS1263_Dev_GetRegisters(dev, Regs);
+    ADS1263_ConfigADC2_Map(Regs, gain, drate, delay);
+    ADS1263_Dev_CommitRegisters(dev, Regs);
+}
+
+/******************************************************************************
+function:   Select cold or warm initialization
+parameter:
+    Mode : ADS1263_INIT_COLD always resets the chip,
+           ADS1263_INIT_WARM keeps a chip that already holds the configuration
+Info:
+******************************************************************************/
+void ADS1263_Dev_SetInitMode(ads1263_t* dev, ADS1263_INIT_MODE Mode)
+{
+    dev->InitMode = Mode;
+}
+
+/******************************************************************************
+function:   Phase timings of the last ADS1263_init_ADC1/ADC2
+parameter:
+    Timing : filled in, all times in ns
+Info:
+******************************************************************************/
+void ADS1263_Dev_GetStartupTiming(ads1263_t* dev, ADS1263_STARTUP_TIMING* Timing)
+{
+    *Timing = dev->Startup;
+}
+
+/******************************************************************************
+function:   Select how ADC1 conversions are read
+parameter:
+    Mode     : ADS1263_READ_RDATA or ADS1263_READ_DIRECT
+    Status   : 1 to send the status byte in data frames
+    Checksum : 1 to send the checksum byte
+Info:
+    A direct read clocks the frame out on NOPs right after DRDY: one
+    transfer of 4..6 bytes per conversion, no command byte and no status
+    polling. It must start after DRDY falls and finish before the next
+    conversion. Status and checksum are INTERFACE settings and shape the
+    RDATA1/RDATA2 frames too. Without the status byte, new data cannot be
+    told from old: ADC1 trusts DRDY, ADC2 its predicted conversion time.
+******************************************************************************/
+void ADS1263_Dev_SetReadMode(ads1263_t* dev, ADS1263_READ_MODE Mode, UBYTE Status, UBYTE Checksum)
+{
+    UBYTE INTERFACE = dev->Shadow[REG_INTERFACE] & 0x08;   // keep TIMEOUT
+    if (Status)
+        INTERFACE |= 0x04;
+    if (Checksum)
+        INTERFACE |= 0x01;
+    ADS1263_SetReg(dev, REG_INTERFACE, INTERFACE);
+    dev->ReadMode = Mode;
+}
+
+/******************************************************************************
+function:   Reuse the chip as it is if it already holds the wanted register map
+parameter:
+    Regs : wanted map, mux registers are not compared
+Info:
+    One RREG burst of the whole map. On a match the shadow adopts the chip's
+    state and no reset is needed.
+    Return 1 when the chip can be kept, 0 when it needs a reset
+******************************************************************************/
+static UBYTE ADS1263_WarmMatch(ads1263_t* dev, const UBYTE* Regs)
+{
+    UBYTE Chip[ADS1263_REG_COUNT];
+    UBYTE Reg;
+
+    if (ADS1263_Dev_ReadRegisters(dev, REG_ID, Chip, ADS1263_REG_COUNT) != 0
+        || (Chip[REG_ID] >> 5) != 1) {
+        return 0;
+    }
+    for (Reg = REG_POWER; Reg < ADS1263_REG_COUNT; Reg++) {
+        UBYTE mask = Reg == REG_POWER ? 0xef : 0xff;
+        if (Reg == REG_INPMUX || Reg == REG_ADC2MUX)
+            continue;
+        if ((Chip[Reg] & mask) != (Regs[Reg] & mask))
+            return 0;
+    }
+    memcpy(dev->Shadow, Chip, ADS1263_REG_COUNT);
+    dev->Stale = 0;
+    dev->Conv.next_ns = 0;
+    dev->Conv2.next_ns = 0;
+    return 1;
+}
+
+/******************************************************************************
+function:   Shared init path: probe, reset, chip ID and configuration, timed
+parameter:
+    Regs : wanted register map, built from the reset defaults
+    Stop : CMD_STOP1 or CMD_STOP2, sent before configuring
+Info:
+    Return 0 success, 1 chip ID mismatch
+******************************************************************************/
+static UBYTE ADS1263_Startup_Run(ads1263_t* dev, const UBYTE* Regs, UBYTE Stop)
+{
+    uint64_t start = DEV_Time_ns(), t;
+
+    memset(&dev->Startup, 0, sizeof(dev->Startup));
+    dev->Startup.Module = DEV_Module_Init_ns;
+    if (dev->InitMode == ADS1263_INIT_WARM) {
+        dev->Startup.Warm = ADS1263_WarmMatch(dev, Regs);
+        dev->Startup.Probe = DEV_Time_ns() - start;
+    }
+
+    if (!dev->Startup.Warm) {
+        t = DEV_Time_ns();
+        ADS1263_reset(dev);
+        dev->Startup.Reset = DEV_Time_ns() - t;
+
+        t = DEV_Time_ns();
+        if (ADS1263_Dev_ReadChipID(dev) == 1) {
+            printf("ID Read success \r\n");
+        }
+        else {
+            printf("ID Read failed \r\n");
+            return 1;
+        }
+        dev->Startup.ChipID = DEV_Time_ns() - t;
+
+        t = DEV_Time_ns();
+        ADS1263_WriteCmd(dev, Stop);
+        ADS1263_Dev_CommitRegisters(dev, Regs);
+        dev->Startup.Config = DEV_Time_ns() - t;
+    }
+    dev->Startup.Total = DEV_Time_ns() - start;
+
+    printf("Startup %s: module %.3f ms, probe %.3f ms, reset %.3f ms, id %.3f ms, config %.3f ms, total %.3f ms \r\n",
+        dev->Startup.Warm ? "warm" : "cold",
+        dev->Startup.Module / 1e6, dev->Startup.Probe / 1e6, dev->Startup.Reset / 1e6,
+        dev->Startup.ChipID / 1e6, dev->Startup.Config / 1e6, dev->Startup.Total / 1e6);
+    return 0;
+}
+
+/******************************************************************************
+function:  Device initialization
+parameter:
+Info:
+******************************************************************************/
+UBYTE ADS1263_Dev_init_ADC1(ads1263_t* dev, ADS1263_DRATE rate)
+{
+    UBYTE Regs[ADS1263_REG_COUNT];
+    memcpy(Regs, ADS1263_RegDefault, ADS1263_REG_COUNT);
+    ADS1263_ConfigADC1_Map(Regs, ADS1263_GAIN_1, rate, ADS1263_DELAY_35us);
+
+    if (ADS1263_Startup_Run(dev, Regs, CMD_STOP1)) {
+        return 1;
+    }
+    ADS1263_WriteCmd(dev, CMD_START1);
+    return 0;
+}
+UBYTE ADS1263_Dev_init_ADC2(ads1263_t* dev, ADS1263_ADC2_DRATE rate)
+{
+    UBYTE Regs[ADS1263_REG_COUNT];
+    memcpy(Regs, ADS1263_RegDefault, ADS1263_REG_COUNT);
+    ADS1263_ConfigADC2_Map(Regs, ADS1263_ADC2_GAIN_1, rate, ADS1263_DELAY_35us);
+
+    if (ADS1263_Startup_Run(dev, Regs, CMD_STOP2)) {
+        return 1;
+    }
+    return 0;
+}
+
+/******************************************************************************
+function:  Device initialization for concurrent ADC1 and ADC2 use
+parameter:
+    rate  : ADC1 data rate
+    rate2 : ADC2 data rate
+Info:
+    Both configurations go out in one startup, so the chip is reset at most
+    once (init_ADC1 followed by init_ADC2 resets it twice). Both ADCs are
+    left converting.
+    Return 0 success, 1 chip ID mismatch
+******************************************************************************/
+UBYTE ADS1263_Dev_init_Dual(ads1263_t* dev, ADS1263_DRATE rate, ADS1263_ADC2_DRATE rate2)
+{
+    UBYTE Regs[ADS1263_REG_COUNT];
+    memcpy(Regs, ADS1263_RegDefault, ADS1263_REG_COUNT);
+    ADS1263_ConfigADC1_Map(Regs, ADS1263_GAIN_1, rate, ADS1263_DELAY_35us);
+    ADS1263_ConfigADC2_Map(Regs, ADS1263_ADC2_GAIN_1, rate2, ADS1263_DELAY_35us);
+
+    if (ADS1263_Startup_Run(dev, Regs, CMD_STOP1)) {
+        return 1;
+    }
+    ADS1263_WriteCmd(dev, CMD_START1);
+    ADS1263_WriteCmd(dev, CMD_START2);
+    return 0;
+}
+
+/******************************************************************************
+function:  Set the channel to be read
+parameter:
+    Channal : Set channel number
+Info:
+******************************************************************************/
+static void ADS1263_SetChannal(ads1263_t* dev, UBYTE Channal)
+{
+    if (Channal > 10) {
+        return;
+    }
+    UBYTE INPMUX = (Channal << 4) | 0x0a;       //0x0a:VCOM as Negative Input
+    ADS1263_SetReg(dev, REG_INPMUX, INPMUX);
+}
+
+/******************************************************************************
+function:  Set the channel to be read
+parameter:
+    Channal : Set channel number
+Info:
+******************************************************************************/
+static void ADS1263_SetChannal_ADC2(ads1263_t* dev, UBYTE Channal)
+{
+    if (Channal > 10) {
+        return;
+    }
+    UBYTE INPMUX = (Channal << 4) | 0x0a;       //0x0a:VCOM as Negative Input
+    ADS1263_SetReg(dev, REG_ADC2MUX, INPMUX);
+}
+
+/******************************************************************************
+function:  Set the channel to be read
+parameter:
+    Channal : Set channel number
+Info:
+******************************************************************************/
+static void ADS1263_SetDiffChannal(ads1263_t* dev, UBYTE Channal)
+{
+    UBYTE INPMUX = dev->Shadow[REG_INPMUX];
+    if (Channal == 0) {
+        INPMUX = (0 << 4) | 1;    //DiffChannal   AIN0-AIN1
+    }
+    else if (Channal == 1) {
+        INPMUX = (2 << 4) | 3;    //DiffChannal   AIN2-AIN3
+    }
+    else if (Channal == 2) {
+        INPMUX = (4 << 4) | 5;    //DiffChannal   AIN4-AIN5
+    }
+    else if (Channal == 3) {
+        INPMUX = (6 << 4) | 7;    //DiffChannal   AIN6-AIN7
+    }
+    else if (Channal == 4) {
+        INPMUX = (8 << 4) | 9;    //DiffChannal   AIN8-AIN9
+    }
+    ADS1263_SetReg(dev, REG_INPMUX, INPMUX);
+}
+
+/******************************************************************************
+function:  Set the channel to be read
+parameter:
+    Channal : Set channel number
+Info:
+******************************************************************************/
+static void ADS1263_SetDiffChannal_ADC2(ads1263_t* dev, UBYTE Channal)
+{
+    UBYTE INPMUX = dev->Shadow[REG_ADC2MUX];
+    if (Channal == 0) {
+        INPMUX = (0 << 4) | 1;    //DiffChannal   AIN0-AIN1
+    }
+    else if (Channal == 1) {
+        INPMUX = (2 << 4) | 3;    //DiffChannal   AIN2-AIN3
+    }
+    else if (Channal == 2) {
+        INPMUX = (4 << 4) | 5;    //DiffChannal   AIN4-AIN5
+    }
+    else if (Channal == 3) {
+        INPMUX = (6 << 4) | 7;    //DiffChannal   AIN6-AIN7
+    }
+    else if (Channal == 4) {
+        INPMUX = (8 << 4) | 9;    //DiffChannal   AIN8-AIN9
+    }
+    ADS1263_SetReg(dev, REG_ADC2MUX, INPMUX);
+}
+
+/******************************************************************************
+function:  Route a channel to ADC1 according to ScanMode
+parameter:
+    Channel: Channel number
+Info:
+    Return 0 success, 1 channel out of range
+******************************************************************************/
+static UBYTE ADS1263_ChannalMux(ads1263_t* dev, UBYTE Channel, UBYTE* Mux)
+{
+    if (dev->ScanMode == 0) {
+        if (Channel > 10) {
+            return 1;
+        }
+        *Mux = (Channel << 4) | 0x0a;               //0x0a:VCOM as Negative Input
+    }
+    else {
+        if (Channel > 4) {
+            return 1;
+        }
+        *Mux = ((Channel * 2) << 4) | (Channel * 2 + 1);  //AIN(2n)-AIN(2n+1)
+    }
+    return 0;
+}
+
+static UBYTE ADS1263_SelectChannal(ads1263_t* dev, UBYTE Channel)
+{
+    if (dev->ScanMode == 0) {// 0  Single-ended input  10 channel1 Differential input  5 channe 
+        if (Channel > 10) {
+            return 1;
+        }
+        ADS1263_SetChannal(dev, Channel);
+    }
+    else {
+        if (Channel > 4) {
+            return 1;
+        }
+        ADS1263_SetDiffChannal(dev, Channel);
+    }
+    return 0;
+}
+
+/******************************************************************************
+function:  Data frame length under the current INTERFACE setting
+parameter:
+    Prefix : 1 for RDATA1/RDATA2 (opcode slot), 0 for a direct read
+Info:
+    [status] data[4] [checksum]; ADC2 sends 4 data bytes too, the last is padding
+******************************************************************************/
+static UBYTE ADS1263_Frame_Len(ads1263_t* dev, UBYTE Prefix)
+{
+    UBYTE INTERFACE = dev->Shadow[REG_INTERFACE];
+    return Prefix + ((INTERFACE & 0x04) ? 1 : 0) + 4 + ((INTERFACE & 0x03) ? 1 : 0);
+}
+
+/******************************************************************************
+function:  Bring a received data frame to the full RDATA layout
+parameter:
+    rx     : frame as received
+    Prefix : see ADS1263_Frame_Len
+    frame  : opcode slot, status, data[4], CRC
+Info:
+    A missing status byte reads as new data on both ADCs.
+    Return 1 if the frame carries a checksum to verify (CRC mode is not checked)
+******************************************************************************/
+static UBYTE ADS1263_Frame_Normalize(ads1263_t* dev, const UBYTE* rx, UBYTE Prefix, UBYTE* frame)
+{
+    UBYTE INTERFACE = dev->Shadow[REG_INTERFACE];
+    const UBYTE* p = rx + Prefix;
+
+    frame[0] = 0;
+    frame[1] = (INTERFACE & 0x04) ? *p++ : 0xc0;
+    memcpy(&frame[2], p, 4);
+    p += 4;
+    frame[6] = (INTERFACE & 0x03) ? *p : 0;
+    return (INTERFACE & 0x03) == 0x01;
+}
+
+/******************************************************************************
+function:  Decode an RDATA1 frame
+parameter:
+    rx    : opcode slot, status, data[4], CRC
+    Value : ADC1 code
+    Check : verify the checksum byte
+Info:
+    Return ADS1263_SAMPLE_CRC_ERROR on checksum mismatch, else 0
+******************************************************************************/
+static UBYTE ADS1263_Decode_ADC1(const UBYTE* rx, UDOUBLE* Value, UBYTE Check)
+{
+    UDOUBLE read = 0;
+    UBYTE CRC = rx[6];
+    read |= ((UDOUBLE)rx[2] << 24);
+    read |= ((UDOUBLE)rx[3] << 16);
+    read |= ((UDOUBLE)rx[4] << 8);
+    read |= (UDOUBLE)rx[5];
+    *Value = read;
+    // printf("%x %x %x %x %x %x\r\n", rx[1], rx[2], rx[3], rx[4], rx[5], CRC);
+    if (Check && ADS1263_Checksum(read, CRC) != 0) {
+        printf("ADC1 Data read error! \r\n");
+        return ADS1263_SAMPLE_CRC_ERROR;
+    }
+    return 0;
+}
+
+/******************************************************************************
+function:  Read ADC data
+parameter:
+    Value  : ADC1 code
+    Status : status byte of the frame, may be NULL
+Info:
+    Return ADS1263_SAMPLE_* error flags, 0 for a good conversion
+******************************************************************************/
+static UBYTE ADS1263_Read_ADC1_Frame(ads1263_t* dev, UDOUBLE* Value, UBYTE* Status)
+{
+    UBYTE Prefix = dev->ReadMode == ADS1263_READ_DIRECT ? 0 : 1;
+    UBYTE Len = ADS1263_Frame_Len(dev, Prefix);
+    UBYTE tx[ADS1263_DATA_FRAME_LEN] = { (UBYTE)(Prefix ? CMD_RDATA1 : 0), 0, 0, 0, 0, 0, 0 };
+    UBYTE rx[ADS1263_DATA_FRAME_LEN], frame[ADS1263_DATA_FRAME_LEN];
+    UBYTE Error = 0, Check;
+    // DRDY may be read early by up to the wake-up guard, allow for that before giving up
+    UDOUBLE guard = ADS1263_DRDY_GUARD_NS + ADS1263_Conv_Latency(dev, 1) / 16;
+    uint64_t deadline = DEV_Time_ns() + ADS1263_STATUS_TIMEOUT_NS + guard;
+    // opcode, status, data[4], CRC in one frame; repeat until the status byte flags new data.
+    // A direct read cannot be repeated: the data only shifts out once per DRDY
+    while (1) {
+        ADS1263_Transaction(dev, tx, rx, Len);
+        Check = ADS1263_Frame_Normalize(dev, rx, Prefix, frame);
+        if (frame[1] & 0x40)
+            break;
+        if (Prefix == 0 || DEV_Time_ns() >= deadline) {
+            printf("ADC1 no new data ! \r\n");
+            Error |= ADS1263_SAMPLE_STALE;
+            break;
+        }
+        ADS1263_Count(dev->Stats.StatusRetries);
+        if (guard > ADS1263_DRDY_GUARD_NS * 2)
+            usleep(ADS1263_DRDY_GUARD_NS / 1000 / 4);
+    }
+
+    Error |= ADS1263_Decode_ADC1(frame, Value, Check);
+    if (Error & ADS1263_SAMPLE_CRC_ERROR)
+        ADS1263_Count(dev->Stats.ChecksumErrors);
+    if (Status != NULL)
+        *Status = frame[1];
+    return Error;
+}
+
+static UDOUBLE ADS1263_Read_ADC1_Data(ads1263_t* dev)
+{
+    UDOUBLE read;
+    ADS1263_Read_ADC1_Frame(dev, &read, NULL);
+    return read;
+}
+
+/******************************************************************************
+function:  Decode an RDATA2 frame
+parameter:
+    rx    : opcode slot, status, data[3], pad, CRC
+    Value : ADC2 code
+    Check : verify the checksum byte
+Info:
+    Return ADS1263_SAMPLE_STALE if the status byte does not flag new ADC2
+    data, ADS1263_SAMPLE_CRC_ERROR on checksum mismatch, else 0
+******************************************************************************/
+static UBYTE ADS1263_Decode_ADC2(const UBYTE* rx, UDOUBLE* Value, UBYTE Check)
+{
+    UDOUBLE read = 0;
+    UBYTE CRC = rx[6];
+
+    if ((rx[1] & 0x80) == 0) {
+        return ADS1263_SAMPLE_STALE;
+    }
+    read |= ((UDOUBLE)rx[2] << 16);
+    read |= ((UDOUBLE)rx[3] << 8);
+    read |= (UDOUBLE)rx[4];
+    *Value = read;
+    // printf("%x %x %x %x %x\r\n", rx[1], rx[2], rx[3], rx[4], CRC);
+    if (Check && ADS1263_Checksum(read, CRC) != 0) {
+        printf("ADC2 Data read error! \r\n");
+        return ADS1263_SAMPLE_CRC_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * Count a decoded ADC2 frame: no new data means the read is repeated later
+**/
+static inline void ADS1263_Count_ADC2(ads1263_t* dev, UBYTE Error)
+{
+    if (Error & ADS1263_SAMPLE_STALE)
+        ADS1263_Count(dev->Stats.StatusRetries);
+    else if (Error & ADS1263_SAMPLE_CRC_ERROR)
+        ADS1263_Count(dev->Stats.ChecksumErrors);
+}
+
+/******************************************************************************
+function:  Read ADC2 data once
+parameter:
+    Value  : ADC2 code, untouched if the data is not new
+    Status : status byte of the frame, may be NULL
+Info:
+    Single RDATA2, no polling.
+    Return ADS1263_SAMPLE_* flags, ADS1263_SAMPLE_STALE if ADC2 was not ready
+******************************************************************************/
+static UBYTE ADS1263_Read_ADC2_Frame(ads1263_t* dev, UDOUBLE* Value, UBYTE* Status)
+{
+    UBYTE tx[ADS1263_DATA_FRAME_LEN] = { CMD_RDATA2, 0, 0, 0, 0, 0, 0 };
+    UBYTE rx[ADS1263_DATA_FRAME_LEN], frame[ADS1263_DATA_FRAME_LEN];
+    UBYTE Error, Check;
+
+    ADS1263_Transaction(dev, tx, rx, ADS1263_Frame_Len(dev, 1));
+    Check = ADS1263_Frame_Normalize(dev, rx, 1, frame);
+    Error = ADS1263_Decode_ADC2(frame, Value, Check);
+    ADS1263_Count_ADC2(dev, Error);
+    if (Status != NULL)
+        *Status = frame[1];
+    if (!(Error & ADS1263_SAMPLE_STALE))
+        ADS1263_Conv2_Advance(dev, DEV_Time_ns());
+    return Error;
+}
+
+/******************************************************************************
+function:  Read ADC data
+parameter:
+Info:
+    Sleeps until the predicted end of the ADC2 conversion before polling.
+******************************************************************************/
+static UDOUBLE ADS1263_Read_ADC2_Data(ads1263_t* dev)
+{
+    UDOUBLE read = 0;
+
+    if (dev->Conv2.next_ns > DEV_Time_ns())
+        DEV_Delay_Until(dev->Conv2.next_ns);
+    while (ADS1263_Read_ADC2_Frame(dev, &read, NULL) & ADS1263_SAMPLE_STALE)
+        ;
+    return read;
+}
+
+/******************************************************************************
+function:  Read ADC specified channel data
+parameter:
+    Channel: Channel number
+Info:
+******************************************************************************/
+UDOUBLE ADS1263_Dev_GetChannalValue(ads1263_t* dev, UBYTE Channel)
+{
+    UDOUBLE Value = 0;
+    if (ADS1263_SelectChannal(dev, Channel) != 0) {
+        return 0;
+    }
+    // DEV_Delay_ms(2);
+    // ADS1263_WriteCmd(dev, CMD_START1);
+    // DEV_Delay_ms(2);
+    ADS1263_WaitDRDY(dev);
+    Value = ADS1263_Read_ADC1_Data(dev);
+    // printf("Get IN%d value success \r\n", Channel);
+    return Value;
+}
+
+/******************************************************************************
+function:  Read ADC specified channel data
+parameter:
+    Channel: Channel number
+Info:
+******************************************************************************/
+UDOUBLE ADS1263_Dev_GetChannalValue_ADC2(ads1263_t* dev, UBYTE Channel)
+{
+    UDOUBLE Value = 0;
+    if (dev->ScanMode == 0) {// 0  Single-ended input  10 channel1 Differential input  5 channe 
+        if (Channel > 10) {
+            return 0;
+        }
+        ADS1263_SetChannal_ADC2(dev, Channel);
+        // DEV_Delay_ms(2);
+        if (dev->Conv2.next_ns == 0)
+            ADS1263_WriteCmd(dev, CMD_START2);   // a mux change already restarts a running ADC2
+        // DEV_Delay_ms(2);
+        Value = ADS1263_Read_ADC2_Data(dev);
+    }
+    else {
+        if (Channel > 4) {
+            return 0;
+        }
+        ADS1263_SetDiffChannal_ADC2(dev, Channel);
+        // DEV_Delay_ms(2);
+        if (dev->Conv2.next_ns == 0)
+            ADS1263_WriteCmd(dev, CMD_START2);
+        // DEV_Delay_ms(2);
+        Value = ADS1263_Read_ADC2_Data(dev);
+    }
+    // printf("Get IN%d value success \r\n", Channel);
+    return Value;
+}
+
+/******************************************************************************
+function:  Read data from all channels
+parameter:
+    ADC_Value : ADC Value
+Info:
+******************************************************************************/
+void ADS1263_Dev_GetAll(ads1263_t* dev, UBYTE* List, UDOUBLE* Value, int Number)
+{
+    ADS1263_Dev_ScanADC1(dev, List, Value, NULL, Number);
+}
+
+/******************************************************************************
+function:  Read the current conversion and route the next channel in one frame
+parameter:
+    NextMux : INPMUX value for the following conversion
+    Value   : ADC1 code of the current conversion
+    Status  : status byte, may be NULL
+Info:
+    Call after DRDY. RDATA1 and WREG INPMUX share one transaction; the
+    mux write restarts ADC1, so the next conversion settles on the new
+    input for the MODE0 delay. If the status byte shows the data was not
+    new, the current channel is converted again before switching. When the
+    mux stays (one channel, a channel repeated) only the data frame is
+    sent, so ADC1 keeps converting without a restart.
+    Return ADS1263_SAMPLE_* error flags
+******************************************************************************/
+static UBYTE ADS1263_Scan_Step(ads1263_t* dev, UBYTE NextMux, UDOUBLE* Value, UBYTE* Status)
+{
+    UBYTE Prefix = dev->ReadMode == ADS1263_READ_DIRECT ? 0 : 1;
+    UBYTE Len = ADS1263_Frame_Len(dev, Prefix);
+    UBYTE tx[ADS1263_DATA_FRAME_LEN + ADS1263_REG_FRAME_LEN] = { (UBYTE)(Prefix ? CMD_RDATA1 : 0) };
+    UBYTE rx[ADS1263_DATA_FRAME_LEN + ADS1263_REG_FRAME_LEN], frame[ADS1263_DATA_FRAME_LEN];
+    std::lock_guard<std::recursive_mutex> lock(dev->RegLock);
+    UBYTE Current = dev->Shadow[REG_INPMUX];
+    UBYTE Error, Check;
+
+    if (ADS1263_Shadow_Holds(dev, REG_INPMUX, NextMux)) {
+        return ADS1263_Read_ADC1_Frame(dev, Value, Status);
+    }
+
+    // the WREG follows the data frame, whether that came from RDATA1 or direct
+    tx[Len] = (UBYTE)(CMD_WREG | (UBYTE)REG_INPMUX);
+    tx[Len + 1] = CMD_WREG2;
+    tx[Len + 2] = NextMux;
+    ADS1263_Shadow_Written(dev, REG_INPMUX, &NextMux, 1, ADS1263_Transaction(dev, tx, rx, Len + ADS1263_REG_FRAME_LEN));
+    ADS1263_Conv_RegsWritten(dev, REG_INPMUX, 1);
+    Check = ADS1263_Frame_Normalize(dev, rx, Prefix, frame);
+    if (frame[1] & 0x40) {
+        if (Status != NULL)
+            *Status = frame[1];
+        Error = ADS1263_Decode_ADC1(frame, Value, Check);
+        if (Error & ADS1263_SAMPLE_CRC_ERROR)
+            ADS1263_Count(dev->Stats.ChecksumErrors);
+        return Error;
+    }
+
+    // slow path: the conversion was not complete, redo it on the right input
+    ADS1263_Count(dev->Stats.StatusRetries);
+    ADS1263_WriteReg(dev, REG_INPMUX, Current);
+    Error = ADS1263_WaitDRDY(dev) ? ADS1263_SAMPLE_TIMEOUT : 0;
+    Error |= ADS1263_Read_ADC1_Frame(dev, Value, Status);
+    ADS1263_WriteReg(dev, REG_INPMUX, NextMux);
+    return Error;
+}
+
+/******************************************************************************
+function:  Scan a channel list on ADC1
+parameter:
+    List   : channels, per ADS1263_SetMode
+    Value  : ADC1 codes, one per channel
+    Flags  : ADS1263_SAMPLE_* per channel, may be NULL
+    Number : list length
+Info:
+    Each conversion is read in the same frame that selects the next channel,
+    so a scan costs Number conversions. The mux is left on List[0], so a
+    repeated scan starts without an extra restart.
+    Return 0 success, 1 invalid channel in List
+******************************************************************************/
+UBYTE ADS1263_Dev_ScanADC1(ads1263_t* dev, const UBYTE* List, UDOUBLE* Value, UBYTE* Flags, int Number)
+{
+    UBYTE Mux[ADS1263_STREAM_MAX_CHANNELS];
+    UBYTE Error;
+    int i;
+
+    if (Number <= 0) {
+        return 0;
+    }
+    if (Number > ADS1263_STREAM_MAX_CHANNELS) {
+        // longer lists are scanned in chunks
+        if (ADS1263_Dev_ScanADC1(dev, List, Value, Flags, ADS1263_STREAM_MAX_CHANNELS) != 0)
+            return 1;
+        return ADS1263_Dev_ScanADC1(dev, List + ADS1263_STREAM_MAX_CHANNELS, Value + ADS1263_STREAM_MAX_CHANNELS,
+            Flags != NULL ? Flags + ADS1263_STREAM_MAX_CHANNELS : NULL, Number - ADS1263_STREAM_MAX_CHANNELS);
+    }
+    for (i = 0; i < Number; i++) {
+        if (ADS1263_ChannalMux(dev, List[i], &Mux[i]) != 0) {
+            return 1;
+        }
+    }
+
+    ADS1263_SetReg(dev, REG_INPMUX, Mux[0]);
+    for (i = 0; i < Number; i++) {
+        Error = ADS1263_WaitDRDY(dev) ? ADS1263_SAMPLE_TIMEOUT : 0;
+        Error |= ADS1263_Scan_Step(dev, Mux[i + 1 < Number ? i + 1 : 0], &Value[i], NULL);
+        if (Flags != NULL)
+            Flags[i] = Error;
+    }
+    return 0;
+}
+
+/******************************************************************************
+function:  Set the ADC1 conversion start delay
+parameter:
+    delay : MODE0 delay, lets the input settle after each mux switch
+Info:
+    Other MODE0 bits are kept.
+******************************************************************************/
+void ADS1263_Dev_SetScanDelay(ads1263_t* dev, ADS1263_DELAY delay)
+{
+    ADS1263_SetReg(dev, REG_MODE0, (dev->Shadow[REG_MODE0] & 0xf0) | (delay & 0x0f));
+}
+
+/******************************************************************************
+function:  Read data from all channels
+parameter:
+    ADC_Value : ADC Value
+Info:
+******************************************************************************/
+void ADS1263_Dev_GetAll_ADC2(ads1263_t* dev, UDOUBLE* ADC_Value)
+{
+    UBYTE i;
+    // ADC2 keeps running across the mux changes, one STOP2 at the end
+    for (i = 0; i < 10; i++) {
+        ADC_Value[i] = ADS1263_Dev_GetChannalValue_ADC2(dev, i);
+        // DEV_Delay_ms(20);
+    }
+    ADS1263_WriteCmd(dev, CMD_STOP2);
+    // printf("----------Read ADC2 value success----------\r\n");
+}
+
+/******************************************************************************
+function:  RTD Test function
+parameter:
+    delay : Conversion delay
+    gain :  Conversion gain
+    drate : speed
+Info:
+******************************************************************************/
+UDOUBLE ADS1263_Dev_RTD(ads1263_t* dev, ADS1263_DELAY delay, ADS1263_GAIN gain, ADS1263_DRATE drate)
+{
+    UDOUBLE Value;
+    UBYTE Regs[ADS1263_REG_COUNT];
+    ADS1263_Dev_GetRegisters(dev, Regs);
+
+    //MODE0 (CHOP OFF)
+    UBYTE MODE0 = delay;
+    Regs[REG_MODE0] = MODE0;
+
+    //(IDACMUX) IDAC2 AINCOM,IDAC1 AIN3
+    UBYTE IDACMUX = (0x0a << 4) | 0x03;
+    Regs[REG_IDACMUX] = IDACMUX;
+
+    //((IDACMAG)) IDAC2 = IDAC1 = 250uA
+    UBYTE IDACMAG = (0x03 << 4) | 0x03;
+    Regs[REG_IDACMAG] = IDACMAG;
+
+    UBYTE MODE2 = (gain << 4) | drate;
+    Regs[REG_MODE2] = MODE2;
+
+    //INPMUX (AINP = AIN7, AINN = AIN6)
+    UBYTE INPMUX = (0x07 << 4) | 0x06;
+    Regs[REG_INPMUX] = INPMUX;
+
+    // REFMUX AIN4 AIN5
+    UBYTE REFMUX = (0x03 << 3) | 0x03;
+    Regs[REG_REFMUX] = REFMUX;
+
+    ADS1263_Dev_CommitRegisters(dev, Regs);
+
+    //Read one conversion
+    ADS1263_WriteCmd(dev, CMD_START1);
+    ADS1263_WaitDRDY(dev);
+    Value = ADS1263_Read_ADC1_Data(dev);
+    ADS1263_WriteCmd(dev, CMD_STOP1);
+
+    return Value;
+}
+
+/******************************************************************************
+function:  DAC Test function
+parameter:
+    volt :          output volt value
+    isPositive :    postive or negative
+    isOpen :        open or close
+Info:
+******************************************************************************/
+void ADS1263_Dev_DAC(ads1263_t* dev, ADS1263_DAC_VOLT volt, UBYTE isPositive, UBYTE isOpen)
+{
+    UBYTE Reg, Value;
+
+    if (isPositive)
+        Reg = REG_TDACP;        // IN6
+    else
+        Reg = REG_TDACN;        // IN7
+
+    if (isOpen)
+        Value = volt | 0x80;
+    else
         Value = 0x00;
 
-    ADS1263_WriteReg(Reg, Value);
+    ADS1263_SetReg(dev, Reg, Value);
+}
+
+#pragma endregion
+
+#pragma region Stream
+
+static void ADS1263_Block_Put(ads1263_t* dev, const ADS1263_SAMPLE* sample, UBYTE Adc);
+static void ADS1263_Block_Flush(ads1263_t* dev, UBYTE Force);
+static void ADS1263_Shm_Put(ads1263_t* dev, const ADS1263_SAMPLE* sample, UBYTE Adc);
+static void ADS1263_Rec_Put(ads1263_t* dev, const ADS1263_SAMPLE* sample, UBYTE Adc);
+static void ADS1263_Rec_Flush(ads1263_t* dev, UBYTE Force);
+
+/**
+ * Return 1 if the ring was full and the sample dropped
+**/
+static inline UBYTE ADS1263_Ring_Push(ADS1263_RING* ring, const ADS1263_SAMPLE* sample)
+{
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail > ring->mask) {
+        // full: the reader is behind, count the loss instead of overwriting its slots
+        ring->overflows.fetch_add(1, std::memory_order_relaxed);
+        return 1;
+    }
+    ring->buf[head & ring->mask] = *sample;
+    ring->head.store(head + 1, std::memory_order_release);
+    return 0;
+}
+
+/**
+ * (Re)allocate a ring of at least Capacity samples, rounded up to a power of two.
+ * Only while no thread pushes to it. Return 0 success, 1 failed
+**/
+static UBYTE ADS1263_Ring_Alloc(ADS1263_RING* ring, UDOUBLE Capacity)
+{
+    UDOUBLE capacity = 1;
+    void* buf = NULL;
+
+    while (capacity < Capacity || capacity < 2)
+        capacity <<= 1;
+    if (posix_memalign(&buf, ADS1263_CACHE_LINE, capacity * sizeof(ADS1263_SAMPLE)) != 0) {
+        printf("Stream ring allocation failed \r\n");
+        return 1;
+    }
+    free(ring->buf);
+    ring->buf = (ADS1263_SAMPLE*)buf;
+    ring->mask = capacity - 1;
+    ring->head.store(0);
+    ring->tail.store(0);
+    ring->overflows.store(0);
+    return 0;
+}
+
+/**
+ * Copy out up to n samples, single consumer. Return number copied
+**/
+static int ADS1263_Ring_Read(ADS1263_RING* ring, ADS1263_SAMPLE* buf, int n)
+{
+    uint64_t tail, head, count, first;
+
+    if (ring->buf == NULL || n <= 0) {
+        return 0;
+    }
+    tail = ring->tail.load(std::memory_order_relaxed);
+    head = ring->head.load(std::memory_order_acquire);
+    count = head - tail;
+    if (count > (uint64_t)n)
+        count = n;
+    if (count == 0)
+        return 0;
+
+    // at most two contiguous runs: up to the end of the ring, then from its start
+    first = ring->mask + 1 - (tail & ring->mask);
+    if (first > count)
+        first = count;
+    memcpy(buf, &ring->buf[tail & ring->mask], first * sizeof(ADS1263_SAMPLE));
+    memcpy(buf + first, &ring->buf[0], (count - first) * sizeof(ADS1263_SAMPLE));
+    ring->tail.store(tail + count, std::memory_order_release);
+    return (int)count;
+}
+
+/**
+ * Hand one conversion to its consumers: the shared-memory ring if published,
+ * the recorder if recording, then the attached blocks or else the stream
+ * ring of its ADC
+**/
+static inline void ADS1263_Stream_Deliver(ads1263_t* dev, const ADS1263_SAMPLE* sample, UBYTE Adc)
+{
+    if (dev->Shm.header != NULL)
+        ADS1263_Shm_Put(dev, sample, Adc);
+    if (dev->Rec.active)
+        ADS1263_Rec_Put(dev, sample, Adc);
+    if (dev->Blocks.attached)
+        ADS1263_Block_Put(dev, sample, Adc);
+    else if (ADS1263_Ring_Push(Adc == 2 ? &dev->Ring2 : &dev->Ring, sample))
+        ADS1263_Count(dev->Stats.Overflows);
+}
+
+/******************************************************************************
+function:  Read the current ADC2 conversion and route the next channel in one frame
+parameter:
+    NextMux : ADC2MUX value for the following conversion
+    Value   : ADC2 code of the current conversion
+    Status  : status byte, may be NULL
+Info:
+    The ADC2 counterpart of ADS1263_Scan_Step. If the data was not new the
+    current channel is put back and ADS1263_SAMPLE_STALE returned; the
+    caller tries again once the restarted conversion has settled.
+    Return ADS1263_SAMPLE_* error flags
+******************************************************************************/
+static UBYTE ADS1263_Scan_Step_ADC2(ads1263_t* dev, UBYTE NextMux, UDOUBLE* Value, UBYTE* Status)
+{
+    UBYTE Len = ADS1263_Frame_Len(dev, 1);
+    UBYTE tx[ADS1263_DATA_FRAME_LEN + ADS1263_REG_FRAME_LEN] = { CMD_RDATA2 };
+    UBYTE rx[ADS1263_DATA_FRAME_LEN + ADS1263_REG_FRAME_LEN], frame[ADS1263_DATA_FRAME_LEN];
+    std::lock_guard<std::recursive_mutex> lock(dev->RegLock);
+    UBYTE Current = dev->Shadow[REG_ADC2MUX];
+    UBYTE Error, Check;
+
+    tx[Len] = (UBYTE)(CMD_WREG | (UBYTE)REG_ADC2MUX);
+    tx[Len + 1] = CMD_WREG2;
+    tx[Len + 2] = NextMux;
+    ADS1263_Shadow_Written(dev, REG_ADC2MUX, &NextMux, 1, ADS1263_Transaction(dev, tx, rx, Len + ADS1263_REG_FRAME_LEN));
+    ADS1263_Conv_RegsWritten(dev, REG_ADC2MUX, 1);
+    Check = ADS1263_Frame_Normalize(dev, rx, 1, frame);
+    Error = ADS1263_Decode_ADC2(frame, Value, Check);
+    ADS1263_Count_ADC2(dev, Error);
+    if (Status != NULL)
+        *Status = frame[1];
+    if (Error & ADS1263_SAMPLE_STALE)
+        ADS1263_SetReg(dev, REG_ADC2MUX, Current);
+    return Error;
+}
+
+/**
+ * Serve ADC2 in the gap before the next ADC1 DRDY: each read starts only if
+ * ADC2 is due and the read still fits ahead of ADC1, so ADC1 is never delayed
+**/
+static void ADS1263_Stream_Slot_ADC2(ads1263_t* dev)
+{
+    const ADS1263_STREAM_CONFIG* config = &dev->Stream2.config;
+    ADS1263_SAMPLE sample;
+    uint64_t now, start;
+    int next;
+
+    memset(&sample, 0, sizeof(sample));
+    while (dev->Stream.running.load(std::memory_order_relaxed)) {
+        if (dev->Conv.next_ns == 0 || dev->Conv2.next_ns == 0)
+            return;
+        now = DEV_Time_ns();
+        start = now > dev->Conv2.next_ns ? now : dev->Conv2.next_ns;
+        if (start + ADS1263_ADC2_SLOT_NS > dev->Conv.next_ns)
+            return;
+        if (start > now)
+            DEV_Delay_Until(start);
+
+        next = dev->Stream2.index + 1 < config->Number ? dev->Stream2.index + 1 : 0;
+        sample.Timestamp = DEV_Time_ns();
+        if (config->Number > 1)
+            sample.Flags = ADS1263_Scan_Step_ADC2(dev, dev->Stream2.Mux[next], &sample.Value, &sample.Status);
+        else
+            sample.Flags = ADS1263_Read_ADC2_Frame(dev, &sample.Value, &sample.Status);
+        if (sample.Flags & ADS1263_SAMPLE_STALE) {
+            // early: poll again no sooner than one ADC2 period
+            if (config->Number == 1)
+                ADS1263_Conv2_Advance(dev, sample.Timestamp);
+            continue;
+        }
+        sample.Sequence = dev->Stream2.sequence++;
+        sample.Channel = config->Channels[dev->Stream2.index];
+        ADS1263_Stream_Deliver(dev, &sample, 2);
+        dev->Stream2.index = next;
+    }
+}
+
+/**
+ * Single channel: ADC1 converts continuously, so DRDY edges more than one
+ * period apart mean conversions were overwritten before they were read.
+ * They are counted and skipped in the sequence.
+**/
+static void ADS1263_Stream_Gap(ads1263_t* dev, uint64_t Time)
+{
+    uint64_t period = ADS1263_Conv_Latency(dev, 0), missed;
+
+    if (dev->Stream.last_ns != 0 && period != 0 && Time > dev->Stream.last_ns) {
+        missed = (Time - dev->Stream.last_ns + period / 2) / period;
+        if (missed > 1) {
+            dev->Stream.sequence += missed - 1;
+            dev->Stream.missed.fetch_add(missed - 1, std::memory_order_relaxed);
+            ADS1263_Count(dev->Stats.Missed, missed - 1);
+        }
+    }
+    dev->Stream.last_ns = Time;
+}
+
+/**
+ * Acquisition thread: one ADC1 conversion per DRDY, channels taken in list order
+**/
+static void ADS1263_Stream_Loop(ads1263_t* dev)
+{
+    const ADS1263_STREAM_CONFIG* config = &dev->Stream.config;
+    const UBYTE* Mux = dev->Stream.Mux;
+    ADS1263_SAMPLE sample;
+    int i = 0;
+
+    memset(&sample, 0, sizeof(sample));
+    // single channel: leave the mux alone and take every conversion;
+    // several: read each conversion in the frame that switches to the next input
+    ADS1263_WriteReg(dev, REG_INPMUX, Mux[0]);
+    while (dev->Stream.running.load(std::memory_order_relaxed)) {
+        UBYTE Channel = config->Channels[i];
+        sample.Flags = ADS1263_WaitDRDY(dev) ? ADS1263_SAMPLE_TIMEOUT : 0;
+        if (config->Number > 1)
+            sample.Flags |= ADS1263_Scan_Step(dev, Mux[i + 1 < config->Number ? i + 1 : 0], &sample.Value, &sample.Status);
+        else
+            sample.Flags |= ADS1263_Read_ADC1_Frame(dev, &sample.Value, &sample.Status);
+        sample.Timestamp = dev->DRDY_Time;
+        if (config->Number == 1)
+            ADS1263_Stream_Gap(dev, sample.Flags & ADS1263_SAMPLE_TIMEOUT ? 0 : sample.Timestamp);
+        sample.Sequence = dev->Stream.sequence++;
+        sample.Channel = Channel;
+        ADS1263_Stream_Deliver(dev, &sample, 1);
+        if (++i >= config->Number)
+            i = 0;
+        if (dev->Stream2.active)
+            ADS1263_Stream_Slot_ADC2(dev);
+        if (dev->Blocks.attached)
+            ADS1263_Block_Flush(dev, 0);
+        if (dev->Rec.active)
+            ADS1263_Rec_Flush(dev, 0);
+    }
+    if (dev->Blocks.attached)
+        ADS1263_Block_Flush(dev, 1);
+    if (dev->Rec.active)
+        ADS1263_Rec_Flush(dev, 1);
+}
+
+/******************************************************************************
+function:  Start continuous ADC1 acquisition on a background thread
+parameter:
+    config : channel list, ring capacity and thread priority
+Info:
+    ADC1 must be initialized. While the stream runs the acquisition thread
+    owns the device: read with ADS1263_ReadSamples, stop before calling
+    any other ADS1263 function.
+    Return 0 success, 1 failed
+******************************************************************************/
+UBYTE ADS1263_Dev_StartStream(ads1263_t* dev, const ADS1263_STREAM_CONFIG* config)
+{
+    return ADS1263_Dev_StartDualStream(dev, config, NULL);
+}
+
+/******************************************************************************
+function:  Start ADC1 streaming with an ADC2 background scan
+parameter:
+    adc1 : ADC1 channel list, ring capacity and thread priority
+    adc2 : ADC2 channel list and ring capacity, NULL for ADC1 only
+Info:
+    Both ADCs must be initialized, see ADS1263_init_Dual. ADC1 is read on
+    every DRDY as with ADS1263_StartStream. ADC2 conversions are read in
+    the gaps between ADC1 DRDY edges, only when a read fits before the
+    next one; if ADC1 runs too fast to leave ADS1263_ADC2_SLOT_NS, ADC2
+    is not served. Read ADC2 samples with ADS1263_ReadSamples_ADC2.
+    Return 0 success, 1 failed
+******************************************************************************/
+UBYTE ADS1263_Dev_StartDualStream(ads1263_t* dev, const ADS1263_STREAM_CONFIG* adc1, const ADS1263_STREAM_CONFIG* adc2)
+{
+    const ADS1263_STREAM_CONFIG* config = adc1;
+    int i;
+
+    if (dev->Stream.running.load() || config == NULL) {
+        return 1;
+    }
+    if (config->Number < 1 || config->Number > ADS1263_STREAM_MAX_CHANNELS) {
+        printf("Stream channel count %d invalid \r\n", config->Number);
+        return 1;
+    }
+    for (i = 0; i < config->Number; i++) {
+        if (ADS1263_ChannalMux(dev, config->Channels[i], &dev->Stream.Mux[i]) != 0) {
+            printf("Stream channel %d invalid \r\n", config->Channels[i]);
+            return 1;
+        }
+    }
+    dev->Stream2.active = 0;
+    if (adc2 != NULL) {
+        if (adc2->Number < 1 || adc2->Number > ADS1263_STREAM_MAX_CHANNELS) {
+            printf("ADC2 stream channel count %d invalid \r\n", adc2->Number);
+            return 1;
+        }
+        for (i = 0; i < adc2->Number; i++) {
+            if (ADS1263_ChannalMux(dev, adc2->Channels[i], &dev->Stream2.Mux[i]) != 0) {
+                printf("ADC2 stream channel %d invalid \r\n", adc2->Channels[i]);
+                return 1;
+            }
+        }
+        if (ADS1263_Ring_Alloc(&dev->Ring2, adc2->Capacity) != 0) {
+            return 1;
+        }
+        dev->Stream2.config = *adc2;
+        dev->Stream2.index = 0;
+        dev->Stream2.sequence = 0;
+        dev->Stream2.active = 1;
+        ADS1263_SetReg(dev, REG_ADC2MUX, dev->Stream2.Mux[0]);
+        if (dev->Conv2.next_ns == 0)
+            ADS1263_WriteCmd(dev, CMD_START2);
+    }
+
+    if (ADS1263_Ring_Alloc(&dev->Ring, config->Capacity) != 0) {
+        dev->Stream2.active = 0;
+        return 1;
+    }
+    dev->Stream.config = *config;
+    dev->Stream.sequence = 0;
+    dev->Stream.last_ns = 0;
+    dev->Stream.missed.store(0);
+
+    dev->Stream.running.store(true);
+    dev->Stream.thread = std::thread(ADS1263_Stream_Loop, dev);
+    if (config->Priority > 0) {
+        struct sched_param param;
+        param.sched_priority = config->Priority;
+        if (pthread_setschedparam(dev->Stream.thread.native_handle(), SCHED_FIFO, &param) != 0)
+            printf("Stream SCHED_FIFO %d not permitted \r\n", config->Priority);
+    }
+    return 0;
+}
+
+void ADS1263_Dev_StopStream(ads1263_t* dev)
+{
+    if (!dev->Stream.running.exchange(false)) {
+        return;
+    }
+    if (dev->Stream.thread.joinable())
+        dev->Stream.thread.join();
+    if (dev->Stream2.active) {
+        ADS1263_WriteCmd(dev, CMD_STOP2);
+        dev->Stream2.active = 0;
+    }
+}
+
+/******************************************************************************
+function:  Drain samples from the stream ring
+parameter:
+    buf : destination
+    n   : capacity of buf in samples
+Info:
+    Single consumer; never blocks.
+    Return number of samples copied
+******************************************************************************/
+int ADS1263_Dev_ReadSamples(ads1263_t* dev, ADS1263_SAMPLE* buf, int n)
+{
+    return ADS1263_Ring_Read(&dev->Ring, buf, n);
+}
+
+/**
+ * Conversions dropped because the ring was full
+**/
+uint64_t ADS1263_Dev_GetStreamOverflows(ads1263_t* dev)
+{
+    return dev->Ring.overflows.load(std::memory_order_relaxed);
+}
+
+/**
+ * Single-channel conversions that completed but were not read in time;
+ * the sequence numbers skip them
+**/
+uint64_t ADS1263_Dev_GetStreamMissed(ads1263_t* dev)
+{
+    return dev->Stream.missed.load(std::memory_order_relaxed);
+}
+
+/**
+ * ADC2 samples of a dual stream, as ADS1263_ReadSamples
+**/
+int ADS1263_Dev_ReadSamples_ADC2(ads1263_t* dev, ADS1263_SAMPLE* buf, int n)
+{
+    return ADS1263_Ring_Read(&dev->Ring2, buf, n);
+}
+
+uint64_t ADS1263_Dev_GetStreamOverflows_ADC2(ads1263_t* dev)
+{
+    return dev->Ring2.overflows.load(std::memory_order_relaxed);
+}
+
+#pragma endregion
+
+#pragma region Profile
+
+static uint32_t ADS1263_CRC32(uint32_t crc, const void* data, size_t len);
+
+/**
+ * One candidate setting and its scan cost
+**/
+typedef struct
+{
+    UBYTE Drate;
+    UBYTE Filter;
+    UDOUBLE Us;
+}ADS1263_TUNE_CANDIDATE;
+
+/**
+ * MODE1, MODE2, INPMUX for a channel of a profile; the other bits of
+ * MODE1/MODE2 (sensor bias, PGA) are kept from the shadow
+**/
+static void ADS1263_Profile_Regs(ads1263_t* dev, UBYTE Drate, UBYTE Filter, UBYTE Mux, UBYTE* Regs)
+{
+    Regs[0] = (dev->Shadow[REG_MODE1] & 0x1f) | (UBYTE)(Filter << 5);
+    Regs[1] = (dev->Shadow[REG_MODE2] & 0xf0) | (Drate & 0x0f);
+    Regs[2] = Mux;
+}
+
+/**
+ * Write MODE1..INPMUX from the first byte that differs from the shadow,
+ * start ADC1 if it is stopped
+**/
+static void ADS1263_Profile_Select(ads1263_t* dev, const UBYTE* Regs)
+{
+    std::lock_guard<std::recursive_mutex> lock(dev->RegLock);
+    UBYTE i = 0;
+
+    while (i < 3 && ADS1263_Shadow_Holds(dev, REG_MODE1 + i, Regs[i]))
+        i++;
+    if (i < 3)
+        ADS1263_Dev_WriteRegisters(dev, REG_MODE1 + i, &Regs[i], 3 - i);
+    if (dev->Conv.next_ns == 0)
+        ADS1263_WriteCmd(dev, CMD_START1);
+}
+
+/**
+ * Read Samples conversions of the selected setting, standard deviation in codes
+ * Return 0 success, 1 every read failed
+**/
+static UBYTE ADS1263_Tune_Measure(ads1263_t* dev, int Samples, double* Rms)
+{
+    double mean = 0, m2 = 0;
+    UDOUBLE Value;
+    int i, n = 0;
+
+    for (i = 0; i < Samples; i++) {
+        if (ADS1263_WaitDRDY(dev) || ADS1263_Read_ADC1_Frame(dev, &Value, NULL) != 0)
+            continue;
+        // Welford: the codes sit far from zero, a plain sum of squares loses the noise
+        double d = (double)(int32_t)Value - mean;
+        n++;
+        mean += d / n;
+        m2 += d * ((double)(int32_t)Value - mean);
+    }
+    if (n < 2) {
+        return 1;
+    }
+    *Rms = sqrt(m2 / (n - 1));
+    return 0;
+}
+
+/******************************************************************************
+function:  Pick a data rate and filter per channel against a noise target
+parameter:
+    config  : channels, candidates, target and measurement length
+    profile : the result
+Info:
+    ADC1 must be initialized; the gain, reference and MODE0 delay in use
+    are the ones tuned for. Candidates are tried fastest first and each
+    channel stops at the first one meeting the target, so the slow settings
+    are only measured for channels that need them. Measure on the inputs as
+    they are wired, without signal: drift counts as noise. The previous
+    MODE1, MODE2 and INPMUX are restored afterwards.
+    Return 0 success, 1 failed
+******************************************************************************/
+UBYTE ADS1263_Dev_TuneProfile(ads1263_t* dev, const ADS1263_TUNE_CONFIG* config, ADS1263_PROFILE* profile)
+{
+    ADS1263_TUNE_CANDIDATE Cand[16 * (ADS1263_FIR + 1)], c;
+    UBYTE Mux[ADS1263_STREAM_MAX_CHANNELS];
+    UBYTE Saved[3], Regs[3];
+    UBYTE delay = dev->Shadow[REG_MODE0] & 0x0f, chop = (dev->Shadow[REG_MODE0] >> 4) & 0x01;
+    int DrateCount = config != NULL && config->Drates != NULL ? config->DrateCount : 16;
+    int FilterCount = config != NULL && config->Filters != NULL ? config->FilterCount : ADS1263_FIR + 1;
+    int Count = 0, i, j, k, best;
+    double target, rms, quietest;
+
+    if (dev->Stream.running.load() || dev->Schedule.running.load() || config == NULL || profile == NULL) {
+        return 1;
+    }
+    if (config->Number < 1 || config->Number > ADS1263_STREAM_MAX_CHANNELS) {
+        printf("Tune channel count %d invalid \r\n", config->Number);
+        return 1;
+    }
+    if (config->Samples < 2 || DrateCount < 1 || DrateCount > 16 || FilterCount < 1 || FilterCount > ADS1263_FIR + 1) {
+        printf("Tune samples or candidates invalid \r\n");
+        return 1;
+    }
+    target = config->NoiseRms > 0 ? config->NoiseRms : pow(2.0, 32.0 - config->Enob);
+    if (!(config->NoiseRms > 0) && !(config->Enob > 0 && config->Enob <= 32)) {
+        printf("Tune noise target missing \r\n");
+        return 1;
+    }
+    for (i = 0; i < config->Number; i++) {
+        if (ADS1263_ChannalMux(dev, config->Channels[i], &Mux[i]) != 0) {
+            printf("Tune channel %d invalid \r\n", config->Channels[i]);
+            return 1;
+        }
+    }
+
+    // candidates in order of scan cost, insertion sort keeps equal costs in the given order
+    for (i = 0; i < DrateCount; i++) {
+        for (j = 0; j < FilterCount; j++) {
+            c.Drate = config->Drates != NULL ? config->Drates[i] & 0x0f : i;
+            c.Filter = config->Filters != NULL ? config->Filters[j] : j;
+            if (c.Filter > ADS1263_FIR || (c.Filter == ADS1263_FIR && c.Drate > ADS1263_20SPS))
+                continue;
+            c.Us = ADS1263_ConversionTime((ADS1263_DRATE)c.Drate, (ADS1263_FILTER)c.Filter, (ADS1263_DELAY)delay, 1) << chop;
+            for (k = Count; k > 0 && Cand[k - 1].Us > c.Us; k--)
+                Cand[k] = Cand[k - 1];
+            Cand[k] = c;
+            Count++;
+        }
+    }
+    if (Count == 0) {
+        printf("Tune has no usable candidate \r\n");
+        return 1;
+    }
+
+    memset(profile, 0, sizeof(ADS1263_PROFILE));
+    profile->Magic = ADS1263_PROFILE_MAGIC;
+    profile->Version = ADS1263_PROFILE_VERSION;
+    profile->Number = config->Number;
+    profile->Mode = dev->ScanMode;
+    profile->Delay = delay;
+
+    memcpy(Saved, &dev->Shadow[REG_MODE1], 3);
+    for (i = 0; i < config->Number; i++) {
+        ADS1263_PROFILE_CHANNEL* ch = &profile->Channels[i];
+        best = -1;
+        quietest = 0;
+        ch->Channel = config->Channels[i];
+        for (k = 0; k < Count; k++) {
+            ADS1263_Profile_Regs(dev, Cand[k].Drate, Cand[k].Filter, Mux[i], Regs);
+            ADS1263_Profile_Select(dev, Regs);
+            if (ADS1263_Tune_Measure(dev, config->Samples, &rms) != 0)
+                continue;
+            if (rms <= target) {
+                best = k;
+                quietest = rms;
+                ch->Met = 1;
+                break;
+            }
+            if (best < 0 || rms < quietest) {
+                best = k;
+                quietest = rms;
+            }
+        }
+        if (best < 0) {
+            printf("Tune channel %d read failed \r\n", ch->Channel);
+            ADS1263_Dev_WriteRegisters(dev, REG_MODE1, Saved, 3);
+            return 1;
+        }
+        ch->Drate = Cand[best].Drate;
+        ch->Filter = Cand[best].Filter;
+        ch->ConvUs = Cand[best].Us;
+        ch->NoiseRms = quietest;
+        ch->Enob = quietest > 0 ? 32.0 - log2(quietest) : 32.0;
+    }
+    ADS1263_Dev_WriteRegisters(dev, REG_MODE1, Saved, 3);
+    return 0;
+}
+
+/**
+ * Profile fields a scan relies on
+**/
+static UBYTE ADS1263_Profile_Valid(const ADS1263_PROFILE* profile)
+{
+    int i;
+
+    if (profile == NULL || profile->Magic != ADS1263_PROFILE_MAGIC || profile->Version != ADS1263_PROFILE_VERSION
+        || profile->Number < 1 || profile->Number > ADS1263_STREAM_MAX_CHANNELS) {
+        return 0;
+    }
+    for (i = 0; i < profile->Number; i++) {
+        if (profile->Channels[i].Drate > ADS1263_38400SPS || profile->Channels[i].Filter > ADS1263_FIR)
+            return 0;
+    }
+    return 1;
+}
+
+/******************************************************************************
+function:  Scan the channels of a profile, each at its own rate and filter
+parameter:
+    profile : from ADS1263_TuneProfile or ADS1263_LoadProfile
+    Value   : ADC1 codes, one per channel
+    Flags   : ADS1263_SAMPLE_* per channel, may be NULL
+Info:
+    One register write per channel: MODE1, MODE2 and INPMUX share a WREG,
+    starting at the first that changes. Each channel costs its own first
+    conversion. The scan mode must be the one the profile was tuned in.
+    Return 0 success, 1 invalid profile
+******************************************************************************/
+UBYTE ADS1263_Dev_ScanProfile(ads1263_t* dev, const ADS1263_PROFILE* profile, UDOUBLE* Value, UBYTE* Flags)
+{
+    UBYTE Mux, Regs[3], Error;
+    int i;
+
+    if (!ADS1263_Profile_Valid(profile) || profile->Mode != dev->ScanMode) {
+        printf("Profile invalid for this scan mode \r\n");
+        return 1;
+    }
+    for (i = 0; i < profile->Number; i++) {
+        const ADS1263_PROFILE_CHANNEL* ch = &profile->Channels[i];
+        if (ADS1263_ChannalMux(dev, ch->Channel, &Mux) != 0) {
+            return 1;
+        }
+        ADS1263_Profile_Regs(dev, ch->Drate, ch->Filter, Mux, Regs);
+        ADS1263_Profile_Select(dev, Regs);
+        Error = ADS1263_WaitDRDY(dev) ? ADS1263_SAMPLE_TIMEOUT : 0;
+        Error |= ADS1263_Read_ADC1_Frame(dev, &Value[i], NULL);
+        if (Flags != NULL)
+            Flags[i] = Error;
+    }
+    return 0;
+}
+
+/******************************************************************************
+function:  Keep a profile in a file
+parameter:
+    profile : tuned profile
+    Path    : file, replaced
+Info:
+    The file holds the structure as is, for the same build and architecture.
+    Return 0 success, 1 failed
+******************************************************************************/
+UBYTE ADS1263_SaveProfile(const ADS1263_PROFILE* profile, const char* Path)
+{
+    ADS1263_PROFILE copy;
+    FILE* f;
+
+    if (!ADS1263_Profile_Valid(profile)) {
+        printf("Profile invalid \r\n");
+        return 1;
+    }
+    copy = *profile;
+    copy.CRC = ADS1263_CRC32(0, &copy, offsetof(ADS1263_PROFILE, CRC));
+    f = fopen(Path, "wb");
+    if (f == NULL) {
+        printf("Open %s failed \r\n", Path);
+        return 1;
+    }
+    if (fwrite(&copy, sizeof(copy), 1, f) != 1) {
+        printf("Write %s failed \r\n", Path);
+        fclose(f);
+        return 1;
+    }
+    return fclose(f) != 0 ? 1 : 0;
+}
+
+/******************************************************************************
+function:  Read a profile written by ADS1263_SaveProfile
+parameter:
+    profile : the result
+    Path    : file
+Info:
+    Return 0 success, 1 missing, truncated or corrupt
+******************************************************************************/
+UBYTE ADS1263_LoadProfile(ADS1263_PROFILE* profile, const char* Path)
+{
+    ADS1263_PROFILE copy;
+    FILE* f = fopen(Path, "rb");
+
+    if (f == NULL) {
+        printf("Open %s failed \r\n", Path);
+        return 1;
+    }
+    if (fread(&copy, sizeof(copy), 1, f) != 1) {
+        printf("Read %s failed \r\n", Path);
+        fclose(f);
+        return 1;
+    }
+    fclose(f);
+    if (copy.CRC != ADS1263_CRC32(0, &copy, offsetof(ADS1263_PROFILE, CRC)) || !ADS1263_Profile_Valid(&copy)) {
+        printf("Profile %s corrupt \r\n", Path);
+        return 1;
+    }
+    *profile = copy;
+    return 0;
+}
+
+#pragma endregion
+
+#pragma region Schedule
+
+/******************************************************************************
+function:  Start a fixed-rate clock
+parameter:
+    clock    : clock state
+    PeriodNs : period
+Info:
+    The first deadline is one period from now.
+******************************************************************************/
+void ADS1263_Periodic_Init(ADS1263_PERIODIC* clock, uint64_t PeriodNs)
+{
+    clock->Period = PeriodNs;
+    clock->Current = DEV_Time_ns();
+    clock->Deadline = clock->Current + PeriodNs;
+}
+
+/******************************************************************************
+function:  Sleep until the next deadline of a fixed-rate clock
+parameter:
+    clock : clock state
+    stats : lateness statistics to update, may be NULL
+Info:
+    Deadlines are absolute: time spent between calls does not shift the
+    cadence. If whole periods have already passed, they are counted as missed
+    and skipped so the clock stays on its original phase.
+    clock->Current is the deadline just serviced.
+    Return lateness of the wake-up in ns
+******************************************************************************/
+uint64_t ADS1263_Periodic_Wait(ADS1263_PERIODIC* clock, ADS1263_SCHEDULE_STATS* stats)
+{
+    uint64_t now, late, missed = 0;
+    int bin = 0;
+
+    DEV_Delay_Until(clock->Deadline);
+    now = DEV_Time_ns();
+    late = now > clock->Deadline ? now - clock->Deadline : 0;
+    if (late >= clock->Period)
+        missed = late / clock->Period;
+
+    clock->Current = clock->Deadline;
+    clock->Deadline += (missed + 1) * clock->Period;
+
+    if (stats != NULL) {
+        stats->Periods++;
+        stats->Missed += missed;
+        stats->LateSum += late;
+        if (late > stats->LateMax)
+            stats->LateMax = late;
+        // bin 0: under 1 us, bin k: [2^(k-1), 2^k) us, last bin open-ended
+        if (late >= 1000)
+            bin = 64 - __builtin_clzll(late / 1000);
+        if (bin >= ADS1263_JITTER_BINS)
+            bin = ADS1263_JITTER_BINS - 1;
+        stats->Histogram[bin]++;
+    }
+    return late;
+}
+
+/**
+ * Scheduler thread: one ADS1263_ScanADC1 of the channel list, or one
+ * ADS1263_ScanProfile, per period
+**/
+static void ADS1263_Schedule_Loop(ads1263_t* dev)
+{
+    const ADS1263_SCHEDULE_CONFIG* config = &dev->Schedule.config;
+    ADS1263_SCHEDULE_STATS stats;
+    ADS1263_PERIODIC clock;
+    UDOUBLE Value[ADS1263_STREAM_MAX_CHANNELS];
+    UBYTE Flags[ADS1263_STREAM_MAX_CHANNELS];
+    uint64_t scan;
+
+    memset(&stats, 0, sizeof(stats));
+    ADS1263_Periodic_Init(&clock, (uint64_t)config->PeriodUs * 1000);
+    while (dev->Schedule.running.load(std::memory_order_relaxed)) {
+        if (dev->Schedule.reset.exchange(false, std::memory_order_relaxed))
+            memset(&stats, 0, sizeof(stats));
+        ADS1263_Periodic_Wait(&clock, &stats);
+
+        if (config->Profile != NULL)
+            ADS1263_Dev_ScanProfile(dev, config->Profile, Value, Flags);
+        else
+            ADS1263_Dev_ScanADC1(dev, config->Channels, Value, Flags, config->Number);
+        scan = DEV_Time_ns() - clock.Current;
+        if (scan > stats.ScanMax)
+            stats.ScanMax = scan;
+        config->Callback(Value, Flags, config->Number, clock.Current, config->Arg);
+
+        if (dev->Schedule.lock.try_lock()) {
+            dev->Schedule.published = stats;
+            dev->Schedule.lock.unlock();
+        }
+    }
+}
+
+/******************************************************************************
+function:  Scan a channel list at a fixed cadence on a background thread
+parameter:
+    config : channels, period, thread priority and result callback
+Info:
+    ADC1 must be initialized. Each scan is triggered at an absolute
+    CLOCK_MONOTONIC deadline and handed to the callback together with that
+    deadline. The scheduler thread owns the device until
+    ADS1263_StopSchedule; it cannot run alongside ADS1263_StartStream.
+    With a Profile its channels are scanned, each at its own rate, and
+    Number is taken from it; the profile is copied.
+    Return 0 success, 1 failed
+******************************************************************************/
+UBYTE ADS1263_Dev_StartSchedule(ads1263_t* dev, const ADS1263_SCHEDULE_CONFIG* config)
+{
+    if (dev->Schedule.running.load() || dev->Stream.running.load() || config == NULL) {
+        return 1;
+    }
+    if (config->Profile != NULL && (!ADS1263_Profile_Valid(config->Profile) || config->Profile->Mode != dev->ScanMode)) {
+        printf("Schedule profile invalid \r\n");
+        return 1;
+    }
+    if (config->Profile == NULL && (config->Number < 1 || config->Number > ADS1263_STREAM_MAX_CHANNELS)) {
+        printf("Schedule channel count %d invalid \r\n", config->Number);
+        return 1;
+    }
+    if (config->PeriodUs == 0 || config->Callback == NULL) {
+        printf("Schedule period or callback missing \r\n");
+        return 1;
+    }
+
+    dev->Schedule.config = *config;
+    if (config->Profile != NULL) {
+        dev->Schedule.profile = *config->Profile;
+        dev->Schedule.config.Profile = &dev->Schedule.profile;
+        dev->Schedule.config.Number = dev->Schedule.profile.Number;
+    }
+    memset(&dev->Schedule.published, 0, sizeof(dev->Schedule.published));
+    dev->Schedule.reset.store(false);
+
+    dev->Schedule.running.store(true);
+    dev->Schedule.thread = std::thread(ADS1263_Schedule_Loop, dev);
+    if (config->Priority > 0) {
+        struct sched_param param;
+        param.sched_priority = config->Priority;
+        if (pthread_setschedparam(dev->Schedule.thread.native_handle(), SCHED_FIFO, &param) != 0)
+            printf("Schedule SCHED_FIFO %d not permitted \r\n", config->Priority);
+    }
+    return 0;
+}
+
+void ADS1263_Dev_StopSchedule(ads1263_t* dev)
+{
+    if (!dev->Schedule.running.exchange(false)) {
+        return;
+    }
+    if (dev->Schedule.thread.joinable())
+        dev->Schedule.thread.join();
+}
+
+/******************************************************************************
+function:  Lateness statistics of the scheduler thread
+parameter:
+    stats : filled in, as of the last completed period
+Info:
+******************************************************************************/
+void ADS1263_Dev_GetScheduleStats(ads1263_t* dev, ADS1263_SCHEDULE_STATS* stats)
+{
+    std::lock_guard<std::mutex> guard(dev->Schedule.lock);
+    *stats = dev->Schedule.published;
+}
+
+/**
+ * Clear the statistics, takes effect at the next period
+**/
+void ADS1263_Dev_ResetScheduleStats(ads1263_t* dev)
+{
+    dev->Schedule.reset.store(true, std::memory_order_relaxed);
+}
+
+#pragma endregion
+
+#pragma region Stats
+
+/******************************************************************************
+function:  Snapshot of a device's driver counters
+parameter:
+    stats : filled in
+Info:
+    Lock-free; each counter is read on its own, so a snapshot taken while
+    sampling runs may be off by the few events in flight.
+******************************************************************************/
+void ADS1263_Dev_GetStats(ads1263_t* dev, ADS1263_STATS* stats)
+{
+    int i;
+    stats->Transactions = dev->Stats.Transactions.load(std::memory_order_relaxed);
+    stats->Bytes = dev->Stats.Bytes.load(std::memory_order_relaxed);
+    stats->TransferErrors = dev->Stats.TransferErrors.load(std::memory_order_relaxed);
+    stats->ChecksumErrors = dev->Stats.ChecksumErrors.load(std::memory_order_relaxed);
+    stats->DRDYWaits = dev->Stats.DRDYWaits.load(std::memory_order_relaxed);
+    stats->DRDYTimeouts = dev->Stats.DRDYTimeouts.load(std::memory_order_relaxed);
+    stats->StatusRetries = dev->Stats.StatusRetries.load(std::memory_order_relaxed);
+    stats->Overflows = dev->Stats.Overflows.load(std::memory_order_relaxed);
+    stats->Missed = dev->Stats.Missed.load(std::memory_order_relaxed);
+    for (i = 0; i < ADS1263_STATS_BINS; i++) {
+        stats->DRDYWait[i] = dev->Stats.DRDYWait[i].load(std::memory_order_relaxed);
+        stats->Transaction[i] = dev->Stats.Transaction[i].load(std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Zero the counters; events racing with the reset may land on either side
+**/
+void ADS1263_Dev_ResetStats(ads1263_t* dev)
+{
+    int i;
+    dev->Stats.Transactions.store(0, std::memory_order_relaxed);
+    dev->Stats.Bytes.store(0, std::memory_order_relaxed);
+    dev->Stats.TransferErrors.store(0, std::memory_order_relaxed);
+    dev->Stats.ChecksumErrors.store(0, std::memory_order_relaxed);
+    dev->Stats.DRDYWaits.store(0, std::memory_order_relaxed);
+    dev->Stats.DRDYTimeouts.store(0, std::memory_order_relaxed);
+    dev->Stats.StatusRetries.store(0, std::memory_order_relaxed);
+    dev->Stats.Overflows.store(0, std::memory_order_relaxed);
+    dev->Stats.Missed.store(0, std::memory_order_relaxed);
+    for (i = 0; i < ADS1263_STATS_BINS; i++) {
+        dev->Stats.DRDYWait[i].store(0, std::memory_order_relaxed);
+        dev->Stats.Transaction[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+#pragma endregion
+
+#pragma region Convert
+
+/**
+ * Vector kernels are picked at compile time from the target's instruction set;
+ * define ADS1263_CONVERT_SCALAR to build without them
+**/
+#if !defined(ADS1263_CONVERT_SCALAR) && defined(__AVX2__)
+#include <immintrin.h>
+#define ADS1263_CONVERT_AVX2
+#elif !defined(ADS1263_CONVERT_SCALAR) && defined(__SSE2__)
+#include <emmintrin.h>
+#define ADS1263_CONVERT_SSE2
+#elif !defined(ADS1263_CONVERT_SCALAR) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ADS1263_CONVERT_NEON
+#endif
+
+/* frames per pass through the unpack and scale stages, the intermediates live on the stack */
+#define ADS1263_CONVERT_BLOCK 256
+
+/******************************************************************************
+function:  Build the per-channel scale tables
+parameter:
+    Adc    : 1 or 2, selects the code width
+    Cal    : calibration of channels 0..Number-1, may be NULL if Number is 0
+    Number : channels in Cal, the remaining slots get the defaults
+Info:
+    LSB = Vref / (Gain * 2^31) on ADC1, Vref / (Gain * 2^23) on ADC2.
+    Volts = (code - Offset) * LSB * Correction.
+    Return 0 success, 1 invalid argument
+******************************************************************************/
+UBYTE ADS1263_Converter_Init(ADS1263_CONVERTER* conv, UBYTE Adc, const ADS1263_CHANNEL_CAL* Cal, int Number)
+{
+    int i;
+
+    if (conv == NULL || (Adc != 1 && Adc != 2) || Number < 0 || Number > ADS1263_CONVERT_CHANNELS
+        || (Number > 0 && Cal == NULL)) {
+        return 1;
+    }
+    conv->Adc = Adc;
+    for (i = 0; i < ADS1263_CONVERT_CHANNELS; i++) {
+        double Vref = 5.0, Gain = 1.0, Correction = 1.0;
+        int32_t Offset = 0;
+        if (i < Number) {
+            if (Cal[i].Vref != 0)
+                Vref = Cal[i].Vref;
+            if (Cal[i].Gain != 0)
+                Gain = Cal[i].Gain;
+            if (Cal[i].Correction != 0)
+                Correction = Cal[i].Correction;
+            Offset = Cal[i].Offset;
+        }
+        conv->Scale[i] = Vref * Correction / (Gain * (Adc == 1 ? 2147483648.0 : 8388608.0));
+        conv->Offset[i] = Offset;
+        conv->ScaleF[i] = (float)conv->Scale[i];
+        conv->OffsetF[i] = (float)Offset;
+    }
+    return 0;
+}
+
+/**
+ * Signed code and ADS1263_SAMPLE_* flags of one frame, the reference for the vector kernels
+**/
+static UBYTE ADS1263_Unpack_Frame(UBYTE Adc, const ADS1263_FRAME* Frame, int32_t* Code)
+{
+    UDOUBLE raw = ((UDOUBLE)Frame->Data[0] << 24) | ((UDOUBLE)Frame->Data[1] << 16) | ((UDOUBLE)Frame->Data[2] << 8);
+    UBYTE sum = Frame->Data[0] + Frame->Data[1] + Frame->Data[2] + 0x9b;
+    UBYTE Flags = 0;
+
+    if (Adc == 2) {
+        *Code = (int32_t)raw >> 8;          // 24-bit two's complement
+        if ((Frame->Status & 0x80) == 0)
+            Flags |= ADS1263_SAMPLE_STALE;
+    }
+    else {
+        raw |= Frame->Data[3];
+        sum += Frame->Data[3];
+        *Code = (int32_t)raw;
+        if ((Frame->Status & 0x40) == 0)
+            Flags |= ADS1263_SAMPLE_STALE;
+    }
+    if (sum != Frame->CRC)
+        Flags |= ADS1263_SAMPLE_CRC_ERROR;
+    return Flags;
+}
+
+static void ADS1263_Unpack_Scalar(const ADS1263_CONVERTER* conv, const ADS1263_FRAME* Frames, int From, int Number,
+    int32_t* Code, UBYTE* Channel, UBYTE* Flags)
+{
+    int i;
+    for (i = From; i < Number; i++) {
+        Flags[i] = ADS1263_Unpack_Frame(conv->Adc, &Frames[i], &Code[i]);
+        Channel[i] = Frames[i].Channel & (ADS1263_CONVERT_CHANNELS - 1);
+    }
+}
+
+/**
+ * Volts from codes. (code - offset) * scale: a subtract and a multiply, never
+ * contracted into an FMA, so every kernel rounds the same way
+**/
+static void ADS1263_Scale_Scalar(const ADS1263_CONVERTER* conv, const int32_t* Code, const UBYTE* Channel, int From, int Number,
+    float* Volts, double* VoltsD)
+{
+    int i;
+    for (i = From; i < Number; i++) {
+        UBYTE ch = Channel[i];
+        if (Volts != NULL)
+            Volts[i] = ((float)Code[i] - conv->OffsetF[ch]) * conv->ScaleF[ch];
+        if (VoltsD != NULL)
+            VoltsD[i] = ((double)Code[i] - conv->Offset[ch]) * conv->Scale[ch];
+    }
+}
+
+/******************************************************************************
+function:  Vector unpack of a block of frames
+parameter:
+Info:
+    Frames are loaded whole and split into their two 32-bit words:
+        w0 = Channel | Status << 8 | Data[0] << 16 | Data[1] << 24
+        w1 = Data[2] | Data[3] << 8 | CRC << 16
+    and the code, checksum and status test are done lane-wise with shifts
+    and masks, exactly as ADS1263_Unpack_Frame does them.
+    Return number of frames done, the scalar path finishes the rest
+******************************************************************************/
+static int ADS1263_Unpack_Vector(const ADS1263_CONVERTER* conv, const ADS1263_FRAME* Frames, int Number,
+    int32_t* Code, UBYTE* Channel, UBYTE* Flags)
+{
+    int i = 0;
+#if defined(ADS1263_CONVERT_AVX2)
+    const __m256i byte = _mm256_set1_epi32(0xff);
+    const __m256i seed = _mm256_set1_epi32(0x9b);
+    const __m256i ready = _mm256_set1_epi32(conv->Adc == 2 ? 0x8000 : 0x4000);
+    const __m256i slot = _mm256_set1_epi32(ADS1263_CONVERT_CHANNELS - 1);
+    const __m256i crc_error = _mm256_set1_epi32(ADS1263_SAMPLE_CRC_ERROR);
+    const __m256i stale = _mm256_set1_epi32(ADS1263_SAMPLE_STALE);
+    for (; i + 8 <= Number; i += 8) {
+        __m256 a = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)&Frames[i]));
+        __m256 b = _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)&Frames[i + 4]));
+        // in-lane shuffle leaves frames 0 1 4 5 | 2 3 6 7, the permute restores order
+        __m256i w0 = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i w1 = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i d0 = _mm256_and_si256(_mm256_srli_epi32(w0, 16), byte);
+        __m256i d1 = _mm256_srli_epi32(w0, 24);
+        __m256i d2 = _mm256_and_si256(w1, byte);
+        __m256i d3 = _mm256_and_si256(_mm256_srli_epi32(w1, 8), byte);
+        __m256i crc = _mm256_and_si256(_mm256_srli_epi32(w1, 16), byte);
+        __m256i raw = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(d0, 24), _mm256_slli_epi32(d1, 16)), _mm256_slli_epi32(d2, 8));
+        __m256i sum = _mm256_add_epi32(_mm256_add_epi32(d0, d1), _mm256_add_epi32(d2, seed));
+        __m256i code, flags, ch;
+        if (conv->Adc == 2) {
+            code = _mm256_srai_epi32(raw, 8);
+        }
+        else {
+            code = _mm256_or_si256(raw, d3);
+            sum = _mm256_add_epi32(sum, d3);
+        }
+        flags = _mm256_or_si256(
+            _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_and_si256(sum, byte), crc), crc_error),
+            _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_and_si256(w0, ready), ready), stale));
+        ch = _mm256_and_si256(w0, slot);
+        _mm256_storeu_si256((__m256i*)&Code[i], code);
+        // narrow to bytes: packs work per 128-bit lane, 4 results in each
+        flags = _mm256_packus_epi16(_mm256_packs_epi32(flags, flags), flags);
+        ch = _mm256_packus_epi16(_mm256_packs_epi32(ch, ch), ch);
+        int32_t f[2] = { _mm_cvtsi128_si32(_mm256_castsi256_si128(flags)), _mm_cvtsi128_si32(_mm256_extracti128_si256(flags, 1)) };
+        int32_t c[2] = { _mm_cvtsi128_si32(_mm256_castsi256_si128(ch)), _mm_cvtsi128_si32(_mm256_extracti128_si256(ch, 1)) };
+        memcpy(&Flags[i], f, 8);
+        memcpy(&Channel[i], c, 8);
+    }
+#elif defined(ADS1263_CONVERT_SSE2)
+    const __m128i byte = _mm_set1_epi32(0xff);
+    const __m128i seed = _mm_set1_epi32(0x9b);
+    const __m128i ready = _mm_set1_epi32(conv->Adc == 2 ? 0x8000 : 0x4000);
+    const __m128i slot = _mm_set1_epi32(ADS1263_CONVERT_CHANNELS - 1);
+    const __m128i crc_error = _mm_set1_epi32(ADS1263_SAMPLE_CRC_ERROR);
+    const __m128i stale = _mm_set1_epi32(ADS1263_SAMPLE_STALE);
+    for (; i + 4 <= Number; i += 4) {
+        __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&Frames[i]));
+        __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&Frames[i + 2]));
+        __m128i w0 = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i w1 = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m128i d0 = _mm_and_si128(_mm_srli_epi32(w0, 16), byte);
+        __m128i d1 = _mm_srli_epi32(w0, 24);
+        __m128i d2 = _mm_and_si128(w1, byte);
+        __m128i d3 = _mm_and_si128(_mm_srli_epi32(w1, 8), byte);
+        __m128i crc = _mm_and_si128(_mm_srli_epi32(w1, 16), byte);
+        __m128i raw = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(d0, 24), _mm_slli_epi32(d1, 16)), _mm_slli_epi32(d2, 8));
+        __m128i sum = _mm_add_epi32(_mm_add_epi32(d0, d1), _mm_add_epi32(d2, seed));
+        __m128i code, flags, ch;
+        int32_t f, c;
+        if (conv->Adc == 2) {
+            code = _mm_srai_epi32(raw, 8);
+        }
+        else {
+            code = _mm_or_si128(raw, d3);
+            sum = _mm_add_epi32(sum, d3);
+        }
+        flags = _mm_or_si128(
+            _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(sum, byte), crc), crc_error),
+            _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(w0, ready), ready), stale));
+        ch = _mm_and_si128(w0, slot);
+        _mm_storeu_si128((__m128i*)&Code[i], code);
+        f = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(flags, flags), flags));
+        c = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(ch, ch), ch));
+        memcpy(&Flags[i], &f, 4);
+        memcpy(&Channel[i], &c, 4);
+    }
+#elif defined(ADS1263_CONVERT_NEON)
+    const uint32x4_t byte = vdupq_n_u32(0xff);
+    const uint32x4_t seed = vdupq_n_u32(0x9b);
+    const uint32x4_t ready = vdupq_n_u32(conv->Adc == 2 ? 0x8000 : 0x4000);
+    const uint32x4_t slot = vdupq_n_u32(ADS1263_CONVERT_CHANNELS - 1);
+    const uint32x4_t crc_error = vdupq_n_u32(ADS1263_SAMPLE_CRC_ERROR);
+    const uint32x4_t stale = vdupq_n_u32(ADS1263_SAMPLE_STALE);
+    for (; i + 4 <= Number; i += 4) {
+        // vld2 splits the frames' even and odd words
+        uint32x4x2_t w = vld2q_u32((const uint32_t*)&Frames[i]);
+        uint32x4_t d0 = vandq_u32(vshrq_n_u32(w.val[0], 16), byte);
+        uint32x4_t d1 = vshrq_n_u32(w.val[0], 24);
+        uint32x4_t d2 = vandq_u32(w.val[1], byte);
+        uint32x4_t d3 = vandq_u32(vshrq_n_u32(w.val[1], 8), byte);
+        uint32x4_t crc = vandq_u32(vshrq_n_u32(w.val[1], 16), byte);
+        uint32x4_t raw = vorrq_u32(vorrq_u32(vshlq_n_u32(d0, 24), vshlq_n_u32(d1, 16)), vshlq_n_u32(d2, 8));
+        uint32x4_t sum = vaddq_u32(vaddq_u32(d0, d1), vaddq_u32(d2, seed));
+        uint32x4_t flags, ch;
+        int32x4_t code;
+        UBYTE f[8], c[8];
+        if (conv->Adc == 2) {
+            code = vshrq_n_s32(vreinterpretq_s32_u32(raw), 8);
+        }
+        else {
+            code = vreinterpretq_s32_u32(vorrq_u32(raw, d3));
+            sum = vaddq_u32(sum, d3);
+        }
+        flags = vorrq_u32(
+            vbicq_u32(crc_error, vceqq_u32(vandq_u32(sum, byte), crc)),
+            vbicq_u32(stale, vceqq_u32(vandq_u32(w.val[0], ready), ready)));
+        ch = vandq_u32(w.val[0], slot);
+        vst1q_s32(&Code[i], code);
+        vst1_u8(f, vmovn_u16(vcombine_u16(vmovn_u32(flags), vmovn_u32(flags))));
+        vst1_u8(c, vmovn_u16(vcombine_u16(vmovn_u32(ch), vmovn_u32(ch))));
+        memcpy(&Flags[i], f, 4);
+        memcpy(&Channel[i], c, 4);
+    }
+#endif
+    return i;
+}
+
+/**
+ * Vector (code - offset) * scale, per-lane tables gathered by channel.
+ * Return number of codes done, the scalar path finishes the rest
+**/
+static int ADS1263_Scale_Vector(const ADS1263_CONVERTER* conv, const int32_t* Code, const UBYTE* Channel, int Number,
+    float* Volts, double* VoltsD)
+{
+    int i = 0;
+#if defined(ADS1263_CONVERT_AVX2)
+    for (; i + 8 <= Number; i += 8) {
+        __m256i code = _mm256_loadu_si256((const __m256i*)&Code[i]);
+        __m256i ch = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&Channel[i]));
+        if (Volts != NULL) {
+            __m256 scale = _mm256_i32gather_ps(conv->ScaleF, ch, 4);
+            __m256 offset = _mm256_i32gather_ps(conv->OffsetF, ch, 4);
+            _mm256_storeu_ps(&Volts[i], _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(code), offset), scale));
+        }
+        if (VoltsD != NULL) {
+            __m128i lo = _mm256_castsi256_si128(ch), hi = _mm256_extracti128_si256(ch, 1);
+            _mm256_storeu_pd(&VoltsD[i], _mm256_mul_pd(
+                _mm256_sub_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(code)), _mm256_i32gather_pd(conv->Offset, lo, 8)),
+                _mm256_i32gather_pd(conv->Scale, lo, 8)));
+            _mm256_storeu_pd(&VoltsD[i + 4], _mm256_mul_pd(
+                _mm256_sub_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(code, 1)), _mm256_i32gather_pd(conv->Offset, hi, 8)),
+                _mm256_i32gather_pd(conv->Scale, hi, 8)));
+        }
+    }
+#elif defined(ADS1263_CONVERT_SSE2)
+    for (; i + 4 <= Number; i += 4) {
+        const UBYTE* ch = &Channel[i];
+        __m128i code = _mm_loadu_si128((const __m128i*)&Code[i]);
+        if (Volts != NULL) {
+            __m128 scale = _mm_setr_ps(conv->ScaleF[ch[0]], conv->ScaleF[ch[1]], conv->ScaleF[ch[2]], conv->ScaleF[ch[3]]);
+            __m128 offset = _mm_setr_ps(conv->OffsetF[ch[0]], conv->OffsetF[ch[1]], conv->OffsetF[ch[2]], conv->OffsetF[ch[3]]);
+            _mm_storeu_ps(&Volts[i], _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(code), offset), scale));
+        }
+        if (VoltsD != NULL) {
+            __m128d lo = _mm_cvtepi32_pd(code);
+            __m128d hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(code, _MM_SHUFFLE(1, 0, 3, 2)));
+            _mm_storeu_pd(&VoltsD[i], _mm_mul_pd(_mm_sub_pd(lo, _mm_setr_pd(conv->Offset[ch[0]], conv->Offset[ch[1]])),
+                _mm_setr_pd(conv->Scale[ch[0]], conv->Scale[ch[1]])));
+            _mm_storeu_pd(&VoltsD[i + 2], _mm_mul_pd(_mm_sub_pd(hi, _mm_setr_pd(conv->Offset[ch[2]], conv->Offset[ch[3]])),
+                _mm_setr_pd(conv->Scale[ch[2]], conv->Scale[ch[3]])));
+        }
+    }
+#elif defined(ADS1263_CONVERT_NEON)
+    for (; i + 4 <= Number; i += 4) {
+        const UBYTE* ch = &Channel[i];
+        int32x4_t code = vld1q_s32(&Code[i]);
+        if (Volts != NULL) {
+            float s[4] = { conv->ScaleF[ch[0]], conv->ScaleF[ch[1]], conv->ScaleF[ch[2]], conv->ScaleF[ch[3]] };
+            float o[4] = { conv->OffsetF[ch[0]], conv->OffsetF[ch[1]], conv->OffsetF[ch[2]], conv->OffsetF[ch[3]] };
+            vst1q_f32(&Volts[i], vmulq_f32(vsubq_f32(vcvtq_f32_s32(code), vld1q_f32(o)), vld1q_f32(s)));
+        }
+        if (VoltsD != NULL) {
+#if defined(__aarch64__)
+            // int32 -> int64 -> double is exact, as is the scalar cast
+            float64x2_t lo = vcvtq_f64_s64(vmovl_s32(vget_low_s32(code)));
+            float64x2_t hi = vcvtq_f64_s64(vmovl_s32(vget_high_s32(code)));
+            double s[4] = { conv->Scale[ch[0]], conv->Scale[ch[1]], conv->Scale[ch[2]], conv->Scale[ch[3]] };
+            double o[4] = { conv->Offset[ch[0]], conv->Offset[ch[1]], conv->Offset[ch[2]], conv->Offset[ch[3]] };
+            vst1q_f64(&VoltsD[i], vmulq_f64(vsubq_f64(lo, vld1q_f64(o)), vld1q_f64(s)));
+            vst1q_f64(&VoltsD[i + 2], vmulq_f64(vsubq_f64(hi, vld1q_f64(o + 2)), vld1q_f64(s + 2)));
+#else
+            // 32-bit NEON has no double lanes
+            ADS1263_Scale_Scalar(conv, Code, Channel, i, i + 4, NULL, VoltsD);
+#endif
+        }
+    }
+#endif
+    return i;
+}
+
+/**
+ * Shared body of ADS1263_DecodeFrames and ADS1263_DecodeFrames_Scalar
+**/
+static int ADS1263_Decode_Block(const ADS1263_CONVERTER* conv, const ADS1263_FRAME* Frames, int Number,
+    int32_t* Code, float* Volts, double* VoltsD, UBYTE* Flags, UBYTE Vector)
+{
+    int32_t code[ADS1263_CONVERT_BLOCK];
+    UBYTE channel[ADS1263_CONVERT_BLOCK], flags[ADS1263_CONVERT_BLOCK];
+    int done, n, k, i, bad = 0;
+
+    if (conv == NULL || Frames == NULL) {
+        return 0;
+    }
+    for (done = 0; done < Number; done += n) {
+        int32_t* c = Code != NULL ? Code + done : code;
+        UBYTE* f = Flags != NULL ? Flags + done : flags;
+        float* v = Volts != NULL ? Volts + done : NULL;
+        double* vd = VoltsD != NULL ? VoltsD + done : NULL;
+        n = Number - done < ADS1263_CONVERT_BLOCK ? Number - done : ADS1263_CONVERT_BLOCK;
+
+        k = Vector ? ADS1263_Unpack_Vector(conv, Frames + done, n, c, channel, f) : 0;
+        ADS1263_Unpack_Scalar(conv, Frames + done, k, n, c, channel, f);
+        if (v != NULL || vd != NULL) {
+            k = Vector ? ADS1263_Scale_Vector(conv, c, channel, n, v, vd) : 0;
+            ADS1263_Scale_Scalar(conv, c, channel, k, n, v, vd);
+        }
+        for (i = 0; i < n; i++)
+            bad += f[i] != 0;
+    }
+    return bad;
+}
+
+/******************************************************************************
+function:  Bulk decode of raw frames to signed codes and volts
+parameter:
+    conv   : tables from ADS1263_Converter_Init
+    Frames : raw RDATA1 or RDATA2 frames, per conv->Adc
+    Number : frames
+    Code   : signed codes, may be NULL
+    Volts  : float volts, may be NULL
+    VoltsD : double volts, may be NULL
+    Flags  : ADS1263_SAMPLE_CRC_ERROR / ADS1263_SAMPLE_STALE per frame, may be NULL
+Info:
+    Uses the vector kernel of the build (see ADS1263_ConvertKernel); the
+    results are bit-identical to ADS1263_DecodeFrames_Scalar. Flagged frames
+    are still converted.
+    Return number of flagged frames
+******************************************************************************/
+int ADS1263_DecodeFrames(const ADS1263_CONVERTER* conv, const ADS1263_FRAME* Frames, int Number,
+    int32_t* Code, float* Volts, double* VoltsD, UBYTE* Flags)
+{
+    return ADS1263_Decode_Block(conv, Frames, Number, Code, Volts, VoltsD, Flags, 1);
+}
+
+/**
+ * ADS1263_DecodeFrames without the vector kernels, the reference they are checked against
+**/
+int ADS1263_DecodeFrames_Scalar(const ADS1263_CONVERTER* conv, const ADS1263_FRAME* Frames, int Number,
+    int32_t* Code, float* Volts, double* VoltsD, UBYTE* Flags)
+{
+    return ADS1263_Decode_Block(conv, Frames, Number, Code, Volts, VoltsD, Flags, 0);
+}
+
+/******************************************************************************
+function:  Convert stream samples to signed codes and volts
+parameter:
+    conv    : tables from ADS1263_Converter_Init, Adc matching the stream
+    Samples : from ADS1263_ReadSamples or ADS1263_ReadSamples_ADC2
+    Code, Volts, VoltsD : outputs, each may be NULL
+Info:
+    The codes were checked when the samples were taken, only the scaling
+    is done here.
+******************************************************************************/
+void ADS1263_ConvertSamples(const ADS1263_CONVERTER* conv, const ADS1263_SAMPLE* Samples, int Number,
+    int32_t* Code, float* Volts, double* VoltsD)
+{
+    int32_t code[ADS1263_CONVERT_BLOCK];
+    UBYTE channel[ADS1263_CONVERT_BLOCK];
+    int done, n, k, i;
+
+    if (conv == NULL || Samples == NULL) {
+        return;
+    }
+    for (done = 0; done < Number; done += n) {
+        int32_t* c = Code != NULL ? Code + done : code;
+        float* v = Volts != NULL ? Volts + done : NULL;
+        double* vd = VoltsD != NULL ? VoltsD + done : NULL;
+        n = Number - done < ADS1263_CONVERT_BLOCK ? Number - done : ADS1263_CONVERT_BLOCK;
+
+        for (i = 0; i < n; i++) {
+            UDOUBLE Value = Samples[done + i].Value;
+            c[i] = conv->Adc == 2 ? (int32_t)(Value << 8) >> 8 : (int32_t)Value;
+            channel[i] = Samples[done + i].Channel & (ADS1263_CONVERT_CHANNELS - 1);
+        }
+        k = ADS1263_Scale_Vector(conv, c, channel, n, v, vd);
+        ADS1263_Scale_Scalar(conv, c, channel, k, n, v, vd);
+    }
+}
+
+/**
+ * Name of the vector kernel built in: "avx2", "sse2", "neon" or "scalar"
+**/
+const char* ADS1263_ConvertKernel()
+{
+#if defined(ADS1263_CONVERT_AVX2)
+    return "avx2";
+#elif defined(ADS1263_CONVERT_SSE2)
+    return "sse2";
+#elif defined(ADS1263_CONVERT_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+#pragma endregion
+
+#pragma region Decimate
+
+/**
+ * No FMA contraction in this region, whatever -ffp-contract and -m flags
+ * the build uses: the vector kernels and ADS1263_Decimator_Process_Scalar
+ * then round every multiply and add the same way and agree bit for bit
+**/
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/**
+ * The CIC runs in uint64_t lanes, wrapping like the hardware registers it
+ * models; the result is exact while Order * log2(R) leaves the 32-bit code
+ * room below 2^63. Arrays are [row][Channels], unpadded.
+**/
+struct ADS1263_DECIMATOR {
+    ADS1263_DECIM_CONFIG config;
+    int C;
+    int Order;
+    int R;
+    int M;
+    int Taps;
+    int Notches;
+    double gain;                    // 1 / R^Order
+    int phase;                      // input frames into the current CIC output
+    int fphase;                     // FIR inputs into the current output
+    int warm;                       // CIC outputs so far, the combs fill for Order of them
+    int pos;                        // FIR line row written next
+    uint64_t* integ;                // [Order][C]
+    uint64_t* comb;                 // [Order][C]
+    double* coef;                   // [Taps], symmetric
+    double* line;                   // [2 * Taps][C], every row written twice so a window is contiguous
+    double notch[ADS1263_DECIM_MAX_NOTCHES][5];    // b0 b1 b2 a1 a2
+    double* z;                      // [Notches][2][C]
+    double* y;                      // [C], one CIC output on its way through
+    void* mem;
+};
+
+/**
+ * CIC magnitude at f cycles per CIC output sample, 1 at DC
+**/
+static double ADS1263_Cic_Response(int Order, int R, double f)
+{
+    double num, den;
+
+    if (Order == 0 || R == 1 || f == 0) {
+        return 1.0;
+    }
+    num = sin(M_PI * f);
+    den = R * sin(M_PI * f / R);
+    return pow(fabs(num / den), Order);
+}
+
+/**
+ * Windowed design of the FIR: the ideal low-pass up to fc, divided by the
+ * CIC response so the passband comes out flat, integrated numerically,
+ * Blackman windowed and normalized to unit DC gain
+**/
+static void ADS1263_Fir_Design(ADS1263_DECIMATOR* dec, double fc)
+{
+    const int steps = 1024;
+    double sum = 0;
+    int k, i;
+
+    for (k = 0; k < dec->Taps; k++) {
+        double m = k - (dec->Taps - 1) / 2.0, h = 0;
+        for (i = 0; i < steps; i++) {
+            double f = (i + 0.5) * fc / steps;
+            h += cos(2.0 * M_PI * f * m) / ADS1263_Cic_Response(dec->Order, dec->R, f);
+        }
+        h *= 2.0 * fc / steps;
+        if (dec->Taps > 1)
+            h *= 0.42 - 0.5 * cos(2.0 * M_PI * k / (dec->Taps - 1)) + 0.08 * cos(4.0 * M_PI * k / (dec->Taps - 1));
+        dec->coef[k] = h;
+        sum += h;
+    }
+    for (k = 0; k < dec->Taps; k++)
+        dec->coef[k] /= sum;
+}
+
+/******************************************************************************
+function:  Create a decimator
+parameter:
+    config : channels, input rate, CIC, FIR and notch settings
+Info:
+    Designs the FIR and the notches and allocates all state; processing
+    allocates nothing.
+    Return the decimator, NULL on an invalid setting or allocation failure
+******************************************************************************/
+ADS1263_DECIMATOR* ADS1263_Decimator_Create(const ADS1263_DECIM_CONFIG* config)
+{
+    ADS1263_DECIMATOR* dec;
+    double rate1, fc;
+    size_t size;
+    int k, C;
+
+    if (config == NULL || config->Channels < 1 || config->Channels > ADS1263_CONVERT_CHANNELS || config->Rate <= 0
+        || config->CicOrder < 0 || config->CicOrder > ADS1263_DECIM_MAX_ORDER || config->CicDecimation < 0
+        || (config->CicOrder == 0 && config->CicDecimation > 1) || config->FirTaps < 0 || config->FirTaps > ADS1263_DECIM_MAX_TAPS
+        || config->FirDecimation < 0 || (config->FirTaps == 0 && config->FirDecimation > 1)
+        || config->NotchHarmonics < 0 || config->NotchHarmonics > ADS1263_DECIM_MAX_NOTCHES) {
+        printf("Decimator: invalid configuration \r\n");
+        return NULL;
+    }
+    dec = new (std::nothrow) ADS1263_DECIMATOR;
+    if (dec == NULL) {
+        return NULL;
+    }
+    memset(dec, 0, sizeof(*dec));
+    dec->config = *config;
+    dec->C = C = config->Channels;
+    dec->Order = config->CicOrder;
+    dec->R = config->CicDecimation > 0 ? config->CicDecimation : 1;
+    dec->M = config->FirDecimation > 0 ? config->FirDecimation : 1;
+    dec->Taps = config->FirTaps > 0 ? config->FirTaps | 1 : 0;
+    if (dec->Order * log2((double)dec->R) > 32) {
+        printf("Decimator: CIC order %d with decimation %d overflows \r\n", dec->Order, dec->R);
+        delete dec;
+        return NULL;
+    }
+    dec->gain = 1.0 / pow((double)dec->R, dec->Order);
+    rate1 = config->Rate / dec->R;
+    fc = config->Cutoff > 0 ? config->Cutoff : 0.4 * rate1 / dec->M;
+    if (dec->Taps > 0 && fc >= rate1 / 2) {
+        printf("Decimator: cutoff %.1f Hz above the CIC output Nyquist \r\n", fc);
+        delete dec;
+        return NULL;
+    }
+
+    // RBJ notch per harmonic below the CIC output Nyquist
+    if (config->NotchHz > 0) {
+        double Q = config->NotchQ > 0 ? config->NotchQ : 30.0;
+        int harmonics = config->NotchHarmonics > 0 ? config->NotchHarmonics : 1;
+        for (k = 1; k <= harmonics && k * config->NotchHz < rate1 / 2; k++) {
+            double w0 = 2.0 * M_PI * k * config->NotchHz / rate1, alpha = sin(w0) / (2.0 * Q), a0 = 1.0 + alpha;
+            double* q = dec->notch[dec->Notches++];
+            q[0] = 1.0 / a0;
+            q[1] = -2.0 * cos(w0) / a0;
+            q[2] = 1.0 / a0;
+            q[3] = -2.0 * cos(w0) / a0;
+            q[4] = (1.0 - alpha) / a0;
+        }
+    }
+
+    size = (2 * (size_t)dec->Order * C) * sizeof(uint64_t) + (size_t)dec->Taps * sizeof(double)
+        + (2 * (size_t)dec->Taps * C + 2 * (size_t)dec->Notches * C + C) * sizeof(double);
+    if (posix_memalign(&dec->mem, ADS1263_CACHE_LINE, size) != 0) {
+        printf("Decimator allocation failed \r\n");
+        delete dec;
+        return NULL;
+    }
+    dec->integ = (uint64_t*)dec->mem;
+    dec->comb = dec->integ + dec->Order * C;
+    dec->coef = (double*)(dec->comb + dec->Order * C);
+    dec->line = dec->coef + dec->Taps;
+    dec->z = dec->line + 2 * dec->Taps * C;
+    dec->y = dec->z + 2 * dec->Notches * C;
+    if (dec->Taps > 0)
+        ADS1263_Fir_Design(dec, fc / rate1);
+    ADS1263_Decimator_Reset(dec);
+    return dec;
+}
+
+void ADS1263_Decimator_Destroy(ADS1263_DECIMATOR* dec)
+{
+    if (dec == NULL) {
+        return;
+    }
+    free(dec->mem);
+    delete dec;
+}
+
+/**
+ * Forget all input; the next output is settled again from the first one
+**/
+void ADS1263_Decimator_Reset(ADS1263_DECIMATOR* dec)
+{
+    memset(dec->integ, 0, 2 * (size_t)dec->Order * dec->C * sizeof(uint64_t));
+    dec->phase = 0;
+    dec->fphase = 0;
+    dec->warm = 0;
+    dec->pos = 0;
+}
+
+/**
+ * Output frames per second
+**/
+double ADS1263_Decimator_Rate(const ADS1263_DECIMATOR* dec)
+{
+    return dec->config.Rate / dec->R / dec->M;
+}
+
+/**
+ * Most output frames the next Frames input frames can give, the room Out needs
+**/
+int ADS1263_Decimator_OutputFrames(const ADS1263_DECIMATOR* dec, int Frames)
+{
+    int cic = (dec->phase + Frames) / dec->R;
+    return dec->Taps > 0 ? (dec->fphase + cic) / dec->M : cic;
+}
+
+/**
+ * Integrators over Frames frames, channels From..C-1
+**/
+static void ADS1263_Cic_Integrate_Scalar(ADS1263_DECIMATOR* dec, const int32_t* x, int Frames, int From)
+{
+    int c, t, k;
+    for (c = From; c < dec->C; c++) {
+        uint64_t s[ADS1263_DECIM_MAX_ORDER];
+        for (k = 0; k < dec->Order; k++)
+            s[k] = dec->integ[k * dec->C + c];
+        for (t = 0; t < Frames; t++) {
+            uint64_t v = (uint64_t)(int64_t)x[t * dec->C + c];
+            for (k = 0; k < dec->Order; k++)
+                v = s[k] += v;
+        }
+        for (k = 0; k < dec->Order; k++)
+            dec->integ[k * dec->C + c] = s[k];
+    }
+}
+
+/**
+ * Vector integrators, a group of channels per pass with the state held in
+ * registers over all Frames. Return number of channels done, the scalar
+ * path finishes the rest
+**/
+static int ADS1263_Cic_Integrate_Vector(ADS1263_DECIMATOR* dec, const int32_t* x, int Frames)
+{
+    int g = 0, t, k, C = dec->C, Order = dec->Order;
+#if defined(ADS1263_CONVERT_AVX2)
+    for (; g + 4 <= C; g += 4) {
+        __m256i s[ADS1263_DECIM_MAX_ORDER];
+        for (k = 0; k < Order; k++)
+            s[k] = _mm256_loadu_si256((const __m256i*)&dec->integ[k * C + g]);
+        for (t = 0; t < Frames; t++) {
+            __m256i v = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*)&x[t * C + g]));
+            for (k = 0; k < Order; k++)
+                v = s[k] = _mm256_add_epi64(s[k], v);
+        }
+        for (k = 0; k < Order; k++)
+            _mm256_storeu_si256((__m256i*)&dec->integ[k * C + g], s[k]);
+    }
+#elif defined(ADS1263_CONVERT_SSE2)
+    for (; g + 2 <= C; g += 2) {
+        __m128i s[ADS1263_DECIM_MAX_ORDER];
+        for (k = 0; k < Order; k++)
+            s[k] = _mm_loadu_si128((const __m128i*)&dec->integ[k * C + g]);
+        for (t = 0; t < Frames; t++) {
+            // sign-extend two codes to 64 bits without SSE4.1
+            __m128i v = _mm_loadl_epi64((const __m128i*)&x[t * C + g]);
+            v = _mm_unpacklo_epi32(v, _mm_srai_epi32(v, 31));
+            for (k = 0; k < Order; k++)
+                v = s[k] = _mm_add_epi64(s[k], v);
+        }
+        for (k = 0; k < Order; k++)
+            _mm_storeu_si128((__m128i*)&dec->integ[k * C + g], s[k]);
+    }
+#elif defined(ADS1263_CONVERT_NEON)
+    for (; g + 2 <= C; g += 2) {
+        uint64x2_t s[ADS1263_DECIM_MAX_ORDER];
+        for (k = 0; k < Order; k++)
+            s[k] = vld1q_u64(&dec->integ[k * C + g]);
+        for (t = 0; t < Frames; t++) {
+            uint64x2_t v = vreinterpretq_u64_s64(vmovl_s32(vld1_s32(&x[t * C + g])));
+            for (k = 0; k < Order; k++)
+                v = s[k] = vaddq_u64(s[k], v);
+        }
+        for (k = 0; k < Order; k++)
+            vst1q_u64(&dec->integ[k * C + g], s[k]);
+    }
+#endif
+    (void)t;
+    (void)k;
+    (void)C;
+    (void)Order;
+    return g;
+}
+
+/**
+ * Notch biquads in sequence on dec->y, transposed direct form II
+**/
+static void ADS1263_Notch_Scalar(ADS1263_DECIMATOR* dec, int From)
+{
+    int n, c;
+    for (n = 0; n < dec->Notches; n++) {
+        const double* q = dec->notch[n];
+        double* z1 = &dec->z[(2 * n) * dec->C];
+        double* z2 = &dec->z[(2 * n + 1) * dec->C];
+        for (c = From; c < dec->C; c++) {
+            double x = dec->y[c], y = q[0] * x + z1[c];
+            z1[c] = q[1] * x - q[3] * y + z2[c];
+            z2[c] = q[2] * x - q[4] * y;
+            dec->y[c] = y;
+        }
+    }
+}
+
+static int ADS1263_Notch_Vector(ADS1263_DECIMATOR* dec)
+{
+    int g = 0, n, C = dec->C;
+#if defined(ADS1263_CONVERT_AVX2)
+    for (; g + 4 <= C; g += 4) {
+        __m256d y = _mm256_loadu_pd(&dec->y[g]);
+        for (n = 0; n < dec->Notches; n++) {
+            const double* q = dec->notch[n];
+            double* z1 = &dec->z[(2 * n) * C + g];
+            double* z2 = &dec->z[(2 * n + 1) * C + g];
+            __m256d x = y;
+            y = _mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(q[0]), x), _mm256_loadu_pd(z1));
+            _mm256_storeu_pd(z1, _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(q[1]), x),
+                _mm256_mul_pd(_mm256_set1_pd(q[3]), y)), _mm256_loadu_pd(z2)));
+            _mm256_storeu_pd(z2, _mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(q[2]), x), _mm256_mul_pd(_mm256_set1_pd(q[4]), y)));
+        }
+        _mm256_storeu_pd(&dec->y[g], y);
+    }
+#elif defined(ADS1263_CONVERT_SSE2)
+    for (; g + 2 <= C; g += 2) {
+        __m128d y = _mm_loadu_pd(&dec->y[g]);
+        for (n = 0; n < dec->Notches; n++) {
+            const double* q = dec->notch[n];
+            double* z1 = &dec->z[(2 * n) * C + g];
+            double* z2 = &dec->z[(2 * n + 1) * C + g];
+            __m128d x = y;
+            y = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(q[0]), x), _mm_loadu_pd(z1));
+            _mm_storeu_pd(z1, _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(q[1]), x), _mm_mul_pd(_mm_set1_pd(q[3]), y)), _mm_loadu_pd(z2)));
+            _mm_storeu_pd(z2, _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(q[2]), x), _mm_mul_pd(_mm_set1_pd(q[4]), y)));
+        }
+        _mm_storeu_pd(&dec->y[g], y);
+    }
+#elif defined(ADS1263_CONVERT_NEON) && defined(__aarch64__)
+    for (; g + 2 <= C; g += 2) {
+        float64x2_t y = vld1q_f64(&dec->y[g]);
+        for (n = 0; n < dec->Notches; n++) {
+            const double* q = dec->notch[n];
+            double* z1 = &dec->z[(2 * n) * C + g];
+            double* z2 = &dec->z[(2 * n + 1) * C + g];
+            float64x2_t x = y;
+            y = vaddq_f64(vmulq_n_f64(x, q[0]), vld1q_f64(z1));
+            vst1q_f64(z1, vaddq_f64(vsubq_f64(vmulq_n_f64(x, q[1]), vmulq_n_f64(y, q[3])), vld1q_f64(z2)));
+            vst1q_f64(z2, vsubq_f64(vmulq_n_f64(x, q[2]), vmulq_n_f64(y, q[4])));
+        }
+        vst1q_f64(&dec->y[g], y);
+    }
+#endif
+    (void)n;
+    (void)C;
+    return g;
+}
+
+/**
+ * One FIR output from the window of the last Taps rows
+**/
+static void ADS1263_Fir_Scalar(const ADS1263_DECIMATOR* dec, const double* win, double* out, int From)
+{
+    int c, k;
+    for (c = From; c < dec->C; c++) {
+        double acc = 0;
+        for (k = 0; k < dec->Taps; k++)
+            acc += dec->coef[k] * win[k * dec->C + c];
+        out[c] = acc;
+    }
+}
+
+static int ADS1263_Fir_Vector(const ADS1263_DECIMATOR* dec, const double* win, double* out)
+{
+    int g = 0, k, C = dec->C;
+#if defined(ADS1263_CONVERT_AVX2)
+    for (; g + 4 <= C; g += 4) {
+        __m256d acc = _mm256_setzero_pd();
+        for (k = 0; k < dec->Taps; k++)
+            acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_set1_pd(dec->coef[k]), _mm256_loadu_pd(&win[k * C + g])));
+        _mm256_storeu_pd(&out[g], acc);
+    }
+#elif defined(ADS1263_CONVERT_SSE2)
+    for (; g + 2 <= C; g += 2) {
+        __m128d acc = _mm_setzero_pd();
+        for (k = 0; k < dec->Taps; k++)
+            acc = _mm_add_pd(acc, _mm_mul_pd(_mm_set1_pd(dec->coef[k]), _mm_loadu_pd(&win[k * C + g])));
+        _mm_storeu_pd(&out[g], acc);
+    }
+#elif defined(ADS1263_CONVERT_NEON) && defined(__aarch64__)
+    for (; g + 2 <= C; g += 2) {
+        float64x2_t acc = vdupq_n_f64(0);
+        for (k = 0; k < dec->Taps; k++)
+            acc = vaddq_f64(acc, vmulq_n_f64(vld1q_f64(&win[k * C + g]), dec->coef[k]));
+        vst1q_f64(&out[g], acc);
+    }
+#endif
+    (void)k;
+    (void)C;
+    return g;
+}
+
+/**
+ * Comb stages of one CIC output into dec->y. last: the frame just
+ * integrated, taken as is without a CIC stage
+**/
+static void ADS1263_Cic_Comb(ADS1263_DECIMATOR* dec, const int32_t* last)
+{
+    int c, k;
+    for (c = 0; c < dec->C; c++) {
+        uint64_t v;
+        if (dec->Order == 0) {
+            dec->y[c] = last[c];
+            continue;
+        }
+        v = dec->integ[(dec->Order - 1) * dec->C + c];
+        for (k = 0; k < dec->Order; k++) {
+            uint64_t prev = dec->comb[k * dec->C + c];
+            dec->comb[k * dec->C + c] = v;
+            v -= prev;
+        }
+        dec->y[c] = (double)(int64_t)v * dec->gain;
+    }
+}
+
+/**
+ * Start the notches and the FIR line at the steady state of the first
+ * settled CIC output, as if it had always been the input
+**/
+static void ADS1263_Decimator_Prime(ADS1263_DECIMATOR* dec)
+{
+    int n, c, k;
+    for (n = 0; n < dec->Notches; n++) {
+        const double* q = dec->notch[n];
+        for (c = 0; c < dec->C; c++) {
+            // unit DC gain: y = x
+            dec->z[(2 * n) * dec->C + c] = dec->y[c] * (1.0 - q[0]);
+            dec->z[(2 * n + 1) * dec->C + c] = dec->y[c] * (q[2] - q[4]);
+        }
+    }
+    for (k = 0; k < 2 * dec->Taps; k++)
+        memcpy(&dec->line[k * dec->C], dec->y, dec->C * sizeof(double));
+}
+
+/**
+ * Shared body of ADS1263_Decimator_Process and ADS1263_Decimator_Process_Scalar
+**/
+static int ADS1263_Decimator_Run(ADS1263_DECIMATOR* dec, const int32_t* Codes, int Frames, double* Out, int OutFrames, UBYTE Vector)
+{
+    int done = 0, out = 0, n, k, C;
+
+    if (dec == NULL || Codes == NULL || Out == NULL || Frames < 0 || OutFrames < ADS1263_Decimator_OutputFrames(dec, Frames)) {
+        return -1;
+    }
+    C = dec->C;
+    while (done < Frames) {
+        n = dec->R - dec->phase;
+        if (n > Frames - done)
+            n = Frames - done;
+        if (dec->Order > 0) {
+            k = Vector ? ADS1263_Cic_Integrate_Vector(dec, Codes + done * C, n) : 0;
+            ADS1263_Cic_Integrate_Scalar(dec, Codes + done * C, n, k);
+        }
+        done += n;
+        dec->phase += n;
+        if (dec->phase < dec->R)
+            break;
+        dec->phase = 0;
+
+        ADS1263_Cic_Comb(dec, Codes + (done - 1) * C);
+        if (dec->warm < dec->Order) {
+            dec->warm++;            // combs still filling
+            continue;
+        }
+        if (dec->warm == dec->Order) {
+            ADS1263_Decimator_Prime(dec);
+            dec->warm++;
+        }
+        k = Vector ? ADS1263_Notch_Vector(dec) : 0;
+        ADS1263_Notch_Scalar(dec, k);
+
+        if (dec->Taps == 0) {
+            memcpy(&Out[out++ * C], dec->y, C * sizeof(double));
+            continue;
+        }
+        memcpy(&dec->line[dec->pos * C], dec->y, C * sizeof(double));
+        memcpy(&dec->line[(dec->pos + dec->Taps) * C], dec->y, C * sizeof(double));
+        dec->pos = dec->pos + 1 < dec->Taps ? dec->pos + 1 : 0;
+        if (++dec->fphase < dec->M)
+            continue;
+        dec->fphase = 0;
+        // rows pos..pos+Taps-1 are the last Taps inputs, oldest first; the taps are symmetric
+        k = Vector ? ADS1263_Fir_Vector(dec, &dec->line[dec->pos * C], &Out[out * C]) : 0;
+        ADS1263_Fir_Scalar(dec, &dec->line[dec->pos * C], &Out[out * C], k);
+        out++;
+    }
+    return out;
+}
+
+/******************************************************************************
+function:  Filter and decimate a block of frames
+parameter:
+    dec       : from ADS1263_Decimator_Create
+    Codes     : Frames frames of Channels signed codes, interleaved
+    Frames    : input frames, any count; state carries over between calls
+    Out       : output frames of Channels doubles, interleaved
+    OutFrames : room in Out, at least ADS1263_Decimator_OutputFrames(dec, Frames)
+Info:
+    Uses the vector kernels of the build (see ADS1263_ConvertKernel); the
+    results are bit-identical to ADS1263_Decimator_Process_Scalar. The
+    first output follows Order CIC outputs, the stages after the CIC start
+    settled on it.
+    Return number of output frames, -1 on an invalid argument or too small Out
+******************************************************************************/
+int ADS1263_Decimator_Process(ADS1263_DECIMATOR* dec, const int32_t* Codes, int Frames, double* Out, int OutFrames)
+{
+    return ADS1263_Decimator_Run(dec, Codes, Frames, Out, OutFrames, 1);
+}
+
+/**
+ * ADS1263_Decimator_Process without the vector kernels, the reference they are checked against
+**/
+int ADS1263_Decimator_Process_Scalar(ADS1263_DECIMATOR* dec, const int32_t* Codes, int Frames, double* Out, int OutFrames)
+{
+    return ADS1263_Decimator_Run(dec, Codes, Frames, Out, OutFrames, 0);
+}
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT DEFAULT
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#pragma endregion
+
+#pragma region Blocks
+
+#include <sys/eventfd.h>
+
+static_assert(sizeof(ADS1263_BLOCK_SAMPLE) == 32, "ADS1263_BLOCK_SAMPLE layout");
+
+static inline void ADS1263_Block_Push(ADS1263_BLOCK_QUEUE* queue, ADS1263_BLOCK* block)
+{
+    uint64_t head = queue->head.load(std::memory_order_relaxed);
+    queue->slot[head % ADS1263_BLOCK_MAX] = block;
+    queue->head.store(head + 1, std::memory_order_release);
+}
+
+static inline ADS1263_BLOCK* ADS1263_Block_Pop(ADS1263_BLOCK_QUEUE* queue)
+{
+    uint64_t tail = queue->tail.load(std::memory_order_relaxed);
+    ADS1263_BLOCK* block;
+    if (tail == queue->head.load(std::memory_order_acquire)) {
+        return NULL;
+    }
+    block = queue->slot[tail % ADS1263_BLOCK_MAX];
+    queue->tail.store(tail + 1, std::memory_order_release);
+    return block;
+}
+
+/**
+ * One stream sample in block layout, volts through the converter of its ADC
+**/
+static inline void ADS1263_Block_Fill(ADS1263_BLOCK_SAMPLE* s, const ADS1263_CONVERTER* conv, const ADS1263_SAMPLE* sample, UBYTE Adc)
+{
+    UBYTE ch = sample->Channel & (ADS1263_CONVERT_CHANNELS - 1);
+    s->Timestamp = sample->Timestamp;
+    s->Sequence = sample->Sequence;
+    s->Raw = Adc == 2 ? (int32_t)(sample->Value << 8) >> 8 : (int32_t)sample->Value;
+    s->Volts = ((double)s->Raw - conv->Offset[ch]) * conv->Scale[ch];
+    s->Channel = sample->Channel;
+    s->Status = sample->Status;
+    s->Flags = sample->Flags | (Adc == 2 ? ADS1263_SAMPLE_ADC2 : 0);
+    s->Reserved = 0;
+}
+
+/**
+ * Hand the current block to the consumer, acquisition thread
+**/
+static void ADS1263_Block_Deliver(ads1263_t* dev)
+{
+    ADS1263_BLOCK* block = dev->Blocks.current;
+    uint64_t one = 1;
+
+    block->Index = dev->Blocks.index++;
+    dev->Blocks.current = NULL;
+    ADS1263_Block_Push(&dev->Blocks.ready, block);
+    if (DEV_Syscall(write(dev->Blocks.fd, &one, sizeof(one))) < 0) {
+        Debug("block eventfd write failed\r\n");
+    }
+}
+
+/**
+ * Store one conversion in the current block, taking a free block if there
+ * is none; with no free block the sample is dropped and counted
+**/
+static void ADS1263_Block_Put(ads1263_t* dev, const ADS1263_SAMPLE* sample, UBYTE Adc)
+{
+    ADS1263_BLOCK* block = dev->Blocks.current;
+
+    if (block == NULL) {
+        block = ADS1263_Block_Pop(&dev->Blocks.free);
+        if (block == NULL) {
+            dev->Blocks.overflows.fetch_add(1, std::memory_order_relaxed);
+            ADS1263_Count(dev->Stats.Overflows);
+            return;
+        }
+        block->Count = 0;
+        dev->Blocks.current = block;
+        dev->Blocks.first_ns = sample->Timestamp;
+    }
+    ADS1263_Block_Fill(&block->Samples[block->Count], Adc == 2 ? &dev->Blocks.conv2 : &dev->Blocks.conv, sample, Adc);
+    if (++block->Count == block->Capacity)
+        ADS1263_Block_Deliver(dev);
+}
+
+/**
+ * Deliver a partly filled block if waiting for the next predicted DRDY would
+ * age its first sample past FlushUs; Force delivers it regardless
+**/
+static void ADS1263_Block_Flush(ads1263_t* dev, UBYTE Force)
+{
+    uint64_t next, flush_ns = (uint64_t)dev->Blocks.config.FlushUs * 1000;
+
+    if (dev->Blocks.current == NULL || dev->Blocks.current->Count == 0) {
+        return;
+    }
+    if (!Force) {
+        if (flush_ns == 0)
+            return;
+        next = dev->Conv.next_ns != 0 ? dev->Conv.next_ns : DEV_Time_ns();
+        if (next < dev->Blocks.first_ns + flush_ns)
+            return;
+    }
+    ADS1263_Block_Deliver(dev);
+}
+
+/**
+ * Callback mode: wait on the eventfd, pass each block to the callback and
+ * release it on return. Drains what is ready once more before exiting.
+**/
+static void ADS1263_Block_Loop(ads1263_t* dev)
+{
+    struct pollfd pfd = { dev->Blocks.fd, POLLIN, 0 };
+    ADS1263_BLOCK* block;
+
+    while (1) {
+        bool running = dev->Blocks.running.load();
+        while ((block = ADS1263_Dev_GetBlock(dev)) != NULL) {
+            dev->Blocks.config.Callback(block, dev->Blocks.config.Arg);
+            ADS1263_Dev_ReleaseBlock(dev, block);
+        }
+        if (!running)
+            break;
+        DEV_Syscall(poll(&pfd, 1, -1));
+    }
+}
+
+/******************************************************************************
+function:  Deliver the stream in caller-owned sample blocks
+parameter:
+    config : blocks, flush bound, callback or fd handover, converters
+Info:
+    Attach before ADS1263_StartStream/StartDualStream. While attached the
+    acquisition thread fills the blocks instead of the stream rings, and
+    ADS1263_ReadSamples returns nothing. Block memory is the caller's and
+    must stay valid until ADS1263_DetachBlocks.
+    Return 0 success, 1 failed
+******************************************************************************/
+UBYTE ADS1263_Dev_AttachBlocks(ads1263_t* dev, const ADS1263_BLOCK_CONFIG* config)
+{
+    int i;
+
+    if (dev->Stream.running.load() || dev->Blocks.attached || config == NULL) {
+        return 1;
+    }
+    if (config->Number < 1 || config->Number > ADS1263_BLOCK_MAX || config->Blocks == NULL) {
+        printf("Block count %d invalid \r\n", config != NULL ? config->Number : 0);
+        return 1;
+    }
+    for (i = 0; i < config->Number; i++) {
+        if (config->Blocks[i].Samples == NULL || config->Blocks[i].Capacity == 0) {
+            printf("Block %d has no samples \r\n", i);
+            return 1;
+        }
+    }
+    if (config->Converter != NULL)
+        dev->Blocks.conv = *config->Converter;
+    else
+        ADS1263_Converter_Init(&dev->Blocks.conv, 1, NULL, 0);
+    if (config->Converter2 != NULL)
+        dev->Blocks.conv2 = *config->Converter2;
+    else
+        ADS1263_Converter_Init(&dev->Blocks.conv2, 2, NULL, 0);
+
+    dev->Blocks.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (dev->Blocks.fd < 0) {
+        printf("Block eventfd failed \r\n");
+        return 1;
+    }
+    dev->Blocks.config = *config;
+    dev->Blocks.current = NULL;
+    dev->Blocks.index = 0;
+    dev->Blocks.overflows.store(0);
+    dev->Blocks.free.head.store(0);
+    dev->Blocks.free.tail.store(0);
+    dev->Blocks.ready.head.store(0);
+    dev->Blocks.ready.tail.store(0);
+    for (i = 0; i < config->Number; i++)
+        ADS1263_Block_Push(&dev->Blocks.free, &config->Blocks[i]);
+
+    if (config->Callback != NULL) {
+        dev->Blocks.running.store(true);
+        dev->Blocks.thread = std::thread(ADS1263_Block_Loop, dev);
+        if (config->Priority > 0) {
+            struct sched_param param;
+            param.sched_priority = config->Priority;
+            if (pthread_setschedparam(dev->Blocks.thread.native_handle(), SCHED_FIFO, &param) != 0)
+                printf("Block SCHED_FIFO %d not permitted \r\n", config->Priority);
+        }
+    }
+    dev->Blocks.attached = 1;
+    return 0;
+}
+
+/**
+ * Stop the stream if it runs, deliver what is left and give the blocks back
+**/
+void ADS1263_Dev_DetachBlocks(ads1263_t* dev)
+{
+    uint64_t one = 1;
+
+    if (!dev->Blocks.attached) {
+        return;
+    }
+    ADS1263_Dev_StopStream(dev);
+    if (dev->Blocks.running.exchange(false)) {
+        if (DEV_Syscall(write(dev->Blocks.fd, &one, sizeof(one))) < 0) {
+            Debug("block eventfd write failed\r\n");
+        }
+        if (dev->Blocks.thread.joinable())
+            dev->Blocks.thread.join();
+    }
+    dev->Blocks.attached = 0;
+    close(dev->Blocks.fd);
+    dev->Blocks.fd = -1;
+}
+
+/**
+ * eventfd that polls readable while delivered blocks wait, -1 if not attached
+**/
+int ADS1263_Dev_GetBlockFd(ads1263_t* dev)
+{
+    return dev->Blocks.fd;
+}
+
+/******************************************************************************
+function:  Take the next delivered block
+parameter:
+Info:
+    Single consumer; never blocks. The fd is cleared only when the queue
+    was seen empty, so a block delivered meanwhile still wakes the next poll.
+    Return the block, NULL if none is ready
+******************************************************************************/
+ADS1263_BLOCK* ADS1263_Dev_GetBlock(ads1263_t* dev)
+{
+    ADS1263_BLOCK* block;
+    uint64_t count;
+
+    if (dev->Blocks.fd < 0) {
+        return NULL;
+    }
+    block = ADS1263_Block_Pop(&dev->Blocks.ready);
+    if (block == NULL && DEV_Syscall(read(dev->Blocks.fd, &count, sizeof(count))) == sizeof(count))
+        block = ADS1263_Block_Pop(&dev->Blocks.ready);
+    return block;
+}
+
+/**
+ * Return a block taken with ADS1263_GetBlock for refilling
+**/
+void ADS1263_Dev_ReleaseBlock(ads1263_t* dev, ADS1263_BLOCK* Block)
+{
+    if (Block != NULL && dev->Blocks.attached)
+        ADS1263_Block_Push(&dev->Blocks.free, Block);
+}
+
+/**
+ * Conversions dropped because every block was with the consumer
+**/
+uint64_t ADS1263_Dev_GetBlockOverflows(ads1263_t* dev)
+{
+    return dev->Blocks.overflows.load(std::memory_order_relaxed);
+}
+
+#pragma endregion
+
+#pragma region Shm
+
+#include <sys/mman.h>
+
+/**
+ * Publish one conversion: mark the slot odd, write it, mark it even with
+ * its index, then advance Head. No syscall, no lock
+**/
+static void ADS1263_Shm_Put(ads1263_t* dev, const ADS1263_SAMPLE* sample, UBYTE Adc)
+{
+    uint64_t i = dev->Shm.head;
+    ADS1263_SHM_SLOT* slot = &dev->Shm.slots[i & (dev->Shm.header->Capacity - 1)];
+
+    __atomic_store_n(&slot->Seq, 2 * i + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ADS1263_Block_Fill(&slot->Sample, Adc == 2 ? &dev->Shm.conv2 : &dev->Shm.conv, sample, Adc);
+    __atomic_store_n(&slot->Seq, 2 * i + 2, __ATOMIC_RELEASE);
+    dev->Shm.head = i + 1;
+    __atomic_store_n(&dev->Shm.header->Head, i + 1, __ATOMIC_RELEASE);
+}
+
+/******************************************************************************
+function:  Publish the stream in a shared-memory ring
+parameter:
+    config : shm name, ring capacity, permissions, converters
+Info:
+    Call before ADS1263_StartStream; the stream's own delivery (ring or
+    blocks) goes on as before. An existing segment of the same name is
+    replaced. The data rates in the header are the ones programmed now.
+    Return 0 success, 1 failed
+******************************************************************************/
+UBYTE ADS1263_Dev_StartPublish(ads1263_t* dev, const ADS1263_SHM_CONFIG* config)
+{
+    ADS1263_SHM_HEADER* header;
+    uint64_t capacity = 1;
+    size_t size;
+    void* base;
+    int fd, i;
+
+    if (dev->Stream.running.load() || dev->Shm.header != NULL || config == NULL || config->Name == NULL
+        || strlen(config->Name) >= sizeof(dev->Shm.name)) {
+        return 1;
+    }
+    while (capacity < (config->Capacity != 0 ? config->Capacity : 65536))
+        capacity <<= 1;
+    size = sizeof(ADS1263_SHM_HEADER) + capacity * sizeof(ADS1263_SHM_SLOT);
+
+    shm_unlink(config->Name);
+    fd = shm_open(config->Name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, config->Mode != 0 ? config->Mode : 0644);
+    if (fd < 0) {
+        printf("shm_open %s failed \r\n", config->Name);
+        return 1;
+    }
+    if (ftruncate(fd, size) < 0) {
+        printf("shm %s: %zu bytes not available \r\n", config->Name, size);
+        close(fd);
+        shm_unlink(config->Name);
+        return 1;
+    }
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        printf("mmap %s failed \r\n", config->Name);
+        shm_unlink(config->Name);
+        return 1;
+    }
+
+    if (config->Converter != NULL)
+        dev->Shm.conv = *config->Converter;
+    else
+        ADS1263_Converter_Init(&dev->Shm.conv, 1, NULL, 0);
+    if (config->Converter2 != NULL)
+        dev->Shm.conv2 = *config->Converter2;
+    else
+        ADS1263_Converter_Init(&dev->Shm.conv2, 2, NULL, 0);
+
+    // a fresh segment is zero: every Seq is 0, which matches no sample
+    header = (ADS1263_SHM_HEADER*)base;
+    header->Magic = ADS1263_SHM_MAGIC;
+    header->Version = ADS1263_SHM_VERSION;
+    header->HeaderSize = sizeof(ADS1263_SHM_HEADER);
+    header->SlotSize = sizeof(ADS1263_SHM_SLOT);
+    header->Capacity = capacity;
+    header->Publisher = getpid();
+    header->StartNs = DEV_Time_ns();
+    header->Rate = dev->Shadow[REG_MODE2] & 0x0f;
+    header->Rate2 = dev->Shadow[REG_ADC2CFG] >> 6;
+    for (i = 0; i < ADS1263_CONVERT_CHANNELS; i++) {
+        header->Meta[0][i].Scale = dev->Shm.conv.Scale[i];
+        header->Meta[0][i].Offset = dev->Shm.conv.Offset[i];
+        header->Meta[1][i].Scale = dev->Shm.conv2.Scale[i];
+        header->Meta[1][i].Offset = dev->Shm.conv2.Offset[i];
+    }
+    __atomic_store_n(&header->Head, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&header->State, 1, __ATOMIC_RELEASE);
+
+    strcpy(dev->Shm.name, config->Name);
+    dev->Shm.slots = (ADS1263_SHM_SLOT*)((UBYTE*)base + sizeof(ADS1263_SHM_HEADER));
+    dev->Shm.size = size;
+    dev->Shm.head = 0;
+    dev->Shm.header = header;
+    return 0;
+}
+
+/**
+ * Stop the stream if it runs, mark the ring stopped and remove its name;
+ * readers that have it mapped keep what was published
+**/
+void ADS1263_Dev_StopPublish(ads1263_t* dev)
+{
+    if (dev->Shm.header == NULL) {
+        return;
+    }
+    ADS1263_Dev_StopStream(dev);
+    __atomic_store_n(&dev->Shm.header->State, 0, __ATOMIC_RELEASE);
+    munmap(dev->Shm.header, dev->Shm.size);
+    shm_unlink(dev->Shm.name);
+    dev->Shm.header = NULL;
+    dev->Shm.slots = NULL;
+}
+
+/******************************************************************************
+function:  Map a published ring read-only
+parameter:
+    reader : reader state
+    Name   : shm name the publisher used
+Info:
+    Needs no device. Reading starts at the current head.
+    Return 0 success, -1 failed (no segment, wrong magic or version)
+******************************************************************************/
+int ADS1263_Shm_Open(ADS1263_SHM_READER* reader, const char* Name)
+{
+    const ADS1263_SHM_HEADER* header;
+    struct stat st;
+    void* base;
+    int fd;
+
+    reader->Header = NULL;
+    fd = shm_open(Name, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ADS1263_SHM_HEADER)) {
+        close(fd);
+        return -1;
+    }
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    header = (const ADS1263_SHM_HEADER*)base;
+    if (header->Magic != ADS1263_SHM_MAGIC || header->Version != ADS1263_SHM_VERSION
+        || header->SlotSize < sizeof(ADS1263_SHM_SLOT)
+        || header->HeaderSize + header->Capacity * header->SlotSize > (uint64_t)st.st_size) {
+        printf("%s is not an ADS1263 ring of version %d \r\n", Name, ADS1263_SHM_VERSION);
+        munmap(base, st.st_size);
+        return -1;
+    }
+    reader->Header = header;
+    reader->Size = st.st_size;
+    reader->Next = __atomic_load_n(&header->Head, __ATOMIC_ACQUIRE);
+    reader->Overruns = 0;
+    return 0;
+}
+
+void ADS1263_Shm_Close(ADS1263_SHM_READER* reader)
+{
+    if (reader->Header != NULL)
+        munmap((void*)reader->Header, reader->Size);
+    reader->Header = NULL;
+}
+
+/******************************************************************************
+function:  Copy out the samples published since the last read
+parameter:
+    reader : reader state
+    buf    : destination
+    n      : capacity of buf in samples
+Info:
+    Never blocks, no syscalls. If the publisher lapped the reader, the
+    lost samples are added to Overruns and reading resumes at the head.
+    Return number of samples copied
+******************************************************************************/
+int ADS1263_Shm_Read(ADS1263_SHM_READER* reader, ADS1263_BLOCK_SAMPLE* buf, int n)
+{
+    const ADS1263_SHM_HEADER* header = reader->Header;
+    const UBYTE* slots;
+    uint64_t head, mask;
+    int count = 0;
+
+    if (header == NULL || n <= 0) {
+        return 0;
+    }
+    slots = (const UBYTE*)header + header->HeaderSize;
+    mask = header->Capacity - 1;
+    head = __atomic_load_n(&header->Head, __ATOMIC_ACQUIRE);
+    if (head - reader->Next > header->Capacity) {
+        reader->Overruns += head - reader->Next;
+        reader->Next = head;
+    }
+    while (count < n && reader->Next < head) {
+        const ADS1263_SHM_SLOT* slot = (const ADS1263_SHM_SLOT*)(slots + (reader->Next & mask) * header->SlotSize);
+        uint64_t seq = __atomic_load_n(&slot->Seq, __ATOMIC_ACQUIRE);
+        if (seq == 2 * reader->Next + 2) {
+            buf[count] = slot->Sample;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->Seq, __ATOMIC_RELAXED) == seq) {
+                count++;
+                reader->Next++;
+                continue;
+            }
+        }
+        // overwritten while we were behind: skip to the current head
+        head = __atomic_load_n(&header->Head, __ATOMIC_ACQUIRE);
+        reader->Overruns += head - reader->Next;
+        reader->Next = head;
+    }
+    return count;
+}
+
+#pragma endregion
+
+#pragma region Record
+
+#include <sys/uio.h>
+
+/**
+ * CRC-32 (IEEE 802.3, reflected), continued from crc; start with 0
+**/
+static uint32_t ADS1263_CRC32(uint32_t crc, const void* data, size_t len)
+{
+    static const struct CRC32_TABLE {
+        uint32_t t[256];
+        CRC32_TABLE() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+        }
+    } table;
+    const UBYTE* p = (const UBYTE*)data;
+
+    crc = ~crc;
+    while (len--)
+        crc = table.t[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static inline UBYTE* ADS1263_Rec_Varint(UBYTE* p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (UBYTE)v | 0x80;
+        v >>= 7;
+    }
+    *p++ = (UBYTE)v;
+    return p;
+}
+
+static inline uint64_t ADS1263_Rec_Zigzag(int64_t v)
+{
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+/**
+ * Read one varint below end. Return NULL if it runs past end
+**/
+static inline const UBYTE* ADS1263_Rec_Unvarint(const UBYTE* p, const UBYTE* end, uint64_t* v)
+{
+    uint64_t r = 0;
+    int shift = 0;
+
+    while (p < end && shift < 64) {
+        UBYTE b = *p++;
+        r |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            *v = r;
+            return p;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+static inline int64_t ADS1263_Rec_Unzigzag(uint64_t v)
+{
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+/**
+ * Close the current block and pass it to the writer, acquisition thread.
+ * The payload is padded to 8 bytes so every header in the file stays aligned
+**/
+static void ADS1263_Rec_Deliver(ads1263_t* dev)
+{
+    ADS1263_REC_BLOCK* block = dev->Rec.current;
+    UBYTE* payload = (UBYTE*)(block + 1);
+
+    while ((dev->Rec.pos - payload) & 7)
+        *dev->Rec.pos++ = 0;
+    block->Size = (uint32_t)(dev->Rec.pos - payload);
+    block->LastTimestamp = dev->Rec.prev_ts;
+    dev->Rec.current = NULL;
+    {
+        std::lock_guard<std::mutex> lock(dev->Rec.lock);
+        dev->Rec.produced.fetch_add(1, std::memory_order_release);
+    }
+    dev->Rec.wake.notify_one();
+}
+
+/**
+ * Encode one conversion into the current block, opening one from the pool
+ * first. No syscall unless the block fills up; if the writer still holds
+ * every buffer the sample is counted as a drop.
+**/
+static void ADS1263_Rec_Put(ads1263_t* dev, const ADS1263_SAMPLE* sample, UBYTE Adc)
+{
+    ADS1263_REC_BLOCK* block = dev->Rec.current;
+    UBYTE a = Adc == 2 ? 1 : 0;
+    UBYTE ch = sample->Channel & ADS1263_REC_TAG_CHANNEL;
+    UBYTE flags = sample->Flags & ~ADS1263_SAMPLE_ADC2;
+    int32_t code = Adc == 2 ? (int32_t)(sample->Value << 8) >> 8 : (int32_t)sample->Value;
+    UBYTE* p;
+
+    if (block == NULL) {
+        uint64_t produced = dev->Rec.produced.load(std::memory_order_relaxed);
+        if (produced - dev->Rec.written.load(std::memory_order_acquire) >= (uint64_t)dev->Rec.config.Buffers) {
+            dev->Rec.drops.fetch_add(1, std::memory_order_relaxed);
+            ADS1263_Count(dev->Stats.Overflows);
+            return;
+        }
+        block = (ADS1263_REC_BLOCK*)(dev->Rec.pool + (produced % dev->Rec.config.Buffers) * dev->Rec.stride);
+        memset(block, 0, sizeof(*block));
+        block->Magic = ADS1263_REC_BLOCK_MAGIC;
+        block->FirstTimestamp = sample->Timestamp;
+        dev->Rec.current = block;
+        dev->Rec.pos = (UBYTE*)(block + 1);
+        dev->Rec.prev_ts = sample->Timestamp;
+        dev->Rec.seq_set[0] = dev->Rec.seq_set[1] = 0;
+        dev->Rec.prev_status = 0;
+        memset(dev->Rec.prev_code, 0, sizeof(dev->Rec.prev_code));
+    }
+    if (!dev->Rec.seq_set[a]) {
+        block->FirstSequence[a] = sample->Sequence;
+        dev->Rec.prev_seq[a] = sample->Sequence - 1;
+        dev->Rec.seq_set[a] = 1;
+    }
+
+    p = dev->Rec.pos;
+    UBYTE* tag = p++;
+    *tag = ch | (a ? ADS1263_REC_TAG_ADC2 : 0);
+    if (sample->Status != dev->Rec.prev_status) {
+        *tag |= ADS1263_REC_TAG_STATUS;
+        *p++ = sample->Status;
+        dev->Rec.prev_status = sample->Status;
+    }
+    if (flags != 0) {
+        *tag |= ADS1263_REC_TAG_FLAGS;
+        *p++ = flags;
+    }
+    p = ADS1263_Rec_Varint(p, sample->Sequence - dev->Rec.prev_seq[a] - 1);
+    p = ADS1263_Rec_Varint(p, ADS1263_Rec_Zigzag((int64_t)(sample->Timestamp - dev->Rec.prev_ts)));
+    p = ADS1263_Rec_Varint(p, ADS1263_Rec_Zigzag((int64_t)code - dev->Rec.prev_code[a][ch]));
+    dev->Rec.pos = p;
+    dev->Rec.prev_seq[a] = sample->Sequence;
+    dev->Rec.prev_ts = sample->Timestamp;
+    dev->Rec.prev_code[a][ch] = code;
+
+    if (++block->Count == dev->Rec.config.BlockSamples)
+        ADS1263_Rec_Deliver(dev);
+}
+
+/**
+ * Pass a partly filled block on once its first sample is older than
+ * FlushMs at the next predicted DRDY; Force passes it regardless
+**/
+static void ADS1263_Rec_Flush(ads1263_t* dev, UBYTE Force)
+{
+    uint64_t next;
+
+    if (dev->Rec.current == NULL || dev->Rec.current->Count == 0) {
+        return;
+    }
+    if (!Force) {
+        next = dev->Conv.next_ns != 0 ? dev->Conv.next_ns : DEV_Time_ns();
+        if (next < dev->Rec.current->FirstTimestamp + (uint64_t)dev->Rec.config.FlushMs * 1000000)
+            return;
+    }
+    ADS1263_Rec_Deliver(dev);
+}
+
+/**
+ * write() all of buf, retrying short writes. Return 0 success, -1 failed
+**/
+static int ADS1263_Rec_WriteAll(int fd, struct iovec* iov, int n)
+{
+    while (n > 0) {
+        ssize_t w = writev(fd, iov, n);
+        if (w < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        while (n > 0 && (size_t)w >= iov->iov_len) {
+            w -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (UBYTE*)iov->iov_base + w;
+            iov->iov_len -= w;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Add an index entry for the block at the current offset, writer thread.
+ * Return 0 success, 1 out of memory
+**/
+static UBYTE ADS1263_Rec_AddIndex(ads1263_t* dev, const ADS1263_REC_BLOCK* block)
+{
+    if (dev->Rec.index_count == dev->Rec.index_cap) {
+        uint64_t cap = dev->Rec.index_cap != 0 ? dev->Rec.index_cap * 2 : 1024;
+        ADS1263_REC_INDEX* index = (ADS1263_REC_INDEX*)realloc(dev->Rec.index, cap * sizeof(ADS1263_REC_INDEX));
+        if (index == NULL) {
+            return 1;
+        }
+        dev->Rec.index = index;
+        dev->Rec.index_cap = cap;
+    }
+    dev->Rec.index[dev->Rec.index_count].Offset = dev->Rec.offset;
+    dev->Rec.index[dev->Rec.index_count].FirstTimestamp = block->FirstTimestamp;
+    dev->Rec.index[dev->Rec.index_count].FirstSequence = block->FirstSequence[0];
+    dev->Rec.index_count++;
+    return 0;
+}
+
+/**
+ * Writer thread: checksum every block handed over and append them all in
+ * one writev, then return the buffers. Drains the pool before exiting.
+ * After a write error the blocks are dropped so acquisition never waits.
+**/
+static void ADS1263_Rec_Loop(ads1263_t* dev)
+{
+    struct iovec iov[ADS1263_BLOCK_MAX];
+
+    while (1) {
+        uint64_t first, last, i, samples = 0;
+        bool running;
+        int n = 0;
+        {
+            std::unique_lock<std::mutex> lock(dev->Rec.lock);
+            dev->Rec.wake.wait(lock, [dev] {
+                return dev->Rec.produced.load() != dev->Rec.written.load() || !dev->Rec.running.load();
+            });
+            running = dev->Rec.running.load();
+        }
+        first = dev->Rec.written.load(std::memory_order_relaxed);
+        last = dev->Rec.produced.load(std::memory_order_acquire);
+        for (i = first; i < last; i++) {
+            ADS1263_REC_BLOCK* block = (ADS1263_REC_BLOCK*)(dev->Rec.pool + (i % dev->Rec.config.Buffers) * dev->Rec.stride);
+            size_t size = sizeof(*block) + block->Size;
+            block->CRC = ADS1263_CRC32(0, &block->Size, size - offsetof(ADS1263_REC_BLOCK, Size));
+            iov[n].iov_base = block;
+            iov[n].iov_len = size;
+            n++;
+            samples += block->Count;
+        }
+        if (n > 0 && !dev->Rec.error && ADS1263_Rec_WriteAll(dev->Rec.fd, iov, n) != 0) {
+            printf("Record write failed: %s \r\n", strerror(errno));
+            dev->Rec.error = 1;
+        }
+        if (dev->Rec.error) {
+            dev->Rec.drops.fetch_add(samples, std::memory_order_relaxed);
+            n = 0;
+        }
+        // a missing entry only lengthens the walk of a seek
+        for (i = 0; i < (uint64_t)n; i++) {
+            const ADS1263_REC_BLOCK* block = (const ADS1263_REC_BLOCK*)iov[i].iov_base;
+            if (dev->Rec.blocks % dev->Rec.config.IndexEvery == 0)
+                ADS1263_Rec_AddIndex(dev, block);
+            dev->Rec.offset += sizeof(*block) + block->Size;
+            dev->Rec.blocks++;
+            dev->Rec.samples += block->Count;
+        }
+        dev->Rec.written.store(last, std::memory_order_release);
+        if (!running && last == dev->Rec.produced.load())
+            break;
+    }
+}
+
+/******************************************************************************
+function:  Record the stream to a file
+parameter:
+    config : path, block size, index spacing, flush bound, buffers in flight
+Info:
+    Call before ADS1263_StartStream/StartDualStream; the stream's own
+    delivery goes on as before. The header keeps the register map of now,
+    so program the ADCs first. The acquisition thread only encodes, a
+    writer thread appends whole blocks. ADS1263_StopRecord writes the index.
+    Return 0 success, 1 failed
+******************************************************************************/
+UBYTE ADS1263_Dev_StartRecord(ads1263_t* dev, const ADS1263_REC_CONFIG* config)
+{
+    ADS1263_REC_HEADER header;
+    struct timespec ts;
+    struct iovec iov;
+
+    if (dev->Stream.running.load() || dev->Rec.active || config == NULL || config->Path == NULL) {
+        return 1;
+    }
+    dev->Rec.config = *config;
+    if (dev->Rec.config.BlockSamples == 0)
+        dev->Rec.config.BlockSamples = 4096;
+    if (dev->Rec.config.IndexEvery == 0)
+        dev->Rec.config.IndexEvery = 16;
+    if (dev->Rec.config.FlushMs == 0)
+        dev->Rec.config.FlushMs = 1000;
+    if (dev->Rec.config.Buffers <= 0)
+        dev->Rec.config.Buffers = 8;
+    if (dev->Rec.config.Buffers > ADS1263_BLOCK_MAX)
+        dev->Rec.config.Buffers = ADS1263_BLOCK_MAX;
+    dev->Rec.stride = (sizeof(ADS1263_REC_BLOCK) + (size_t)dev->Rec.config.BlockSamples * ADS1263_REC_SAMPLE_MAX + 7) & ~(size_t)7;
+    if (posix_memalign((void**)&dev->Rec.pool, ADS1263_CACHE_LINE, dev->Rec.stride * dev->Rec.config.Buffers) != 0) {
+        printf("Record buffer allocation failed \r\n");
+        dev->Rec.pool = NULL;
+        return 1;
+    }
+
+    dev->Rec.fd = open(config->Path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (dev->Rec.fd < 0) {
+        printf("Open %s failed \r\n", config->Path);
+        free(dev->Rec.pool);
+        dev->Rec.pool = NULL;
+        return 1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, ADS1263_REC_MAGIC, sizeof(header.Magic));
+    header.Version = ADS1263_REC_VERSION;
+    header.HeaderSize = sizeof(header);
+    header.StartNs = DEV_Time_ns();
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header.StartRealtime = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    header.BlockSamples = dev->Rec.config.BlockSamples;
+    header.IndexEvery = dev->Rec.config.IndexEvery;
+    memcpy(header.Regs, dev->Shadow, sizeof(header.Regs));
+    header.CRC = ADS1263_CRC32(0, &header, offsetof(ADS1263_REC_HEADER, CRC));
+    iov.iov_base = &header;
+    iov.iov_len = sizeof(header);
+    if (ADS1263_Rec_WriteAll(dev->Rec.fd, &iov, 1) != 0) {
+        printf("Write %s failed \r\n", config->Path);
+        close(dev->Rec.fd);
+        dev->Rec.fd = -1;
+        free(dev->Rec.pool);
+        dev->Rec.pool = NULL;
+        return 1;
+    }
+
+    dev->Rec.produced.store(0);
+    dev->Rec.written.store(0);
+    dev->Rec.drops.store(0);
+    dev->Rec.current = NULL;
+    dev->Rec.offset = sizeof(header);
+    dev->Rec.blocks = 0;
+    dev->Rec.samples = 0;
+    dev->Rec.index_count = 0;
+    dev->Rec.error = 0;
+    dev->Rec.running.store(true);
+    dev->Rec.thread = std::thread(ADS1263_Rec_Loop, dev);
+    dev->Rec.active = 1;
+    return 0;
+}
+
+/**
+ * Stop the stream if it runs, write out what is buffered, then the index
+ * and the trailer, and close the file
+**/
+void ADS1263_Dev_StopRecord(ads1263_t* dev)
+{
+    ADS1263_REC_TRAILER trailer;
+    struct iovec iov[2];
+
+    if (!dev->Rec.active) {
+        return;
+    }
+    ADS1263_Dev_StopStream(dev);
+    {
+        std::lock_guard<std::mutex> lock(dev->Rec.lock);
+        dev->Rec.running.store(false);
+    }
+    dev->Rec.wake.notify_one();
+    dev->Rec.thread.join();
+    dev->Rec.active = 0;
+
+    if (!dev->Rec.error) {
+        memset(&trailer, 0, sizeof(trailer));
+        trailer.Offset = dev->Rec.offset;
+        trailer.Count = dev->Rec.index_count;
+        trailer.Blocks = dev->Rec.blocks;
+        trailer.Samples = dev->Rec.samples;
+        trailer.Magic = ADS1263_REC_INDEX_MAGIC;
+        trailer.CRC = ADS1263_CRC32(ADS1263_CRC32(0, dev->Rec.index, dev->Rec.index_count * sizeof(ADS1263_REC_INDEX)),
+            &trailer, offsetof(ADS1263_REC_TRAILER, CRC));
+        iov[0].iov_base = dev->Rec.index;
+        iov[0].iov_len = dev->Rec.index_count * sizeof(ADS1263_REC_INDEX);
+        iov[1].iov_base = &trailer;
+        iov[1].iov_len = sizeof(trailer);
+        if (ADS1263_Rec_WriteAll(dev->Rec.fd, iov, 2) != 0 || fsync(dev->Rec.fd) != 0)
+            printf("Record index write failed \r\n");
+    }
+    close(dev->Rec.fd);
+    dev->Rec.fd = -1;
+    free(dev->Rec.pool);
+    dev->Rec.pool = NULL;
+    free(dev->Rec.index);
+    dev->Rec.index = NULL;
+    dev->Rec.index_cap = 0;
+}
+
+/**
+ * Samples not recorded: every buffer was still with the writer, or the file failed
+**/
+uint64_t ADS1263_Dev_GetRecordDrops(ads1263_t* dev)
+{
+    return dev->Rec.drops.load();
+}
+
+/**
+ * Header of a whole block at Offset, NULL if there is none
+**/
+static const ADS1263_REC_BLOCK* ADS1263_Rec_Block(const ADS1263_REC_READER* reader, uint64_t Offset)
+{
+    const ADS1263_REC_BLOCK* block;
+
+    if (reader->Base == NULL || Offset < reader->Header->HeaderSize || (Offset & 7)
+        || Offset + sizeof(ADS1263_REC_BLOCK) > reader->End) {
+        return NULL;
+    }
+    block = (const ADS1263_REC_BLOCK*)(reader->Base + Offset);
+    if (block->Magic != ADS1263_REC_BLOCK_MAGIC || Offset + sizeof(ADS1263_REC_BLOCK) + block->Size > reader->End) {
+        return NULL;
+    }
+    return block;
+}
+
+/**
+ * Offset of the block after the one at Offset, 0 at the end
+**/
+static uint64_t ADS1263_Rec_Next(const ADS1263_REC_READER* reader, uint64_t Offset)
+{
+    const ADS1263_REC_BLOCK* block = ADS1263_Rec_Block(reader, Offset);
+
+    if (block == NULL) {
+        return 0;
+    }
+    Offset += sizeof(ADS1263_REC_BLOCK) + block->Size;
+    return ADS1263_Rec_Block(reader, Offset) != NULL ? Offset : 0;
+}
+
+/******************************************************************************
+function:  Map a recording read-only
+parameter:
+    reader : reader state
+    Path   : file written by ADS1263_StartRecord
+Info:
+    Needs no device. Pages are read as blocks are decoded, never the whole
+    file. A file that is still being written or was cut short opens without
+    an index; its complete blocks still decode.
+    Return 0 success, -1 failed (no file, wrong magic, version or header CRC)
+******************************************************************************/
+int ADS1263_Rec_Open(ADS1263_REC_READER* reader, const char* Path)
+{
+    const ADS1263_REC_HEADER* header;
+    const ADS1263_REC_TRAILER* trailer;
+    struct stat st;
+    void* base;
+    int fd;
+
+    reader->Base = NULL;
+    fd = open(Path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ADS1263_REC_HEADER)) {
+        close(fd);
+        return -1;
+    }
+    base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    header = (const ADS1263_REC_HEADER*)base;
+    if (memcmp(header->Magic, ADS1263_REC_MAGIC, sizeof(header->Magic)) != 0 || header->Version != ADS1263_REC_VERSION
+        || header->CRC != ADS1263_CRC32(0, header, offsetof(ADS1263_REC_HEADER, CRC))
+        || header->HeaderSize < sizeof(ADS1263_REC_HEADER) || header->HeaderSize > (uint64_t)st.st_size) {
+        printf("%s is not an ADS1263 recording of version %d \r\n", Path, ADS1263_REC_VERSION);
+        munmap(base, st.st_size);
+        return -1;
+    }
+    reader->Base = (const UBYTE*)base;
+    reader->Size = st.st_size;
+    reader->Header = header;
+    reader->Index = NULL;
+    reader->IndexCount = 0;
+    reader->End = st.st_size;
+
+    if (reader->Size >= header->HeaderSize + sizeof(ADS1263_REC_TRAILER)) {
+        trailer = (const ADS1263_REC_TRAILER*)(reader->Base + reader->Size - sizeof(ADS1263_REC_TRAILER));
+        if (trailer->Magic == ADS1263_REC_INDEX_MAGIC && trailer->Offset >= header->HeaderSize
+            && trailer->Count <= (reader->Size - trailer->Offset) / sizeof(ADS1263_REC_INDEX)
+            && trailer->Offset + trailer->Count * sizeof(ADS1263_REC_INDEX) + sizeof(ADS1263_REC_TRAILER) == reader->Size
+            && trailer->CRC == ADS1263_CRC32(ADS1263_CRC32(0, reader->Base + trailer->Offset, trailer->Count * sizeof(ADS1263_REC_INDEX)),
+                trailer, offsetof(ADS1263_REC_TRAILER, CRC))) {
+            reader->Index = (const ADS1263_REC_INDEX*)(reader->Base + trailer->Offset);
+            reader->IndexCount = trailer->Count;
+            reader->End = trailer->Offset;
+        }
+    }
+    return 0;
+}
+
+void ADS1263_Rec_Close(ADS1263_REC_READER* reader)
+{
+    if (reader->Base != NULL)
+        munmap((void*)reader->Base, reader->Size);
+    reader->Base = NULL;
+}
+
+/**
+ * Offset of the first block, 0 if the recording has none
+**/
+uint64_t ADS1263_Rec_First(const ADS1263_REC_READER* reader)
+{
+    if (reader->Base == NULL) {
+        return 0;
+    }
+    return ADS1263_Rec_Block(reader, reader->Header->HeaderSize) != NULL ? reader->Header->HeaderSize : 0;
+}
+
+/******************************************************************************
+function:  Find the block holding a time
+parameter:
+    reader    : reader state
+    Timestamp : CLOCK_MONOTONIC ns, the time base of the samples
+Info:
+    Binary search of the index, then a walk over at most IndexEvery block
+    headers (all of them without an index).
+    Return offset of the first block whose last sample is not before
+    Timestamp, 0 if there is none
+******************************************************************************/
+uint64_t ADS1263_Rec_Seek(const ADS1263_REC_READER* reader, uint64_t Timestamp)
+{
+    const ADS1263_REC_BLOCK* block;
+    uint64_t offset, lo = 0, hi = reader->IndexCount;
+
+    // last entry that starts at or before Timestamp
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (reader->Index[mid].FirstTimestamp <= Timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    offset = lo > 0 ? reader->Index[lo - 1].Offset : ADS1263_Rec_First(reader);
+    while ((block = ADS1263_Rec_Block(reader, offset)) != NULL && block->LastTimestamp < Timestamp)
+        offset = ADS1263_Rec_Next(reader, offset);
+    return block != NULL ? offset : 0;
+}
+
+/******************************************************************************
+function:  Decode one block
+parameter:
+    reader : reader state
+    Offset : block, from ADS1263_Rec_First, ADS1263_Rec_Seek or Next
+    buf    : destination, room for the header's BlockSamples is always enough
+    n      : capacity of buf in samples
+    Next   : set to the offset of the following block, 0 at the end; may be NULL
+Info:
+    Values come back as the stream delivers them, raw codes with ADC2
+    samples flagged ADS1263_SAMPLE_ADC2.
+    Return number of samples, -1 if there is no block at Offset, it fails
+    its CRC, or buf is too small
+******************************************************************************/
+int ADS1263_Rec_Decode(const ADS1263_REC_READER* reader, uint64_t Offset, ADS1263_SAMPLE* buf, int n, uint64_t* Next)
+{
+    const ADS1263_REC_BLOCK* block = ADS1263_Rec_Block(reader, Offset);
+    const UBYTE *p, *end;
+    int32_t code[2][ADS1263_REC_TAG_CHANNEL + 1] = {};
+    uint64_t seq[2], ts, v;
+    UBYTE status = 0;
+    UDOUBLE i;
+
+    if (Next != NULL)
+        *Next = 0;
+    if (block == NULL || block->Count > (UDOUBLE)n) {
+        return -1;
+    }
+    if (block->CRC != ADS1263_CRC32(0, &block->Size, sizeof(ADS1263_REC_BLOCK) - offsetof(ADS1263_REC_BLOCK, Size) + block->Size)) {
+        printf("Record block at %llu: CRC error \r\n", (unsigned long long)Offset);
+        return -1;
+    }
+    p = (const UBYTE*)(block + 1);
+    end = p + block->Size;
+    seq[0] = block->FirstSequence[0] - 1;
+    seq[1] = block->FirstSequence[1] - 1;
+    ts = block->FirstTimestamp;
+
+    for (i = 0; i < block->Count; i++) {
+        ADS1263_SAMPLE* s = &buf[i];
+        UBYTE tag, a, ch;
+        if (p >= end) {
+            return -1;
+        }
+        tag = *p++;
+        a = tag & ADS1263_REC_TAG_ADC2 ? 1 : 0;
+        ch = tag & ADS1263_REC_TAG_CHANNEL;
+        if (tag & ADS1263_REC_TAG_STATUS) {
+            if (p >= end)
+                return -1;
+            status = *p++;
+        }
+        s->Flags = a ? ADS1263_SAMPLE_ADC2 : 0;
+        if (tag & ADS1263_REC_TAG_FLAGS) {
+            if (p >= end)
+                return -1;
+            s->Flags |= *p++;
+        }
+        if ((p = ADS1263_Rec_Unvarint(p, end, &v)) == NULL) {
+            return -1;
+        }
+        seq[a] += v + 1;
+        if ((p = ADS1263_Rec_Unvarint(p, end, &v)) == NULL) {
+            return -1;
+        }
+        ts += (uint64_t)ADS1263_Rec_Unzigzag(v);
+        if ((p = ADS1263_Rec_Unvarint(p, end, &v)) == NULL) {
+            return -1;
+        }
+        code[a][ch] = (int32_t)(code[a][ch] + ADS1263_Rec_Unzigzag(v));
+        s->Sequence = seq[a];
+        s->Timestamp = ts;
+        s->Value = a ? (UDOUBLE)code[a][ch] & 0xffffff : (UDOUBLE)code[a][ch];
+        s->Channel = ch;
+        s->Status = status;
+        s->Reserved = 0;
+    }
+    if (Next != NULL)
+        *Next = ADS1263_Rec_Next(reader, Offset);
+    return (int)block->Count;
+}
+
+#pragma endregion
+
+#pragma region Default
+
+/**
+ * The handle-less API: each call acts on the default instance, which uses
+ * the port set up by DEV_Module_Init
+**/
+
+UBYTE ADS1263_WriteRegisters(UBYTE Reg, const UBYTE* data, UBYTE Count)
+{
+    return ADS1263_Dev_WriteRegisters(&ADS1263_DefaultDev, Reg, data, Count);
+}
+
+UBYTE ADS1263_ReadRegisters(UBYTE Reg, UBYTE* data, UBYTE Count)
+{
+    return ADS1263_Dev_ReadRegisters(&ADS1263_DefaultDev, Reg, data, Count);
+}
+
+void ADS1263_GetRegisters(UBYTE* Regs)
+{
+    ADS1263_Dev_GetRegisters(&ADS1263_DefaultDev, Regs);
+}
+
+UBYTE ADS1263_CommitRegisters(const UBYTE* Regs)
+{
+    return ADS1263_Dev_CommitRegisters(&ADS1263_DefaultDev, Regs);
+}
+
+UBYTE ADS1263_VerifyRegisters()
+{
+    return ADS1263_Dev_VerifyRegisters(&ADS1263_DefaultDev);
+}
+
+uint64_t ADS1263_GetDRDYTimestamp()
+{
+    return ADS1263_Dev_GetDRDYTimestamp(&ADS1263_DefaultDev);
+}
+
+UBYTE ADS1263_ReadChipID()
+{
+    return ADS1263_Dev_ReadChipID(&ADS1263_DefaultDev);
+}
+
+void ADS1263_SetMode(UBYTE Mode)
+{
+    ADS1263_Dev_SetMode(&ADS1263_DefaultDev, Mode);
+}
+
+void ADS1263_ConfigADC1(ADS1263_GAIN gain, ADS1263_DRATE drate, ADS1263_DELAY delay)
+{
+    ADS1263_Dev_ConfigADC1(&ADS1263_DefaultDev, gain, drate, delay);
+}
+
+void ADS1263_ConfigADC2(ADS1263_ADC2_GAIN gain, ADS1263_ADC2_DRATE drate, ADS1263_DELAY delay)
+{
+    ADS1263_Dev_ConfigADC2(&ADS1263_DefaultDev, gain, drate, delay);
+}
+
+void ADS1263_SetInitMode(ADS1263_INIT_MODE Mode)
+{
+    ADS1263_Dev_SetInitMode(&ADS1263_DefaultDev, Mode);
+}
+
+void ADS1263_GetStartupTiming(ADS1263_STARTUP_TIMING* Timing)
+{
+    ADS1263_Dev_GetStartupTiming(&ADS1263_DefaultDev, Timing);
+}
+
+void ADS1263_SetReadMode(ADS1263_READ_MODE Mode, UBYTE Status, UBYTE Checksum)
+{
+    ADS1263_Dev_SetReadMode(&ADS1263_DefaultDev, Mode, Status, Checksum);
+}
+
+UBYTE ADS1263_init_ADC1(ADS1263_DRATE rate)
+{
+    return ADS1263_Dev_init_ADC1(&ADS1263_DefaultDev, rate);
+}
+
+UBYTE ADS1263_init_ADC2(ADS1263_ADC2_DRATE rate)
+{
+    return ADS1263_Dev_init_ADC2(&ADS1263_DefaultDev, rate);
+}
+
+UBYTE ADS1263_init_Dual(ADS1263_DRATE rate, ADS1263_ADC2_DRATE rate2)
+{
+    return ADS1263_Dev_init_Dual(&ADS1263_DefaultDev, rate, rate2);
+}
+
+UDOUBLE ADS1263_GetChannalValue(UBYTE Channel)
+{
+    return ADS1263_Dev_GetChannalValue(&ADS1263_DefaultDev, Channel);
+}
+
+UDOUBLE ADS1263_GetChannalValue_ADC2(UBYTE Channel)
+{
+    return ADS1263_Dev_GetChannalValue_ADC2(&ADS1263_DefaultDev, Channel);
+}
+
+void ADS1263_GetAll(UBYTE* List, UDOUBLE* Value, int Number)
+{
+    ADS1263_Dev_GetAll(&ADS1263_DefaultDev, List, Value, Number);
+}
+
+UBYTE ADS1263_ScanADC1(const UBYTE* List, UDOUBLE* Value, UBYTE* Flags, int Number)
+{
+    return ADS1263_Dev_ScanADC1(&ADS1263_DefaultDev, List, Value, Flags, Number);
+}
+
+void ADS1263_SetScanDelay(ADS1263_DELAY delay)
+{
+    ADS1263_Dev_SetScanDelay(&ADS1263_DefaultDev, delay);
+}
+
+void ADS1263_GetAll_ADC2(UDOUBLE* ADC_Value)
+{
+    ADS1263_Dev_GetAll_ADC2(&ADS1263_DefaultDev, ADC_Value);
+}
+
+UDOUBLE ADS1263_RTD(ADS1263_DELAY delay, ADS1263_GAIN gain, ADS1263_DRATE drate)
+{
+    return ADS1263_Dev_RTD(&ADS1263_DefaultDev, delay, gain, drate);
+}
+
+void ADS1263_DAC(ADS1263_DAC_VOLT volt, UBYTE isPositive, UBYTE isOpen)
+{
+    ADS1263_Dev_DAC(&ADS1263_DefaultDev, volt, isPositive, isOpen);
+}
+
+UBYTE ADS1263_StartStream(const ADS1263_STREAM_CONFIG* config)
+{
+    return ADS1263_Dev_StartStream(&ADS1263_DefaultDev, config);
+}
+
+void ADS1263_StopStream()
+{
+    ADS1263_Dev_StopStream(&ADS1263_DefaultDev);
+}
+
+int ADS1263_ReadSamples(ADS1263_SAMPLE* buf, int n)
+{
+    return ADS1263_Dev_ReadSamples(&ADS1263_DefaultDev, buf, n);
+}
+
+uint64_t ADS1263_GetStreamOverflows()
+{
+    return ADS1263_Dev_GetStreamOverflows(&ADS1263_DefaultDev);
+}
+
+uint64_t ADS1263_GetStreamMissed()
+{
+    return ADS1263_Dev_GetStreamMissed(&ADS1263_DefaultDev);
+}
+
+UBYTE ADS1263_StartDualStream(const ADS1263_STREAM_CONFIG* adc1, const ADS1263_STREAM_CONFIG* adc2)
+{
+    return ADS1263_Dev_StartDualStream(&ADS1263_DefaultDev, adc1, adc2);
+}
+
+int ADS1263_ReadSamples_ADC2(ADS1263_SAMPLE* buf, int n)
+{
+    return ADS1263_Dev_ReadSamples_ADC2(&ADS1263_DefaultDev, buf, n);
+}
+
+uint64_t ADS1263_GetStreamOverflows_ADC2()
+{
+    return ADS1263_Dev_GetStreamOverflows_ADC2(&ADS1263_DefaultDev);
+}
+
+UBYTE ADS1263_StartSchedule(const ADS1263_SCHEDULE_CONFIG* config)
+{
+    return ADS1263_Dev_StartSchedule(&ADS1263_DefaultDev, config);
+}
+
+void ADS1263_StopSchedule()
+{
+    ADS1263_Dev_StopSchedule(&ADS1263_DefaultDev);
+}
+
+void ADS1263_GetScheduleStats(ADS1263_SCHEDULE_STATS* stats)
+{
+    ADS1263_Dev_GetScheduleStats(&ADS1263_DefaultDev, stats);
+}
+
+void ADS1263_ResetScheduleStats()
+{
+    ADS1263_Dev_ResetScheduleStats(&ADS1263_DefaultDev);
+}
+
+void ADS1263_GetStats(ADS1263_STATS* stats)
+{
+    ADS1263_Dev_GetStats(&ADS1263_DefaultDev, stats);
+}
+
+void ADS1263_ResetStats()
+{
+    ADS1263_Dev_ResetStats(&ADS1263_DefaultDev);
+}
+
+UBYTE ADS1263_AttachBlocks(const ADS1263_BLOCK_CONFIG* config)
+{
+    return ADS1263_Dev_AttachBlocks(&ADS1263_DefaultDev, config);
+}
+
+void ADS1263_DetachBlocks()
+{
+    ADS1263_Dev_DetachBlocks(&ADS1263_DefaultDev);
+}
+
+int ADS1263_GetBlockFd()
+{
+    return ADS1263_Dev_GetBlockFd(&ADS1263_DefaultDev);
+}
+
+ADS1263_BLOCK* ADS1263_GetBlock()
+{
+    return ADS1263_Dev_GetBlock(&ADS1263_DefaultDev);
+}
+
+void ADS1263_ReleaseBlock(ADS1263_BLOCK* Block)
+{
+    ADS1263_Dev_ReleaseBlock(&ADS1263_DefaultDev, Block);
+}
+
+uint64_t ADS1263_GetBlockOverflows()
+{
+    return ADS1263_Dev_GetBlockOverflows(&ADS1263_DefaultDev);
+}
+
+UBYTE ADS1263_StartPublish(const ADS1263_SHM_CONFIG* config)
+{
+    return ADS1263_Dev_StartPublish(&ADS1263_DefaultDev, config);
+}
+
+void ADS1263_StopPublish()
+{
+    ADS1263_Dev_StopPublish(&ADS1263_DefaultDev);
+}
+
+UBYTE ADS1263_StartRecord(const ADS1263_REC_CONFIG* config)
+{
+    return ADS1263_Dev_StartRecord(&ADS1263_DefaultDev, config);
+}
+
+void ADS1263_StopRecord()
+{
+    ADS1263_Dev_StopRecord(&ADS1263_DefaultDev);
+}
+
+uint64_t ADS1263_GetRecordDrops()
+{
+    return ADS1263_Dev_GetRecordDrops(&ADS1263_DefaultDev);
+}
+
+UBYTE ADS1263_TuneProfile(const ADS1263_TUNE_CONFIG* config, ADS1263_PROFILE* profile)
+{
+    return ADS1263_Dev_TuneProfile(&ADS1263_DefaultDev, config, profile);
+}
+
+UBYTE ADS1263_ScanProfile(const ADS1263_PROFILE* profile, UDOUBLE* Value, UBYTE* Flags)
+{
+    return ADS1263_Dev_ScanProfile(&ADS1263_DefaultDev, profile, Value, Flags);
 }
 
 #pragma endregion
@@ -15,6 +15,9 @@
 #include <getopt.h> 
 #include <fcntl.h>
 #include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <linux/gpio.h>
 
 #pragma endregion
 
@@ -36,6 +39,15 @@ typedef unsigned int   uint32_t;
 #define UDOUBLE uint32_t
 #endif
 
+/**
+ * SPI chip select
+ * 0: CS is the DEV_CS_PIN GPIO, toggled around every transaction (HAT default)
+ * 1: CS is driven by the SPI controller (CE0/CE1), no GPIO writes
+**/
+#ifndef DEV_SPI_NATIVE_CS
+#define DEV_SPI_NATIVE_CS 0
+#endif
+
 /**
  * GPIOI config
 **/
@@ -43,17 +55,94 @@ extern int DEV_RST_PIN;
 extern int DEV_CS_PIN;
 extern int DEV_DRDY_PIN;
 
+/**
+ * SPI bus arbiter (see DEV_Bus_Create). A port routed through one hands every
+ * transaction to the arbiter's thread instead of touching the bus itself.
+**/
+#ifndef DEV_BUS_MAX_BATCH_BYTES
+#define DEV_BUS_MAX_BATCH_BYTES 4096    // spidev default bufsiz
+#endif
+
+typedef struct DEV_BUS DEV_BUS;
+struct DEV_PORT;
+
+/**
+ * Simulated chip behind a DEV_BACKEND_SIM port, see the SIM region
+**/
+typedef struct SIM_ADS1263 SIM_ADS1263;
+
+/**
+ * Hardware backend of a port. Each one is a pair of policy types in the cpp
+ * (SPI + GPIO) that the transaction path is instantiated for.
+ * DEV_BACKEND_DEFAULT is picked by the build flags:
+ *   SIM               -> DEV_BACKEND_SIM
+ *   USE_BCM2835_LIB   -> DEV_BACKEND_BCM2835
+ *   USE_WIRINGPI_LIB  -> DEV_BACKEND_WIRINGPI
+ *   USE_GPIOCHIP      -> DEV_BACKEND_SPIDEV_CHARDEV
+ *   USE_GPIOMEM       -> DEV_BACKEND_SPIDEV_GPIOMEM
+ *   none of them      -> DEV_BACKEND_SPIDEV_SYSFS
+ * spidev, sysfs, the GPIO character device, gpiomem and the simulator are
+ * always built in; bcm2835 and wiringPi only with their flags.
+**/
+typedef enum {
+    DEV_BACKEND_DEFAULT = 0,
+    DEV_BACKEND_SPIDEV_SYSFS,       // /dev/spidevX.Y, /sys/class/gpio
+    DEV_BACKEND_SPIDEV_CHARDEV,     // /dev/spidevX.Y, /dev/gpiochipN
+    DEV_BACKEND_SIM,                // in-process ADS1263
+    DEV_BACKEND_BCM2835,            // bcm2835 library
+    DEV_BACKEND_WIRINGPI,           // wiringPi library
+    DEV_BACKEND_SPIDEV_GPIOMEM,     // /dev/spidevX.Y, /dev/gpiomem registers
+}DEV_BACKEND;
+
+/**
+ * One queued transaction: the complete frame and its response buffer
+**/
+typedef struct DEV_SPI_REQUEST
+{
+    const UBYTE* TxBuf;     // bytes to send, NULL sends zeros
+    UBYTE* RxBuf;           // response, same length, NULL discards it
+    UDOUBLE Len;            // frame length
+    void (*Callback)(struct DEV_SPI_REQUEST* Request);  // on the arbiter thread, may be NULL
+    void* Arg;              // for the callback
+    int Result;             // 0 success, -1 failed
+    volatile int Done;      // set once Result is valid
+
+    // filled in by the arbiter
+    struct DEV_PORT* Port;
+    DEV_BUS* Bus;
+    struct DEV_SPI_REQUEST* Next;
+}DEV_SPI_REQUEST;
+
 /*------------------------------------------------------------------------------------------------------*/
 [[gnu::dllexport]] extern "C" void DEV_Digital_Write(UWORD Pin, UBYTE Value);
 [[gnu::dllexport]] extern "C" UBYTE DEV_Digital_Read(UWORD Pin);
 
 [[gnu::dllexport]] extern "C" UBYTE DEV_SPI_WriteByte(UBYTE Value);
 [[gnu::dllexport]] extern "C" UBYTE DEV_SPI_ReadByte();
+[[gnu::dllexport]] extern "C" int DEV_SPI_Transfer(const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len);
+[[gnu::dllexport]] extern "C" int DEV_SPI_Transaction(const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len);
+[[gnu::dllexport]] extern "C" void DEV_SPI_SetNativeCS(UBYTE Enable);
+[[gnu::dllexport]] extern "C" void DEV_SPI_SetBus(DEV_BUS* Bus);
+[[gnu::dllexport]] extern "C" int DEV_SPI_Submit(DEV_SPI_REQUEST* Request);
+
+[[gnu::dllexport]] extern "C" DEV_BUS* DEV_Bus_Create(int Priority);
+[[gnu::dllexport]] extern "C" void DEV_Bus_Destroy(DEV_BUS* Bus);
+[[gnu::dllexport]] extern "C" int DEV_Bus_Submit(DEV_BUS* Bus, DEV_SPI_REQUEST* Request);
+[[gnu::dllexport]] extern "C" int DEV_Bus_Wait(DEV_SPI_REQUEST* Request);
+[[gnu::dllexport]] extern "C" int DEV_Bus_OnOwnerThread(DEV_BUS* Bus);
 
+[[gnu::dllexport]] extern "C" UBYTE DEV_SetBackend(DEV_BACKEND Backend);
+[[gnu::dllexport]] extern "C" UBYTE DEV_Backend_Available(DEV_BACKEND Backend);
 [[gnu::dllexport]] extern "C" UBYTE DEV_Module_Init();
 [[gnu::dllexport]] extern "C" void DEV_Module_Exit();
 
 [[gnu::dllexport]] extern "C" void DEV_Delay_ms(UDOUBLE xms);
+[[gnu::dllexport]] extern "C" void DEV_Delay_us(UDOUBLE xus);
+[[gnu::dllexport]] extern "C" void DEV_Delay_Until(uint64_t DeadlineNs);
+
+[[gnu::dllexport]] extern "C" uint64_t DEV_Time_ns();
+[[gnu::dllexport]] extern "C" uint64_t DEV_GetSyscalls();
+[[gnu::dllexport]] extern "C" int DEV_Digital_WaitLow(UWORD Pin, UDOUBLE TimeoutMs, uint64_t* TimestampNs);
 
 
 
@@ -88,6 +177,13 @@ extern int DEV_DRDY_PIN;
 #define DIR_MAXSIZ  60
 #endif
 
+/**
+ * Pins below this number keep their value file open between accesses
+**/
+#ifndef SYSFS_GPIO_MAX_PIN
+#define SYSFS_GPIO_MAX_PIN  512
+#endif
+
 #define SYSFS_GPIO_DEBUG 0
 #if SYSFS_GPIO_DEBUG 
 #define SYSFS_GPIO_Debug(__info,...) printf("Debug: " __info,##__VA_ARGS__)
@@ -124,6 +220,121 @@ extern int DEV_DRDY_PIN;
 [[gnu::dllexport]] extern "C" int SYSFS_GPIO_Direction(int Pin, int Dir);
 [[gnu::dllexport]] extern "C" int SYSFS_GPIO_Read(int Pin);
 [[gnu::dllexport]] extern "C" int SYSFS_GPIO_Write(int Pin, int value);
+[[gnu::dllexport]] extern "C" int SYSFS_GPIO_Open(int Pin, int Dir);
+[[gnu::dllexport]] extern "C" void SYSFS_GPIO_Close(int Pin);
+
+#pragma endregion
+
+#pragma region GPIOCHIP
+
+/**
+ * GPIO character device (/dev/gpiochipN, uAPI v2)
+ * DEV_BACKEND_SPIDEV_CHARDEV uses it in place of sysfs, USE_GPIOCHIP makes that the default.
+ * Line numbers are chip offsets, which are the BCM numbers on gpiochip0 of a Pi.
+ * ADS1263_GPIOCHIP in the environment overrides GPIOCHIP_DEVICE, e.g. to point
+ * the driver at a gpio-sim chip.
+**/
+#ifndef GPIOCHIP_DEVICE
+#define GPIOCHIP_DEVICE "/dev/gpiochip0"
+#endif
+#ifndef GPIOCHIP_CONSUMER
+#define GPIOCHIP_CONSUMER "ADS1263"
+#endif
+
+#define GPIOCHIP_DEBUG 0
+#if GPIOCHIP_DEBUG
+#define GPIOCHIP_Debug(__info,...) printf("Debug: " __info,##__VA_ARGS__)
+#else
+#define GPIOCHIP_Debug(__info,...)
+#endif
+
+/**
+ * Line requests of one ADS1263: RST and CS as one output set, DRDY as a falling-edge input
+**/
+typedef struct
+{
+    int out_fd;
+    int drdy_fd;
+    int rst;
+    int cs;
+    int drdy;
+}GPIOCHIP_LINES;
+
+[[gnu::dllexport]] extern "C" int GPIOCHIP_Lines_Open(GPIOCHIP_LINES* lines, const char* Chip, int RstPin, int CsPin, int DrdyPin);
+[[gnu::dllexport]] extern "C" void GPIOCHIP_Lines_Close(GPIOCHIP_LINES* lines);
+[[gnu::dllexport]] extern "C" int GPIOCHIP_Lines_Write(GPIOCHIP_LINES* lines, int Pin, int Value);
+[[gnu::dllexport]] extern "C" int GPIOCHIP_Lines_Read(GPIOCHIP_LINES* lines, int Pin);
+[[gnu::dllexport]] extern "C" int GPIOCHIP_Lines_WaitFalling(GPIOCHIP_LINES* lines, int TimeoutMs, uint64_t* TimestampNs);
+[[gnu::dllexport]] extern "C" void GPIOCHIP_Lines_Flush(GPIOCHIP_LINES* lines);
+[[gnu::dllexport]] extern "C" int GPIOCHIP_Lines_Latest(GPIOCHIP_LINES* lines, uint64_t* TimestampNs);
+[[gnu::dllexport]] extern "C" int GPIOCHIP_Lines_WaitLow(GPIOCHIP_LINES* lines, int Pin, uint64_t DeadlineNs, uint64_t* TimestampNs);
+
+[[gnu::dllexport]] extern "C" int GPIOCHIP_Open(const char* Chip, int RstPin, int CsPin, int DrdyPin);
+[[gnu::dllexport]] extern "C" void GPIOCHIP_Close();
+[[gnu::dllexport]] extern "C" int GPIOCHIP_Write(int Pin, int Value);
+[[gnu::dllexport]] extern "C" int GPIOCHIP_Read(int Pin);
+[[gnu::dllexport]] extern "C" int GPIOCHIP_WaitFalling(int TimeoutMs, uint64_t* TimestampNs);
+[[gnu::dllexport]] extern "C" void GPIOCHIP_Flush();
+[[gnu::dllexport]] extern "C" int GPIOCHIP_WaitLow(int Pin, uint64_t DeadlineNs, uint64_t* TimestampNs);
+[[gnu::dllexport]] extern "C" int GPIOCHIP_AttachEventFd(int Fd);
+
+#pragma endregion
+
+#pragma region GPIOMEM
+
+/**
+ * GPIO registers mapped from /dev/gpiomem: a CS edge is one store to the
+ * set or clear register, a DRDY check one load of the level register.
+ * DEV_BACKEND_SPIDEV_GPIOMEM uses it, USE_GPIOMEM makes that the default.
+ * The register layout is taken from /proc/device-tree/compatible; SoCs
+ * without a known layout (BCM2712/RP1 on the Pi 5) fail the open and the
+ * port falls back to sysfs.
+ * ADS1263_GPIOMEM in the environment overrides GPIOMEM_DEVICE. An ordinary
+ * file there is mapped as a register image (test mode): writes land in
+ * the file, so the register logic can be checked off-target.
+**/
+#ifndef GPIOMEM_DEVICE
+#define GPIOMEM_DEVICE "/dev/gpiomem"
+#endif
+#define GPIOMEM_BLOCK_SIZE  4096
+
+#define GPIOMEM_DEBUG 0
+#if GPIOMEM_DEBUG
+#define GPIOMEM_Debug(__info,...) printf("Debug: " __info,##__VA_ARGS__)
+#else
+#define GPIOMEM_Debug(__info,...)
+#endif
+
+typedef enum {
+    GPIOMEM_LAYOUT_AUTO = 0,    // from the device tree; BCM2835 for a register image
+    GPIOMEM_LAYOUT_BCM2835,     // BCM2835/6/7, BCM2711
+    GPIOMEM_LAYOUT_UNKNOWN,
+}GPIOMEM_LAYOUT;
+
+/* BCM2835 GPIO block, byte offsets; bank 1 registers follow bank 0 */
+#define GPIOMEM_GPFSEL0     0x00
+#define GPIOMEM_GPSET0      0x1C
+#define GPIOMEM_GPCLR0      0x28
+#define GPIOMEM_GPLEV0      0x34
+#define GPIOMEM_MAX_PIN     54
+
+/**
+ * One mapping of the GPIO block
+**/
+typedef struct
+{
+    volatile uint32_t* base;    // NULL: not mapped
+    int fd;
+    GPIOMEM_LAYOUT layout;
+    UBYTE image;                // an ordinary file, not the device
+}GPIOMEM_MAP;
+
+[[gnu::dllexport]] extern "C" GPIOMEM_LAYOUT GPIOMEM_Detect();
+[[gnu::dllexport]] extern "C" int GPIOMEM_Map_Open(GPIOMEM_MAP* map, const char* Path, GPIOMEM_LAYOUT Layout);
+[[gnu::dllexport]] extern "C" void GPIOMEM_Map_Close(GPIOMEM_MAP* map);
+[[gnu::dllexport]] extern "C" int GPIOMEM_Map_Mode(GPIOMEM_MAP* map, int Pin, int Output);
+[[gnu::dllexport]] extern "C" int GPIOMEM_Map_Write(GPIOMEM_MAP* map, int Pin, int Value);
+[[gnu::dllexport]] extern "C" int GPIOMEM_Map_Read(GPIOMEM_MAP* map, int Pin);
 
 #pragma endregion
 
@@ -193,6 +404,8 @@ typedef struct SPIStruct {
     int fd; //
 } HARDWARE_SPI;
 
+extern HARDWARE_SPI hardware_SPI;
+
 
 [[gnu::dllexport]] extern "C" void DEV_HARDWARE_SPI_begin(char* SPI_device);
 [[gnu::dllexport]] extern "C" void DEV_HARDWARE_SPI_beginSet(char* SPI_device, SPIMode mode, uint32_t speed);
@@ -202,6 +415,13 @@ typedef struct SPIStruct {
 
 [[gnu::dllexport]] extern "C" uint8_t DEV_HARDWARE_SPI_TransferByte(uint8_t buf);
 [[gnu::dllexport]] extern "C" int DEV_HARDWARE_SPI_Transfer(uint8_t* buf, uint32_t len);
+[[gnu::dllexport]] extern "C" int DEV_HARDWARE_SPI_TransferFullDuplex(const uint8_t* txbuf, uint8_t* rxbuf, uint32_t len);
+
+[[gnu::dllexport]] extern "C" int DEV_HARDWARE_SPI_Open(HARDWARE_SPI* spi, const char* SPI_device, SPIMode mode, uint32_t speed);
+[[gnu::dllexport]] extern "C" void DEV_HARDWARE_SPI_Close(HARDWARE_SPI* spi);
+#define DEV_HARDWARE_SPI_MAX_BATCH 16
+[[gnu::dllexport]] extern "C" int DEV_HARDWARE_SPI_TransferBatch(const HARDWARE_SPI* spi, const uint8_t* const* tx, uint8_t* const* rx, const uint32_t* len, uint32_t n);
+[[gnu::dllexport]] extern "C" int DEV_HARDWARE_SPI_TransferOn(const HARDWARE_SPI* spi, const uint8_t* txbuf, uint8_t* rxbuf, uint32_t len);
 
 [[gnu::dllexport]] extern "C" void DEV_HARDWARE_SPI_SetDataInterval(uint16_t us);
 [[gnu::dllexport]] extern "C" int DEV_HARDWARE_SPI_SetBusMode(BusMode mode);
@@ -220,6 +440,49 @@ typedef struct SPIStruct {
 #define Open    1 
 #define Close   0
 
+/* DRDY wait limit, longer than the slowest first conversion (2.5 SPS, sinc4) */
+#ifndef ADS1263_DRDY_TIMEOUT_MS
+#define ADS1263_DRDY_TIMEOUT_MS 2000
+#endif
+
+/* DRDY prediction: wake this long before the expected edge, give up this long after it */
+#ifndef ADS1263_DRDY_GUARD_NS
+#define ADS1263_DRDY_GUARD_NS   100000
+#endif
+#ifndef ADS1263_DRDY_SLACK_NS
+#define ADS1263_DRDY_SLACK_NS   10000000
+#endif
+/* RDATA status polling after DRDY */
+#ifndef ADS1263_STATUS_TIMEOUT_NS
+#define ADS1263_STATUS_TIMEOUT_NS 2000000
+#endif
+
+/* SPI frame lengths, command byte included */
+#define ADS1263_REG_FRAME_LEN   3   // WREG/RREG: opcode, count, data
+#define ADS1263_DATA_FRAME_LEN  7   // RDATA: opcode, status, 4 data bytes, CRC
+#define ADS1263_REG_COUNT       27  // REG_ID..REG_ADC2FSC1
+#define ADS1263_MAX_FRAME_LEN   (2 * ADS1263_REG_COUNT + 2)
+
+/* reset: RST low for at least 4 tCLK, then 2^16 tCLK (8.9 ms at 7.3728 MHz) before SPI */
+#ifndef ADS1263_RESET_PULSE_US
+#define ADS1263_RESET_PULSE_US  10
+#endif
+#ifndef ADS1263_RESET_WAIT_US
+#define ADS1263_RESET_WAIT_US   9000
+#endif
+
+/* register commit: unchanged gaps up to this long are rewritten instead of starting a new WREG */
+#ifndef ADS1263_WREG_GAP
+#define ADS1263_WREG_GAP        2
+#endif
+/* ADS1263_CommitRegisters: the transfer failed */
+#define ADS1263_COMMIT_FAILED   0xff
+
+/* ADC2 is sinc3 and has no DRDY pin: a restart is taken as settled after this many periods */
+#ifndef ADS1263_ADC2_SETTLE_PERIODS
+#define ADS1263_ADC2_SETTLE_PERIODS 3
+#endif
+
 /* gain channel*/
 typedef enum
 {
@@ -252,6 +515,16 @@ typedef enum
     ADS1263_38400SPS,
 }ADS1263_DRATE;
 
+/* ADC1 digital filter, MODE1[7:5] */
+typedef enum
+{
+    ADS1263_SINC1 = 0,
+    ADS1263_SINC2,
+    ADS1263_SINC3,
+    ADS1263_SINC4,
+    ADS1263_FIR,
+}ADS1263_FILTER;
+
 typedef enum
 {
     ADS1263_DELAY_0s = 0,
@@ -364,14 +637,107 @@ typedef enum
     CMD_WREG2 = 0x00, // number of registers to write minus 1, 000n nnnn
 }ADS1263_CMD;
 
+typedef enum
+{
+    ADS1263_INIT_COLD = 0,  // always reset
+    ADS1263_INIT_WARM,      // reset only if the chip does not hold the configuration
+}ADS1263_INIT_MODE;
+
+typedef enum
+{
+    ADS1263_READ_RDATA = 0, // RDATA1 command, status polled until new data
+    ADS1263_READ_DIRECT,    // frame clocked out on NOPs after DRDY, no command
+}ADS1263_READ_MODE;
+
+typedef struct
+{
+    uint64_t Module;    // DEV_Module_Init
+    uint64_t Probe;     // warm: register map readback and compare
+    uint64_t Reset;
+    uint64_t ChipID;
+    uint64_t Config;
+    uint64_t Total;     // ADS1263_init_ADC1/ADC2, Module not included
+    UBYTE Warm;         // 1 if the reset was skipped
+}ADS1263_STARTUP_TIMING;
+
+[[gnu::dllexport]] extern "C" void ADS1263_SetInitMode(ADS1263_INIT_MODE Mode);
+[[gnu::dllexport]] extern "C" void ADS1263_GetStartupTiming(ADS1263_STARTUP_TIMING* Timing);
+[[gnu::dllexport]] extern "C" void ADS1263_SetReadMode(ADS1263_READ_MODE Mode, UBYTE Status, UBYTE Checksum);
 [[gnu::dllexport]] extern "C" UBYTE ADS1263_init_ADC1(ADS1263_DRATE rate);
 [[gnu::dllexport]] extern "C" UBYTE ADS1263_init_ADC2(ADS1263_ADC2_DRATE rate);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_init_Dual(ADS1263_DRATE rate, ADS1263_ADC2_DRATE rate2);
 [[gnu::dllexport]] extern "C" void ADS1263_SetMode(UBYTE Mode);
 [[gnu::dllexport]] extern "C" UDOUBLE ADS1263_GetChannalValue(UBYTE Channel);
 [[gnu::dllexport]] extern "C" void ADS1263_GetAll(UBYTE* List, UDOUBLE* Value, int Number);
 [[gnu::dllexport]] extern "C" void ADS1263_GetAll_ADC2(UDOUBLE* ADC_Value);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_ScanADC1(const UBYTE* List, UDOUBLE* Value, UBYTE* Flags, int Number);
+[[gnu::dllexport]] extern "C" void ADS1263_SetScanDelay(ADS1263_DELAY delay);
 [[gnu::dllexport]] extern "C" UDOUBLE ADS1263_RTD(ADS1263_DELAY delay, ADS1263_GAIN gain, ADS1263_DRATE drate);
 [[gnu::dllexport]] extern "C" void ADS1263_DAC(ADS1263_DAC_VOLT volt, UBYTE isPositive, UBYTE isClose);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_GetDRDYTimestamp();
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_WriteRegisters(UBYTE Reg, const UBYTE* data, UBYTE Count);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_ReadRegisters(UBYTE Reg, UBYTE* data, UBYTE Count);
+[[gnu::dllexport]] extern "C" void ADS1263_GetRegisters(UBYTE* Regs);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_CommitRegisters(const UBYTE* Regs);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_VerifyRegisters();
+[[gnu::dllexport]] extern "C" UDOUBLE ADS1263_ConversionTime(ADS1263_DRATE drate, ADS1263_FILTER filter, ADS1263_DELAY delay, UBYTE first);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_ReadChipID();
+[[gnu::dllexport]] extern "C" void ADS1263_ConfigADC1(ADS1263_GAIN gain, ADS1263_DRATE drate, ADS1263_DELAY delay);
+[[gnu::dllexport]] extern "C" void ADS1263_ConfigADC2(ADS1263_ADC2_GAIN gain, ADS1263_ADC2_DRATE drate, ADS1263_DELAY delay);
+[[gnu::dllexport]] extern "C" UDOUBLE ADS1263_GetChannalValue_ADC2(UBYTE Channel);
+
+/**
+ * Handles: one per ADS1263, each with its own spidev fd, pins and driver state.
+ * ADS1263_Dev_X(dev, ...) is ADS1263_X(...) on that device; ADS1263_X acts on
+ * ADS1263_GetDefault(), the device on the DEV_Module_Init port.
+**/
+typedef struct ads1263_s ads1263_t;
+
+typedef struct
+{
+    const char* SpiDevice;  // e.g. "/dev/spidev1.0", NULL: /dev/spidev0.0
+    uint32_t Speed;         // SPI clock in Hz, 0: 1 MHz
+    int RstPin;
+    int CsPin;
+    int DrdyPin;
+    UBYTE NativeCS;         // see DEV_SPI_NATIVE_CS
+    const char* GpioChip;   // DEV_BACKEND_SPIDEV_CHARDEV, NULL: ADS1263_GPIOCHIP or GPIOCHIP_DEVICE
+    DEV_BUS* Bus;           // SPI bus arbiter, NULL: transfers on the calling thread
+    SIM_ADS1263* Sim;       // DEV_BACKEND_SIM: chip behind the port, NULL: a new one owned by the port
+    DEV_BACKEND Backend;    // DEV_BACKEND_DEFAULT: the one DEV_SetBackend chose
+    const char* GpioMem;    // DEV_BACKEND_SPIDEV_GPIOMEM, NULL: ADS1263_GPIOMEM or GPIOMEM_DEVICE
+}ADS1263_PORT_CONFIG;
+
+[[gnu::dllexport]] extern "C" ads1263_t* ADS1263_Open(const ADS1263_PORT_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_Close(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" ads1263_t* ADS1263_GetDefault();
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_SetBus(ads1263_t* dev, DEV_BUS* Bus);
+[[gnu::dllexport]] extern "C" int ADS1263_Dev_Submit(ads1263_t* dev, DEV_SPI_REQUEST* Request);
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_WriteRegisters(ads1263_t* dev, UBYTE Reg, const UBYTE* data, UBYTE Count);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_ReadRegisters(ads1263_t* dev, UBYTE Reg, UBYTE* data, UBYTE Count);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_GetRegisters(ads1263_t* dev, UBYTE* Regs);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_CommitRegisters(ads1263_t* dev, const UBYTE* Regs);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_VerifyRegisters(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_Dev_GetDRDYTimestamp(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_ReadChipID(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_SetMode(ads1263_t* dev, UBYTE Mode);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_ConfigADC1(ads1263_t* dev, ADS1263_GAIN gain, ADS1263_DRATE drate, ADS1263_DELAY delay);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_ConfigADC2(ads1263_t* dev, ADS1263_ADC2_GAIN gain, ADS1263_ADC2_DRATE drate, ADS1263_DELAY delay);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_SetInitMode(ads1263_t* dev, ADS1263_INIT_MODE Mode);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_GetStartupTiming(ads1263_t* dev, ADS1263_STARTUP_TIMING* Timing);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_SetReadMode(ads1263_t* dev, ADS1263_READ_MODE Mode, UBYTE Status, UBYTE Checksum);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_init_ADC1(ads1263_t* dev, ADS1263_DRATE rate);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_init_ADC2(ads1263_t* dev, ADS1263_ADC2_DRATE rate);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_init_Dual(ads1263_t* dev, ADS1263_DRATE rate, ADS1263_ADC2_DRATE rate2);
+[[gnu::dllexport]] extern "C" UDOUBLE ADS1263_Dev_GetChannalValue(ads1263_t* dev, UBYTE Channel);
+[[gnu::dllexport]] extern "C" UDOUBLE ADS1263_Dev_GetChannalValue_ADC2(ads1263_t* dev, UBYTE Channel);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_GetAll(ads1263_t* dev, UBYTE* List, UDOUBLE* Value, int Number);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_ScanADC1(ads1263_t* dev, const UBYTE* List, UDOUBLE* Value, UBYTE* Flags, int Number);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_SetScanDelay(ads1263_t* dev, ADS1263_DELAY delay);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_GetAll_ADC2(ads1263_t* dev, UDOUBLE* ADC_Value);
+[[gnu::dllexport]] extern "C" UDOUBLE ADS1263_Dev_RTD(ads1263_t* dev, ADS1263_DELAY delay, ADS1263_GAIN gain, ADS1263_DRATE drate);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_DAC(ads1263_t* dev, ADS1263_DAC_VOLT volt, UBYTE isPositive, UBYTE isOpen);
 
 //__declspec(dllexport) KOKKOS_FUNCTION uint64 View_##TYPE_NAME##_##EXECUTION_SPACE##_8D::GetStride(uint32 dim) const
 //{
@@ -379,3 +745,654 @@ typedef enum
 //}
 
 #pragma endregion
+
+#pragma region Stream
+
+#ifndef ADS1263_CACHE_LINE
+#define ADS1263_CACHE_LINE 64
+#endif
+#define ADS1263_STREAM_MAX_CHANNELS 16
+
+/* dual stream: an ADC2 read is only started if this much time is left before the next ADC1 DRDY */
+#ifndef ADS1263_ADC2_SLOT_NS
+#define ADS1263_ADC2_SLOT_NS    150000
+#endif
+
+/* ADS1263_SAMPLE.Flags */
+#define ADS1263_SAMPLE_CRC_ERROR    0x01    // checksum mismatch
+#define ADS1263_SAMPLE_TIMEOUT      0x02    // DRDY did not fall in time
+#define ADS1263_SAMPLE_STALE        0x04    // status never flagged new data
+#define ADS1263_SAMPLE_ADC2         0x08    // from ADC2 of a dual stream, in block samples and decoded recordings
+
+/**
+ * One ADC1 or ADC2 conversion
+**/
+typedef struct
+{
+    uint64_t Sequence;      // conversion count since the stream started, gaps are overflows or missed conversions
+    uint64_t Timestamp;     // DRDY edge (ADC2: time of the read), CLOCK_MONOTONIC ns
+    UDOUBLE Value;          // raw code
+    UBYTE Channel;
+    UBYTE Status;           // ADS1263 status byte
+    UBYTE Flags;            // ADS1263_SAMPLE_*
+    UBYTE Reserved;
+}ADS1263_SAMPLE;
+
+typedef struct
+{
+    UBYTE Channels[ADS1263_STREAM_MAX_CHANNELS];  // scanned in order, per ADS1263_SetMode
+    int Number;             // channels in use
+    UDOUBLE Capacity;       // ring size in samples, rounded up to a power of two
+    int Priority;           // SCHED_FIFO priority of the acquisition thread, 0 keeps the default
+}ADS1263_STREAM_CONFIG;
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_StartStream(const ADS1263_STREAM_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_StopStream();
+[[gnu::dllexport]] extern "C" int ADS1263_ReadSamples(ADS1263_SAMPLE* buf, int n);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_GetStreamOverflows();
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_GetStreamMissed();
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_StartDualStream(const ADS1263_STREAM_CONFIG* adc1, const ADS1263_STREAM_CONFIG* adc2);
+[[gnu::dllexport]] extern "C" int ADS1263_ReadSamples_ADC2(ADS1263_SAMPLE* buf, int n);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_GetStreamOverflows_ADC2();
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_StartStream(ads1263_t* dev, const ADS1263_STREAM_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_StopStream(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" int ADS1263_Dev_ReadSamples(ads1263_t* dev, ADS1263_SAMPLE* buf, int n);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_Dev_GetStreamOverflows(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_Dev_GetStreamMissed(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_StartDualStream(ads1263_t* dev, const ADS1263_STREAM_CONFIG* adc1, const ADS1263_STREAM_CONFIG* adc2);
+[[gnu::dllexport]] extern "C" int ADS1263_Dev_ReadSamples_ADC2(ads1263_t* dev, ADS1263_SAMPLE* buf, int n);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_Dev_GetStreamOverflows_ADC2(ads1263_t* dev);
+
+#pragma endregion
+
+#pragma region Profile
+
+/**
+ * Scan profile: every channel of an ADC1 scan converts at its own data rate
+ * and filter. ADS1263_TuneProfile measures each channel's noise on the
+ * candidates and keeps the fastest one meeting the target, so a quiet
+ * channel is not slowed to the rate the noisiest one needs.
+ *
+ * Fastest means the shortest first conversion after a mux switch
+ * (ADS1263_ConversionTime with first = 1), which is what a channel costs
+ * in a scan. Noise is the standard deviation of the codes over the
+ * measurement; the effective resolution is 32 - log2(NoiseRms).
+**/
+#define ADS1263_PROFILE_MAGIC   0x464f5250  // "PROF"
+#define ADS1263_PROFILE_VERSION 1
+
+typedef struct
+{
+    UBYTE Channel;          // per ADS1263_SetMode
+    UBYTE Drate;            // ADS1263_DRATE
+    UBYTE Filter;           // ADS1263_FILTER
+    UBYTE Met;              // 1 target met, 0 none did and the quietest candidate was kept
+    UDOUBLE ConvUs;         // time the channel takes in a scan
+    double NoiseRms;        // codes
+    double Enob;
+}ADS1263_PROFILE_CHANNEL;
+
+/**
+ * Plain data, so it can be kept and reused: ADS1263_SaveProfile writes it
+ * with a CRC, ADS1263_LoadProfile checks it
+**/
+typedef struct
+{
+    uint32_t Magic;         // ADS1263_PROFILE_MAGIC
+    uint32_t Version;       // ADS1263_PROFILE_VERSION
+    int Number;             // channels in use
+    UBYTE Mode;             // ADS1263_SetMode the channels are numbered in
+    UBYTE Delay;            // MODE0 delay when tuned, included in ConvUs
+    UBYTE Reserved[2];
+    ADS1263_PROFILE_CHANNEL Channels[ADS1263_STREAM_MAX_CHANNELS];  // scanned in order
+    uint32_t CRC;           // CRC-32 of the bytes before it, set on save
+}ADS1263_PROFILE;
+
+typedef struct
+{
+    UBYTE Channels[ADS1263_STREAM_MAX_CHANNELS];  // per ADS1263_SetMode
+    int Number;             // channels in use
+    const ADS1263_DRATE* Drates;    // candidates, NULL tries all 16
+    int DrateCount;
+    const ADS1263_FILTER* Filters;  // candidates, NULL tries all; FIR only at 20 SPS and below
+    int FilterCount;
+    double NoiseRms;        // target in codes, 0 derives it from Enob
+    double Enob;            // target effective resolution in bits, used when NoiseRms is 0
+    int Samples;            // conversions per measurement, at least 2
+}ADS1263_TUNE_CONFIG;
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_TuneProfile(const ADS1263_TUNE_CONFIG* config, ADS1263_PROFILE* profile);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_ScanProfile(const ADS1263_PROFILE* profile, UDOUBLE* Value, UBYTE* Flags);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_SaveProfile(const ADS1263_PROFILE* profile, const char* Path);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_LoadProfile(ADS1263_PROFILE* profile, const char* Path);
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_TuneProfile(ads1263_t* dev, const ADS1263_TUNE_CONFIG* config, ADS1263_PROFILE* profile);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_ScanProfile(ads1263_t* dev, const ADS1263_PROFILE* profile, UDOUBLE* Value, UBYTE* Flags);
+
+#pragma endregion
+
+#pragma region Schedule
+
+#define ADS1263_JITTER_BINS 16
+
+/**
+ * Wake-up lateness of a periodic loop, times in ns
+**/
+typedef struct
+{
+    uint64_t Periods;       // deadlines serviced
+    uint64_t Missed;        // deadlines skipped because a whole period had passed
+    uint64_t LateMax;
+    uint64_t LateSum;       // LateSum / Periods is the mean lateness
+    uint64_t ScanMax;       // scheduler thread: deadline to scan complete
+    uint64_t Histogram[ADS1263_JITTER_BINS];  // bin 0: <1 us, bin k: [2^(k-1), 2^k) us
+}ADS1263_SCHEDULE_STATS;
+
+/**
+ * Fixed-rate clock on absolute CLOCK_MONOTONIC deadlines
+**/
+typedef struct
+{
+    uint64_t Period;
+    uint64_t Deadline;      // next deadline
+    uint64_t Current;       // deadline last serviced
+}ADS1263_PERIODIC;
+
+typedef void (*ADS1263_SCAN_CALLBACK)(const UDOUBLE* Value, const UBYTE* Flags, int Number, uint64_t Deadline, void* Arg);
+
+typedef struct
+{
+    UBYTE Channels[ADS1263_STREAM_MAX_CHANNELS];  // scanned in order, per ADS1263_SetMode
+    int Number;             // channels in use
+    UDOUBLE PeriodUs;       // scan cadence
+    int Priority;           // SCHED_FIFO priority of the scheduler thread, 0 keeps the default
+    ADS1263_SCAN_CALLBACK Callback;   // called on the scheduler thread after each scan
+    void* Arg;
+    const ADS1263_PROFILE* Profile;   // scan this instead of Channels, NULL: the current rate for all
+}ADS1263_SCHEDULE_CONFIG;
+
+[[gnu::dllexport]] extern "C" void ADS1263_Periodic_Init(ADS1263_PERIODIC* clock, uint64_t PeriodNs);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_Periodic_Wait(ADS1263_PERIODIC* clock, ADS1263_SCHEDULE_STATS* stats);
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_StartSchedule(const ADS1263_SCHEDULE_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_StopSchedule();
+[[gnu::dllexport]] extern "C" void ADS1263_GetScheduleStats(ADS1263_SCHEDULE_STATS* stats);
+[[gnu::dllexport]] extern "C" void ADS1263_ResetScheduleStats();
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_StartSchedule(ads1263_t* dev, const ADS1263_SCHEDULE_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_StopSchedule(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_GetScheduleStats(ads1263_t* dev, ADS1263_SCHEDULE_STATS* stats);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_ResetScheduleStats(ads1263_t* dev);
+
+#pragma endregion
+
+#pragma region Stats
+
+#define ADS1263_STATS_BINS 24
+
+/**
+ * Driver counters of one device since it was opened or last reset.
+ * Histograms: bin 0 under 1 us, bin k [2^(k-1), 2^k) us, last bin open-ended
+**/
+typedef struct
+{
+    uint64_t Transactions;      // CS-framed transfers issued by the driver
+    uint64_t Bytes;
+    uint64_t TransferErrors;    // transfers that failed (spidev ioctl, arbiter)
+    uint64_t ChecksumErrors;
+    uint64_t DRDYWaits;
+    uint64_t DRDYTimeouts;
+    uint64_t StatusRetries;     // data frames re-read because the status byte showed no new data
+    uint64_t Overflows;         // samples dropped by full stream rings or for want of a free block, ADC1 and ADC2
+    uint64_t Missed;            // single-channel ADC1 conversions the stream did not read in time
+    uint64_t DRDYWait[ADS1263_STATS_BINS];      // call to DRDY low, predicted sleep included
+    uint64_t Transaction[ADS1263_STATS_BINS];   // one transfer, arbiter queueing included
+}ADS1263_STATS;
+
+[[gnu::dllexport]] extern "C" void ADS1263_GetStats(ADS1263_STATS* stats);
+[[gnu::dllexport]] extern "C" void ADS1263_ResetStats();
+
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_GetStats(ads1263_t* dev, ADS1263_STATS* stats);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_ResetStats(ads1263_t* dev);
+
+#pragma endregion
+
+#pragma region Convert
+
+/* per-channel calibration slots, a frame's channel selects slot Channel % ADS1263_CONVERT_CHANNELS */
+#define ADS1263_CONVERT_CHANNELS 16
+
+/**
+ * One RDATA1/RDATA2 frame as it came off the bus. The layout is the 7-byte
+ * receive buffer with the opcode slot holding the channel, padded to 8 bytes
+ * so a block can be loaded whole by the vector kernels.
+**/
+typedef struct
+{
+    UBYTE Channel;          // channel the conversion belongs to (the opcode slot on the wire)
+    UBYTE Status;           // ADS1263 status byte
+    UBYTE Data[4];          // MSB first; ADC2: Data[0..2], Data[3] is padding
+    UBYTE CRC;
+    UBYTE Reserved;
+}ADS1263_FRAME;
+
+typedef struct
+{
+    double Vref;            // reference voltage, e.g. 5.0 for AVDD-AVSS; 0: 5.0
+    double Gain;            // PGA gain; 0: 1
+    int32_t Offset;         // code read with the inputs shorted, subtracted before scaling
+    double Correction;      // gain error factor applied to the scale; 0: 1
+}ADS1263_CHANNEL_CAL;
+
+/**
+ * Scale tables built by ADS1263_Converter_Init
+**/
+typedef struct
+{
+    float ScaleF[ADS1263_CONVERT_CHANNELS];     // volts per code
+    float OffsetF[ADS1263_CONVERT_CHANNELS];    // code offset
+    double Scale[ADS1263_CONVERT_CHANNELS];
+    double Offset[ADS1263_CONVERT_CHANNELS];
+    UBYTE Adc;              // 1: 32-bit ADC1 codes, 2: 24-bit ADC2 codes
+}ADS1263_CONVERTER;
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Converter_Init(ADS1263_CONVERTER* conv, UBYTE Adc, const ADS1263_CHANNEL_CAL* Cal, int Number);
+[[gnu::dllexport]] extern "C" int ADS1263_DecodeFrames(const ADS1263_CONVERTER* conv, const ADS1263_FRAME* Frames, int Number,
+    int32_t* Code, float* Volts, double* VoltsD, UBYTE* Flags);
+[[gnu::dllexport]] extern "C" int ADS1263_DecodeFrames_Scalar(const ADS1263_CONVERTER* conv, const ADS1263_FRAME* Frames, int Number,
+    int32_t* Code, float* Volts, double* VoltsD, UBYTE* Flags);
+[[gnu::dllexport]] extern "C" void ADS1263_ConvertSamples(const ADS1263_CONVERTER* conv, const ADS1263_SAMPLE* Samples, int Number,
+    int32_t* Code, float* Volts, double* VoltsD);
+[[gnu::dllexport]] extern "C" const char* ADS1263_ConvertKernel();
+
+#pragma endregion
+
+#pragma region Decimate
+
+/**
+ * Host-side decimation of interleaved multi-channel codes: a CIC decimator
+ * (integer, exact), optional mains notches at the CIC output rate, then a
+ * linear-phase FIR that compensates the CIC droop, low-passes and decimates
+ * again. The vector kernels run across channels, so a frame of Channels
+ * codes is processed at once. All state is allocated by Create.
+ * Input is what ADS1263_ConvertSamples returns as Code for a gap-free scan:
+ * frame t holds channel c at Codes[t * Channels + c]. Output is in codes,
+ * as doubles; the converter's scale applies unchanged.
+**/
+#define ADS1263_DECIM_MAX_ORDER     5
+#define ADS1263_DECIM_MAX_TAPS      1023
+#define ADS1263_DECIM_MAX_NOTCHES   8
+
+typedef struct ADS1263_DECIMATOR ADS1263_DECIMATOR;
+
+typedef struct
+{
+    int Channels;           // codes per frame, 1..ADS1263_CONVERT_CHANNELS
+    double Rate;            // input frames per second
+    int CicOrder;           // 0: no CIC stage, else 1..ADS1263_DECIM_MAX_ORDER
+    int CicDecimation;      // R, with CicOrder * log2(R) <= 32; 0: 1
+    int FirTaps;            // 0: no FIR stage, else rounded up to odd
+    int FirDecimation;      // M, needs the FIR stage; 0: 1
+    double Cutoff;          // FIR passband edge in Hz; 0: 0.4 of the output rate
+    double NotchHz;         // mains frequency, 50 or 60; 0: no notch
+    int NotchHarmonics;     // also notch its multiples below Nyquist, up to this many in all; 0: 1
+    double NotchQ;          // 0: 30
+}ADS1263_DECIM_CONFIG;
+
+[[gnu::dllexport]] extern "C" ADS1263_DECIMATOR* ADS1263_Decimator_Create(const ADS1263_DECIM_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_Decimator_Destroy(ADS1263_DECIMATOR* dec);
+[[gnu::dllexport]] extern "C" void ADS1263_Decimator_Reset(ADS1263_DECIMATOR* dec);
+[[gnu::dllexport]] extern "C" double ADS1263_Decimator_Rate(const ADS1263_DECIMATOR* dec);
+[[gnu::dllexport]] extern "C" int ADS1263_Decimator_OutputFrames(const ADS1263_DECIMATOR* dec, int Frames);
+[[gnu::dllexport]] extern "C" int ADS1263_Decimator_Process(ADS1263_DECIMATOR* dec, const int32_t* Codes, int Frames, double* Out, int OutFrames);
+[[gnu::dllexport]] extern "C" int ADS1263_Decimator_Process_Scalar(ADS1263_DECIMATOR* dec, const int32_t* Codes, int Frames, double* Out, int OutFrames);
+
+#pragma endregion
+
+#pragma region Blocks
+
+/**
+ * Block delivery of a stream. The caller registers fixed-layout sample
+ * blocks in its own (pinned) memory; the acquisition thread writes each
+ * conversion straight into the current block and hands it over full, or
+ * earlier when FlushUs would otherwise be exceeded. A managed caller can
+ * view Samples[0..Count) in place, one native call per block.
+ * Handover: Callback on a delivery thread, or the eventfd from
+ * ADS1263_GetBlockFd polled by the caller, then ADS1263_GetBlock until NULL.
+ * Every block taken must be returned with ADS1263_ReleaseBlock.
+**/
+#define ADS1263_BLOCK_MAX 64
+
+/**
+ * One conversion, 32 bytes with no padding, fields in this order
+**/
+typedef struct
+{
+    uint64_t Timestamp;     // as ADS1263_SAMPLE
+    uint64_t Sequence;      // per ADC, as ADS1263_SAMPLE
+    double Volts;           // via the block converter of the sample's ADC
+    int32_t Raw;            // signed code
+    UBYTE Channel;
+    UBYTE Status;
+    UBYTE Flags;            // ADS1263_SAMPLE_*
+    UBYTE Reserved;
+}ADS1263_BLOCK_SAMPLE;
+
+typedef struct
+{
+    ADS1263_BLOCK_SAMPLE* Samples;  // caller memory, valid and fixed while the blocks are attached
+    UDOUBLE Capacity;       // samples
+    UDOUBLE Count;          // filled, valid once the block is delivered
+    uint64_t Index;         // delivery count, blocks are delivered in order
+    void* User;             // for the caller
+}ADS1263_BLOCK;
+
+typedef void (*ADS1263_BLOCK_CALLBACK)(ADS1263_BLOCK* Block, void* Arg);
+
+typedef struct
+{
+    ADS1263_BLOCK* Blocks;  // caller array, every block starts free
+    int Number;             // 1..ADS1263_BLOCK_MAX
+    UDOUBLE FlushUs;        // deliver a partly filled block before its first sample is older; 0: full blocks only
+    ADS1263_BLOCK_CALLBACK Callback;  // on the delivery thread, block released on return; NULL: ADS1263_GetBlock
+    void* Arg;
+    int Priority;           // SCHED_FIFO priority of the delivery thread, 0 keeps the default
+    const ADS1263_CONVERTER* Converter;   // ADC1 volts, NULL: 5 V reference, gain 1
+    const ADS1263_CONVERTER* Converter2;  // ADC2 volts, NULL: 5 V reference, gain 1
+}ADS1263_BLOCK_CONFIG;
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_AttachBlocks(const ADS1263_BLOCK_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_DetachBlocks();
+[[gnu::dllexport]] extern "C" int ADS1263_GetBlockFd();
+[[gnu::dllexport]] extern "C" ADS1263_BLOCK* ADS1263_GetBlock();
+[[gnu::dllexport]] extern "C" void ADS1263_ReleaseBlock(ADS1263_BLOCK* Block);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_GetBlockOverflows();
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_AttachBlocks(ads1263_t* dev, const ADS1263_BLOCK_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_DetachBlocks(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" int ADS1263_Dev_GetBlockFd(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" ADS1263_BLOCK* ADS1263_Dev_GetBlock(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_ReleaseBlock(ads1263_t* dev, ADS1263_BLOCK* Block);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_Dev_GetBlockOverflows(ads1263_t* dev);
+
+#pragma endregion
+
+#pragma region Shm
+
+/**
+ * Shared-memory sample bus. The process that owns the device publishes
+ * its stream into a shm_open()ed ring; any number of processes map it
+ * read-only and follow it without a syscall per sample.
+ *
+ * Layout: ADS1263_SHM_HEADER, then Capacity slots of ADS1263_SHM_SLOT at
+ * HeaderSize. Slot i % Capacity holds sample i. Its Seq is 2i+1 while the
+ * publisher writes it and 2i+2 once it is complete, so a reader that sees
+ * the same even value before and after copying has an intact sample i; any
+ * other value means the slot was overwritten (overrun). Head counts the
+ * samples published. Readers check Magic and Version, and take SlotSize
+ * and HeaderSize from the header rather than from their own build.
+**/
+#define ADS1263_SHM_MAGIC   0x4D485341      // "ASHM"
+#define ADS1263_SHM_VERSION 1
+
+/**
+ * Scale of one converter slot, volts = (Raw - Offset) * Scale as in the samples
+**/
+typedef struct
+{
+    double Scale;
+    double Offset;
+}ADS1263_SHM_CHANNEL;
+
+typedef struct
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t HeaderSize;    // offset of the first slot
+    uint32_t SlotSize;
+    uint64_t Capacity;      // slots, a power of two
+    uint32_t Publisher;     // pid
+    uint32_t State;         // 1 publishing, 0 stopped
+    uint64_t StartNs;       // CLOCK_MONOTONIC when publishing began
+    UBYTE Rate;             // ADS1263_DRATE of ADC1
+    UBYTE Rate2;            // ADS1263_ADC2_DRATE
+    UBYTE Reserved[6];
+    ADS1263_SHM_CHANNEL Meta[2][ADS1263_CONVERT_CHANNELS];  // [ADC1, ADC2][converter slot]
+    alignas(ADS1263_CACHE_LINE) uint64_t Head;  // samples published, written last
+}ADS1263_SHM_HEADER;
+
+typedef struct
+{
+    uint64_t Seq;           // seqlock, see above
+    ADS1263_BLOCK_SAMPLE Sample;
+}ADS1263_SHM_SLOT;
+
+typedef struct
+{
+    const char* Name;       // shm_open name, e.g. "/ads1263"
+    UDOUBLE Capacity;       // slots, rounded up to a power of two; 0: 65536
+    UDOUBLE Mode;           // permission bits of the segment, 0: 0644
+    const ADS1263_CONVERTER* Converter;   // ADC1 volts, NULL: 5 V reference, gain 1
+    const ADS1263_CONVERTER* Converter2;  // ADC2 volts, NULL: 5 V reference, gain 1
+}ADS1263_SHM_CONFIG;
+
+/**
+ * A reader's view of a published ring
+**/
+typedef struct
+{
+    const ADS1263_SHM_HEADER* Header;   // NULL: not open
+    size_t Size;
+    uint64_t Next;          // index of the next sample to read
+    uint64_t Overruns;      // samples lost because the publisher lapped the reader
+}ADS1263_SHM_READER;
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_StartPublish(const ADS1263_SHM_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_StopPublish();
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_StartPublish(ads1263_t* dev, const ADS1263_SHM_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_StopPublish(ads1263_t* dev);
+
+[[gnu::dllexport]] extern "C" int ADS1263_Shm_Open(ADS1263_SHM_READER* reader, const char* Name);
+[[gnu::dllexport]] extern "C" void ADS1263_Shm_Close(ADS1263_SHM_READER* reader);
+[[gnu::dllexport]] extern "C" int ADS1263_Shm_Read(ADS1263_SHM_READER* reader, ADS1263_BLOCK_SAMPLE* buf, int n);
+
+#pragma endregion
+
+#pragma region Record
+
+/**
+ * Append-only recording of a stream. Layout:
+ *   ADS1263_REC_HEADER
+ *   blocks: ADS1263_REC_BLOCK followed by Size bytes of encoded samples
+ *   at close: index entries, then ADS1263_REC_TRAILER as the last bytes
+ * Each block decodes on its own. A sample is a tag byte (channel, ADC,
+ * which optional bytes follow), the status byte if it changed, the flags
+ * byte if not 0, then three varints: the sequence step minus one, the
+ * timestamp step, and the code step from the previous sample of the same
+ * ADC and channel, the last two zigzag encoded. A recording cut short has
+ * no trailer; its blocks are still found by walking the block headers.
+**/
+#define ADS1263_REC_MAGIC           "ADS1263R"
+#define ADS1263_REC_VERSION         1
+#define ADS1263_REC_BLOCK_MAGIC     0x4B4C4241      // "ABLK"
+#define ADS1263_REC_INDEX_MAGIC     0x58444941      // "AIDX"
+#define ADS1263_REC_SAMPLE_MAX      28              // encoded bytes of one sample, worst case
+
+/* tag byte of an encoded sample */
+#define ADS1263_REC_TAG_CHANNEL     0x1f
+#define ADS1263_REC_TAG_ADC2        0x20
+#define ADS1263_REC_TAG_STATUS      0x40            // status byte follows
+#define ADS1263_REC_TAG_FLAGS       0x80            // flags byte follows
+
+typedef struct
+{
+    char Magic[8];          // ADS1263_REC_MAGIC, not terminated
+    uint32_t Version;
+    uint32_t HeaderSize;    // offset of the first block
+    uint64_t StartNs;       // CLOCK_MONOTONIC when recording began, the time base of the samples
+    uint64_t StartRealtime; // CLOCK_REALTIME ns at the same moment
+    uint32_t BlockSamples;
+    uint32_t IndexEvery;
+    UBYTE Regs[ADS1263_REG_COUNT];  // register map when recording began, REG_ID first
+    UBYTE Reserved;
+    uint32_t CRC;           // CRC-32 of the bytes before it
+}ADS1263_REC_HEADER;
+
+typedef struct
+{
+    uint32_t Magic;         // ADS1263_REC_BLOCK_MAGIC
+    uint32_t CRC;           // CRC-32 of the rest of this header and the payload
+    uint32_t Size;          // payload bytes
+    uint32_t Count;         // samples
+    uint64_t FirstTimestamp;
+    uint64_t LastTimestamp;
+    uint64_t FirstSequence[2];  // [ADC1, ADC2] first sequence of each ADC in the block
+}ADS1263_REC_BLOCK;
+
+/**
+ * One index entry per IndexEvery blocks
+**/
+typedef struct
+{
+    uint64_t Offset;        // of the block header
+    uint64_t FirstTimestamp;
+    uint64_t FirstSequence; // ADC1, as in the block
+}ADS1263_REC_INDEX;
+
+typedef struct
+{
+    uint64_t Offset;        // of the first index entry
+    uint64_t Count;         // index entries
+    uint64_t Blocks;
+    uint64_t Samples;
+    uint32_t Magic;         // ADS1263_REC_INDEX_MAGIC
+    uint32_t CRC;           // CRC-32 of the entries and the fields before it
+}ADS1263_REC_TRAILER;
+
+typedef struct
+{
+    const char* Path;       // created or truncated
+    UDOUBLE BlockSamples;   // samples per block, 0: 4096
+    UDOUBLE IndexEvery;     // blocks per index entry, 0: 16
+    UDOUBLE FlushMs;        // write a partly filled block once its first sample is older; 0: 1000
+    int Buffers;            // blocks in flight to the writer thread, 0: 8
+}ADS1263_REC_CONFIG;
+
+/**
+ * A reader's view of a recording, mapped read-only
+**/
+typedef struct
+{
+    const UBYTE* Base;      // NULL: not open
+    size_t Size;
+    const ADS1263_REC_HEADER* Header;
+    const ADS1263_REC_INDEX* Index;     // NULL: no trailer, seeking walks the blocks
+    uint64_t IndexCount;
+    uint64_t End;           // offset past the last block
+}ADS1263_REC_READER;
+
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_StartRecord(const ADS1263_REC_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_StopRecord();
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_GetRecordDrops();
+[[gnu::dllexport]] extern "C" UBYTE ADS1263_Dev_StartRecord(ads1263_t* dev, const ADS1263_REC_CONFIG* config);
+[[gnu::dllexport]] extern "C" void ADS1263_Dev_StopRecord(ads1263_t* dev);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_Dev_GetRecordDrops(ads1263_t* dev);
+
+[[gnu::dllexport]] extern "C" int ADS1263_Rec_Open(ADS1263_REC_READER* reader, const char* Path);
+[[gnu::dllexport]] extern "C" void ADS1263_Rec_Close(ADS1263_REC_READER* reader);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_Rec_First(const ADS1263_REC_READER* reader);
+[[gnu::dllexport]] extern "C" uint64_t ADS1263_Rec_Seek(const ADS1263_REC_READER* reader, uint64_t Timestamp);
+[[gnu::dllexport]] extern "C" int ADS1263_Rec_Decode(const ADS1263_REC_READER* reader, uint64_t Offset, ADS1263_SAMPLE* buf, int n, uint64_t* Next);
+
+#pragma endregion
+
+#pragma region SIM
+
+/**
+ * In-process ADS1263, DEV_BACKEND_SIM. Select it with DEV_SetBackend, or
+ * build with -DSIM to make it the default, and the DEV_* layer drives a
+ * simulated chip instead of spidev and GPIO: full
+ * command set, the 27-register map, conversions at the programmed data
+ * rate with DRDY timing, real checksums. Each port has its own chip.
+ *
+ * Timing follows CLOCK_MONOTONIC, so the driver waits as long as it would
+ * on hardware. Noise is drawn from the seed and the count of conversions
+ * read, so a given call sequence sees the same noise on every run.
+ *
+ * SIM_Replay makes the chip play back an ADS1263_StartRecord file instead:
+ * ADC1 DRDY falls at the recorded times (scaled by Speed), and a read returns
+ * the latest recorded code of the channel the mux selects, so GetChannalValue,
+ * GetAll and the streams all see the recorded data. Channels are matched the
+ * way ADS1263_SetMode numbers them; replay in the scan mode of the recording.
+**/
+#define SIM_INPUTS      11      // AIN0..AIN9, AINCOM
+#define SIM_CHIP_ID     0x23    // ADS1263, revision 3
+
+typedef enum
+{
+    SIM_WAVE_DC = 0,
+    SIM_WAVE_SINE,
+    SIM_WAVE_SQUARE,
+    SIM_WAVE_RAMP,          // sawtooth from Offset - Amplitude to Offset + Amplitude
+}SIM_WAVE;
+
+/**
+ * Signal on one analog input, in volts
+**/
+typedef struct
+{
+    SIM_WAVE Wave;
+    double Offset;
+    double Amplitude;       // peak
+    double Frequency;       // Hz
+    double Noise;           // gaussian, rms
+    double NoiseDensity;    // gaussian, V/sqrt(Hz): ADC1 sees it through its filter, less at lower data rates
+}SIM_INPUT;
+
+typedef struct
+{
+    UDOUBLE CrcErrorEvery;  // corrupt the checksum of every Nth data frame, 0: never
+    UBYTE StuckDRDY;        // DRDY never falls
+    UBYTE ChipID;           // REG_ID as read back, 0: SIM_CHIP_ID
+}SIM_FAULTS;
+
+typedef struct
+{
+    uint64_t Transactions;  // transfers, one per CS-framed command
+    uint64_t Bytes;
+    uint64_t Reads1;        // ADC1 data frames sent (RDATA1 or direct)
+    uint64_t Reads2;        // ADC2 data frames sent
+    uint64_t Overruns1;     // ADC1 conversions completed and never read
+    uint64_t Replayed;      // recorded ADC1 conversions read during a replay
+    UBYTE ReplayDone;       // the replay has served its last conversion
+}SIM_STATS;
+
+typedef struct
+{
+    const char* Path;       // recording from ADS1263_StartRecord
+    double Speed;           // 1.0 recorded timing, 100.0 a hundred times faster, 0: as fast as the driver reads
+    UBYTE Loop;             // start over after the last conversion, else DRDY stays high
+}SIM_REPLAY;
+
+typedef enum
+{
+    SIM_PIN_RST = 0,
+    SIM_PIN_CS,
+    SIM_PIN_DRDY,
+}SIM_PIN;
+
+[[gnu::dllexport]] extern "C" SIM_ADS1263* SIM_Create(uint64_t Seed);
+[[gnu::dllexport]] extern "C" void SIM_Destroy(SIM_ADS1263* sim);
+[[gnu::dllexport]] extern "C" SIM_ADS1263* SIM_GetDefault();
+[[gnu::dllexport]] extern "C" void SIM_SetInput(SIM_ADS1263* sim, int Input, const SIM_INPUT* input);
+[[gnu::dllexport]] extern "C" void SIM_SetFaults(SIM_ADS1263* sim, const SIM_FAULTS* faults);
+[[gnu::dllexport]] extern "C" void SIM_GetStats(SIM_ADS1263* sim, SIM_STATS* stats);
+[[gnu::dllexport]] extern "C" void SIM_ResetStats(SIM_ADS1263* sim);
+[[gnu::dllexport]] extern "C" UBYTE SIM_Replay(SIM_ADS1263* sim, const SIM_REPLAY* replay);
+
+[[gnu::dllexport]] extern "C" int SIM_Transfer(SIM_ADS1263* sim, const UBYTE* TxBuf, UBYTE* RxBuf, UDOUBLE Len);
+[[gnu::dllexport]] extern "C" void SIM_Pin_Write(SIM_ADS1263* sim, SIM_PIN Pin, UBYTE Value);
+[[gnu::dllexport]] extern "C" UBYTE SIM_Pin_Read(SIM_ADS1263* sim, SIM_PIN Pin);
+[[gnu::dllexport]] extern "C" int SIM_WaitDRDY(SIM_ADS1263* sim, uint64_t DeadlineNs, uint64_t* TimestampNs);
+
+#pragma endregion
@@ -1,7 +1,771 @@
+#include "ADS1263.hpp"
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/socket.h>
 
-int main()
+/**
+ * Acquisition benchmark. Build with -DSIM to run against the in-process
+ * chip, or with the platform defines to run on a board. One JSON object
+ * per line is written per case:
+ *   path, rate, channels, samples, samples_per_s,
+ *   latency_p50_ns, latency_p99_ns, latency_p999_ns, latency_basis,
+ *   transactions_per_sample, bytes_per_sample, syscalls_per_sample,
+ *   switches_per_sample, cpu_ns_per_sample
+ * latency_basis "drdy": DRDY edge to the data in the caller's hands,
+ * "call": one call of the function, for paths that have no DRDY edge.
+ * transactions_per_sample counts CS-framed transfers (one spidev ioctl
+ * each with USE_DEV_LIB), SIM builds only, -1 otherwise. bytes_per_sample
+ * is the SPI bytes the driver moved, from ADS1263_GetStats, and
+ * syscalls_per_sample the system calls it made, from DEV_GetSyscalls (a
+ * SIM build has no spidev or GPIO calls, only its sleeps and waits).
+ * SIM builds take -r to replay a recording as the input signal, -s for
+ * its speed (1 recorded timing, 0 as fast as the driver reads).
+ * ScanProfile tunes each channel first, its rate is "tuned".
+ * -c (--check) runs the self-checks instead, without a device, and
+ * exits non-zero if one fails.
+ * The Decimator cases run no device: samples counts channels x frames,
+ * so samples_per_s is the filter throughput in channel-samples per second.
+**/
+
+typedef struct
+{
+    const char* Path;
+    const char* Rate;
+    int Channels;
+    uint64_t Samples;
+    uint64_t Elapsed_ns;
+    uint64_t Cpu_ns;
+    uint64_t Transactions;
+    uint64_t Bytes;
+    uint64_t Syscalls;
+    long Switches;
+    std::vector<uint64_t> Latency;
+    const char* Basis;
+}BENCH_RESULT;
+
+typedef struct
+{
+    uint64_t Wall;
+    uint64_t Cpu;
+    uint64_t Transactions;
+    uint64_t Bytes;
+    uint64_t Syscalls;
+    long Switches;
+}BENCH_MARK;
+
+static uint64_t Bench_Case_ns = 500000000;     // -t: time per case
+static FILE* Bench_Out = NULL;
+static const char* Bench_Replay = NULL;         // -r: recording to replay
+static double Bench_Speed = 1.0;                // -s: its speed
+
+static const struct {
+    ADS1263_DRATE Rate;
+    const char* Name;
+} Bench_Rates[] = {
+    { ADS1263_400SPS, "400SPS" },
+    { ADS1263_1200SPS, "1200SPS" },
+    { ADS1263_7200SPS, "7200SPS" },
+    { ADS1263_38400SPS, "38400SPS" },
+};
+
+static const struct {
+    ADS1263_ADC2_DRATE Rate;
+    const char* Name;
+} Bench_Rates2[] = {
+    { ADS1263_ADC2_100SPS, "ADC2_100SPS" },
+    { ADS1263_ADC2_400SPS, "ADC2_400SPS" },
+    { ADS1263_ADC2_800SPS, "ADC2_800SPS" },
+};
+
+static const int Bench_Channels[] = { 1, 4, 10 };
+
+static void Bench_Mark(BENCH_MARK* mark)
+{
+    struct timespec ts;
+    struct rusage ru;
+    ADS1263_STATS driver;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    getrusage(RUSAGE_SELF, &ru);
+    mark->Wall = DEV_Time_ns();
+    mark->Cpu = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    mark->Switches = ru.ru_nvcsw + ru.ru_nivcsw;
+    ADS1263_GetStats(&driver);
+    mark->Bytes = driver.Bytes;
+    mark->Syscalls = DEV_GetSyscalls();
+#ifdef SIM
+    SIM_STATS stats;
+    SIM_GetStats(SIM_GetDefault(), &stats);
+    mark->Transactions = stats.Transactions;
+#else
+    mark->Transactions = 0;
+#endif
+}
+
+static void Bench_Begin(BENCH_RESULT* r, const char* Path, const char* Rate, int Channels, const char* Basis, BENCH_MARK* start)
+{
+    r->Path = Path;
+    r->Rate = Rate;
+    r->Channels = Channels;
+    r->Samples = 0;
+    r->Basis = Basis;
+    r->Latency.clear();
+    Bench_Mark(start);
+}
+
+static uint64_t Bench_Percentile(std::vector<uint64_t>& v, double p)
+{
+    if (v.empty()) {
+        return 0;
+    }
+    size_t i = (size_t)(p * (v.size() - 1) + 0.5);
+    return v[i];
+}
+
+static void Bench_End(BENCH_RESULT* r, const BENCH_MARK* start)
+{
+    BENCH_MARK end;
+    Bench_Mark(&end);
+    r->Elapsed_ns = end.Wall - start->Wall;
+    r->Cpu_ns = end.Cpu - start->Cpu;
+    r->Transactions = end.Transactions - start->Transactions;
+    r->Bytes = end.Bytes - start->Bytes;
+    r->Syscalls = end.Syscalls - start->Syscalls;
+    r->Switches = end.Switches - start->Switches;
+
+    double n = r->Samples != 0 ? (double)r->Samples : 1.0;
+    std::sort(r->Latency.begin(), r->Latency.end());
+    fprintf(Bench_Out, "{\"path\":\"%s\",\"rate\":\"%s\",\"channels\":%d,\"samples\":%llu,\"samples_per_s\":%.1f,"
+        "\"latency_p50_ns\":%llu,\"latency_p99_ns\":%llu,\"latency_p999_ns\":%llu,\"latency_basis\":\"%s\","
+        "\"transactions_per_sample\":%.3f,\"bytes_per_sample\":%.3f,\"syscalls_per_sample\":%.3f,\"switches_per_sample\":%.3f,\"cpu_ns_per_sample\":%.0f}\n",
+        r->Path, r->Rate, r->Channels, (unsigned long long)r->Samples, r->Samples * 1e9 / (r->Elapsed_ns ? r->Elapsed_ns : 1),
+        (unsigned long long)Bench_Percentile(r->Latency, 0.50), (unsigned long long)Bench_Percentile(r->Latency, 0.99),
+        (unsigned long long)Bench_Percentile(r->Latency, 0.999), r->Basis,
+#ifdef SIM
+        r->Transactions / n,
+#else
+        -1.0,
+#endif
+        r->Bytes / n, r->Syscalls / n, r->Switches / n, r->Cpu_ns / n);
+    fflush(Bench_Out);
+}
+
+/**
+ * ADS1263_GetChannalValue, one channel per call, rotating over the set
+**/
+static void Bench_GetChannalValue(const char* Rate, int Channels)
+{
+    BENCH_RESULT r;
+    BENCH_MARK start;
+    int ch = 0;
+
+    Bench_Begin(&r, "GetChannalValue", Rate, Channels, "drdy", &start);
+    while (DEV_Time_ns() - start.Wall < Bench_Case_ns) {
+        ADS1263_GetChannalValue(ch);
+        r.Latency.push_back(DEV_Time_ns() - ADS1263_GetDRDYTimestamp());
+        r.Samples++;
+        ch = (ch + 1) % Channels;
+    }
+    Bench_End(&r, &start);
+}
+
+/**
+ * ADS1263_GetAll; latency of the last channel of each scan
+**/
+static void Bench_GetAll(const char* Rate, int Channels)
+{
+    BENCH_RESULT r;
+    BENCH_MARK start;
+    UBYTE List[10];
+    UDOUBLE Value[10];
+    int i;
+
+    for (i = 0; i < Channels; i++)
+        List[i] = i;
+    Bench_Begin(&r, "GetAll", Rate, Channels, "drdy", &start);
+    while (DEV_Time_ns() - start.Wall < Bench_Case_ns) {
+        ADS1263_GetAll(List, Value, Channels);
+        r.Latency.push_back(DEV_Time_ns() - ADS1263_GetDRDYTimestamp());
+        r.Samples += Channels;
+    }
+    Bench_End(&r, &start);
+}
+
+/**
+ * ADS1263_GetAll_ADC2, all ten inputs per call
+**/
+static void Bench_GetAll_ADC2(const char* Rate)
+{
+    BENCH_RESULT r;
+    BENCH_MARK start;
+    UDOUBLE Value[10];
+
+    Bench_Begin(&r, "GetAll_ADC2", Rate, 10, "call", &start);
+    while (DEV_Time_ns() - start.Wall < Bench_Case_ns) {
+        uint64_t t = DEV_Time_ns();
+        ADS1263_GetAll_ADC2(Value);
+        r.Latency.push_back(DEV_Time_ns() - t);
+        r.Samples += 10;
+    }
+    Bench_End(&r, &start);
+}
+
+/**
+ * ADS1263_RTD; it reprograms ADC1 and runs one conversion per call
+**/
+static void Bench_RTD(const char* Rate, ADS1263_DRATE drate)
+{
+    BENCH_RESULT r;
+    BENCH_MARK start;
+
+    Bench_Begin(&r, "RTD", Rate, 1, "call", &start);
+    while (DEV_Time_ns() - start.Wall < Bench_Case_ns) {
+        uint64_t t = DEV_Time_ns();
+        ADS1263_RTD(ADS1263_DELAY_8d8ms, ADS1263_GAIN_1, drate);
+        r.Latency.push_back(DEV_Time_ns() - t);
+        r.Samples++;
+    }
+    Bench_End(&r, &start);
+}
+
+/**
+ * ADS1263_ScanProfile; the inputs carry a signal, which tuning counts as
+ * noise, so the target is one every setting meets and each channel runs
+ * at the fastest: the cost of switching rate and filter per channel.
+ * Latency of the last channel of each scan
+**/
+static void Bench_ScanProfile(int Channels)
+{
+    BENCH_RESULT r;
+    BENCH_MARK start;
+    ADS1263_TUNE_CONFIG config;
+    ADS1263_PROFILE profile;
+    UDOUBLE Value[10];
+    int i;
+
+    memset(&config, 0, sizeof(config));
+    for (i = 0; i < Channels; i++)
+        config.Channels[i] = i;
+    config.Number = Channels;
+    config.Enob = 4;
+    config.Samples = 32;
+    if (ADS1263_TuneProfile(&config, &profile) != 0) {
+        return;
+    }
+
+    Bench_Begin(&r, "ScanProfile", "tuned", Channels, "drdy", &start);
+    while (DEV_Time_ns() - start.Wall < Bench_Case_ns) {
+        ADS1263_ScanProfile(&profile, Value, NULL);
+        r.Latency.push_back(DEV_Time_ns() - ADS1263_GetDRDYTimestamp());
+        r.Samples += Channels;
+    }
+    Bench_End(&r, &start);
+}
+
+/**
+ * ADS1263_StartStream, drained the way an application would: a poll
+ * every 100 us, so the latency includes up to one poll interval
+**/
+static void Bench_Stream(const char* Rate, int Channels, ADS1263_READ_MODE Mode)
+{
+    BENCH_RESULT r;
+    BENCH_MARK start;
+    ADS1263_STREAM_CONFIG config;
+    ADS1263_SAMPLE buf[256];
+    int i, n;
+
+    memset(&config, 0, sizeof(config));
+    for (i = 0; i < Channels; i++)
+        config.Channels[i] = i;
+    config.Number = Channels;
+    config.Capacity = 65536;
+
+    ADS1263_SetReadMode(Mode, 1, 1);
+    Bench_Begin(&r, Mode == ADS1263_READ_DIRECT ? "Stream_Direct" : "Stream", Rate, Channels, "drdy", &start);
+    if (ADS1263_StartStream(&config) != 0) {
+        ADS1263_SetReadMode(ADS1263_READ_RDATA, 1, 1);
+        return;
+    }
+    while (DEV_Time_ns() - start.Wall < Bench_Case_ns) {
+        n = ADS1263_ReadSamples(buf, 256);
+        uint64_t now = DEV_Time_ns();
+        for (i = 0; i < n; i++)
+            r.Latency.push_back(now - buf[i].Timestamp);
+        r.Samples += n;
+        if (n == 0)
+            DEV_Delay_us(100);
+    }
+    ADS1263_StopStream();
+    Bench_End(&r, &start);
+    ADS1263_SetReadMode(ADS1263_READ_RDATA, 1, 1);
+}
+
+/**
+ * ADS1263_Decimator_Process on synthetic codes, 4096 frames per call:
+ * CIC order 4 by 16, 63-tap FIR by 4, notches at 50/100/150 Hz
+**/
+static void Bench_Decimator(int Channels, UBYTE Vector)
+{
+    BENCH_RESULT r;
+    BENCH_MARK start;
+    ADS1263_DECIM_CONFIG config;
+    ADS1263_DECIMATOR* dec;
+    const int Frames = 4096;
+    std::vector<int32_t> Codes(Frames * Channels);
+    std::vector<double> Out(Frames * Channels);
+    size_t i;
+
+    memset(&config, 0, sizeof(config));
+    config.Channels = Channels;
+    config.Rate = 38400;
+    config.CicOrder = 4;
+    config.CicDecimation = 16;
+    config.FirTaps = 63;
+    config.FirDecimation = 4;
+    config.NotchHz = 50;
+    config.NotchHarmonics = 3;
+    dec = ADS1263_Decimator_Create(&config);
+    if (dec == NULL) {
+        return;
+    }
+    for (i = 0; i < Codes.size(); i++)
+        Codes[i] = (int32_t)(i * 2654435761u);
+
+    Bench_Begin(&r, Vector ? "Decimator" : "Decimator_Scalar", "38400SPS/64", Channels, "call", &start);
+    while (DEV_Time_ns() - start.Wall < Bench_Case_ns) {
+        uint64_t t = DEV_Time_ns();
+        if (Vector)
+            ADS1263_Decimator_Process(dec, Codes.data(), Frames, Out.data(), Frames);
+        else
+            ADS1263_Decimator_Process_Scalar(dec, Codes.data(), Frames, Out.data(), Frames);
+        r.Latency.push_back(DEV_Time_ns() - t);
+        r.Samples += (uint64_t)Frames * Channels;
+    }
+    Bench_End(&r, &start);
+    ADS1263_Decimator_Destroy(dec);
+}
+
+static int Check_Failed = 0;
+
+static void Check(int Ok, const char* What)
+{
+    printf("%s %s \r\n", Ok ? "ok  " : "FAIL", What);
+    if (!Ok)
+        Check_Failed++;
+}
+
+static void Check_Event(int Fd, uint32_t Id, uint64_t Timestamp)
+{
+    struct gpio_v2_line_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.id = Id;
+    event.timestamp_ns = Timestamp;
+    if (write(Fd, &event, sizeof(event)) != sizeof(event))
+        printf("event write failed \r\n");
+}
+
+/**
+ * GPIOCHIP wait on a socketpair standing in for the DRDY line request
+**/
+static void Check_Gpiochip()
+{
+    uint64_t ts = 0;
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0) {
+        Check(0, "gpiochip socketpair");
+        return;
+    }
+    GPIOCHIP_AttachEventFd(sv[0]);
+
+    // a late reader: the last queued falling edge is the DRDY time
+    Check_Event(sv[1], GPIO_V2_LINE_EVENT_FALLING_EDGE, 1000);
+    Check_Event(sv[1], GPIO_V2_LINE_EVENT_FALLING_EDGE, 2000);
+    Check_Event(sv[1], GPIO_V2_LINE_EVENT_RISING_EDGE, 2500);
+    Check(GPIOCHIP_WaitLow(DEV_DRDY_PIN, DEV_Time_ns() + 10000000, &ts) == 0 && ts == 2000,
+        "gpiochip queued edge keeps its kernel timestamp");
+
+    Check(GPIOCHIP_WaitLow(DEV_DRDY_PIN, DEV_Time_ns() + 5000000, &ts) == 1, "gpiochip times out without an edge");
+
+    std::thread edge([&]() {
+        DEV_Delay_ms(5);
+        Check_Event(sv[1], GPIO_V2_LINE_EVENT_FALLING_EDGE, 3000);
+    });
+    Check(GPIOCHIP_WaitLow(DEV_DRDY_PIN, DEV_Time_ns() + 1000000000, &ts) == 0 && ts == 3000,
+        "gpiochip wakes on a later edge");
+    edge.join();
+
+    GPIOCHIP_AttachEventFd(-1);
+    close(sv[1]);
+}
+
+/**
+ * GPIOMEM register logic on a register image file: GPFSEL fields,
+ * GPSET/GPCLR words of both banks, GPLEV bits
+**/
+static void Check_Gpiomem()
+{
+    char path[] = "/tmp/ads1263-gpiomem-XXXXXX";
+    uint32_t regs[GPIOMEM_BLOCK_SIZE / 4];
+    GPIOMEM_MAP map = { NULL, -1, GPIOMEM_LAYOUT_AUTO, 0 };
+    int fd = mkstemp(path), ok;
+
+    if (fd < 0) {
+        Check(0, "gpiomem image file");
+        return;
+    }
+    // every GPFSEL1 field set, so a read-modify-write that spills over shows;
+    // GPLEV: pins 17 and 40 high
+    memset(regs, 0, sizeof(regs));
+    regs[GPIOMEM_GPFSEL0 / 4 + 1] = 0x3fffffff;
+    regs[GPIOMEM_GPLEV0 / 4] = 1u << 17;
+    regs[GPIOMEM_GPLEV0 / 4 + 1] = 1u << (40 - 32);
+    ok = write(fd, regs, sizeof(regs)) == (ssize_t)sizeof(regs);
+    Check(ok && GPIOMEM_Map_Open(&map, path, GPIOMEM_LAYOUT_AUTO) == 0 && map.image, "gpiomem maps a register image");
+    if (map.base == NULL) {
+        close(fd);
+        unlink(path);
+        return;
+    }
+
+    ok = GPIOMEM_Map_Mode(&map, 17, 1) == 0 && GPIOMEM_Map_Mode(&map, 18, 0) == 0
+        && GPIOMEM_Map_Mode(&map, 22, 1) == 0 && GPIOMEM_Map_Mode(&map, 40, 1) == 0;
+    Check(ok && GPIOMEM_Map_Mode(&map, GPIOMEM_MAX_PIN, 1) < 0, "gpiomem mode accepts pins 0..53 only");
+    ok = GPIOMEM_Map_Write(&map, 22, 1) == 0 && GPIOMEM_Map_Write(&map, 17, 0) == 0 && GPIOMEM_Map_Write(&map, 40, 1) == 0;
+    Check(ok && GPIOMEM_Map_Read(&map, 17) == 1 && GPIOMEM_Map_Read(&map, 18) == 0 && GPIOMEM_Map_Read(&map, 40) == 1
+        && GPIOMEM_Map_Read(&map, 41) == 0, "gpiomem reads the GPLEV bits of both banks");
+    GPIOMEM_Map_Close(&map);
+
+    ok = pread(fd, regs, sizeof(regs), 0) == (ssize_t)sizeof(regs);
+    // GPFSEL1: pin 17 output (field 7), pin 18 input (field 8), the rest untouched
+    Check(ok && regs[GPIOMEM_GPFSEL0 / 4 + 1] == ((0x3fffffffu & ~(7u << 21) & ~(7u << 24)) | (1u << 21)),
+        "gpiomem GPFSEL1 fields of pins 17 and 18 only");
+    Check(ok && regs[GPIOMEM_GPFSEL0 / 4 + 2] == 1u << 6 && regs[GPIOMEM_GPFSEL0 / 4 + 4] == 1u,
+        "gpiomem GPFSEL2 and GPFSEL4 fields of pins 22 and 40");
+    Check(ok && regs[GPIOMEM_GPSET0 / 4] == 1u << 22 && regs[GPIOMEM_GPCLR0 / 4] == 1u << 17
+        && regs[GPIOMEM_GPSET0 / 4 + 1] == 1u << (40 - 32) && regs[GPIOMEM_GPCLR0 / 4 + 1] == 0,
+        "gpiomem GPSET0, GPCLR0 and GPSET1 words");
+    close(fd);
+    unlink(path);
+}
+
+/**
+ * Random frame with a good checksum and ready status, Bad: 1 corrupts the
+ * checksum, 2 clears the ready bit
+**/
+static void Check_Frame(ADS1263_FRAME* Frame, UBYTE Adc, int Bad)
+{
+    int i;
+
+    memset(Frame, 0, sizeof(*Frame));
+    Frame->Channel = (UBYTE)rand();
+    Frame->Status = (UBYTE)rand() | (Adc == 2 ? 0x80 : 0x40);
+    for (i = 0; i < (Adc == 2 ? 3 : 4); i++)
+        Frame->Data[i] = (UBYTE)rand();
+    Frame->CRC = Frame->Data[0] + Frame->Data[1] + Frame->Data[2] + Frame->Data[3] + 0x9b;
+    if (Bad == 1)
+        Frame->CRC ^= 1 << (rand() % 8);
+    else if (Bad == 2)
+        Frame->Status &= Adc == 2 ? 0x7f : 0xbf;
+}
+
+/**
+ * Vector decode against the scalar reference, bit for bit, on lengths that
+ * leave every possible tail, and ADS1263_ConvertSamples against both
+**/
+static void Check_Convert()
+{
+    static const int Lengths[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 17, 31, 255, 256, 257, 1000, 1023 };
+    ADS1263_CHANNEL_CAL cal[ADS1263_CONVERT_CHANNELS];
+    ADS1263_CONVERTER conv;
+    char what[96];
+    UBYTE Adc;
+    size_t l;
+    int i;
+
+    srand(1263);
+    for (i = 0; i < ADS1263_CONVERT_CHANNELS; i++) {
+        cal[i].Vref = 2.5 + (rand() % 1000) / 400.0;
+        cal[i].Gain = 1 << (rand() % 6);
+        cal[i].Offset = rand() % 20001 - 10000;
+        cal[i].Correction = 0.99 + (rand() % 1000) / 50000.0;
+    }
+    for (Adc = 1; Adc <= 2; Adc++) {
+        // ADC2 leaves half the slots at their defaults
+        ADS1263_Converter_Init(&conv, Adc, cal, Adc == 1 ? ADS1263_CONVERT_CHANNELS : ADS1263_CONVERT_CHANNELS / 2);
+        for (l = 0; l < sizeof(Lengths) / sizeof(Lengths[0]); l++) {
+            int n = Lengths[l], flagged = 0, bad[2];
+            std::vector<ADS1263_FRAME> frames(n);
+            std::vector<ADS1263_SAMPLE> samples(n);
+            std::vector<int32_t> code[3] = { std::vector<int32_t>(n), std::vector<int32_t>(n), std::vector<int32_t>(n) };
+            std::vector<float> volts[3] = { std::vector<float>(n), std::vector<float>(n), std::vector<float>(n) };
+            std::vector<double> voltsd[3] = { std::vector<double>(n), std::vector<double>(n), std::vector<double>(n) };
+            std::vector<UBYTE> flags[2] = { std::vector<UBYTE>(n), std::vector<UBYTE>(n) };
+
+            for (i = 0; i < n; i++) {
+                int Bad = rand() % 8 == 0 ? 1 + rand() % 2 : 0;
+                Check_Frame(&frames[i], Adc, Bad);
+                flagged += Bad != 0;
+                samples[i].Channel = frames[i].Channel;
+                samples[i].Value = ((UDOUBLE)frames[i].Data[0] << 24) | ((UDOUBLE)frames[i].Data[1] << 16)
+                    | ((UDOUBLE)frames[i].Data[2] << 8) | frames[i].Data[3];
+                if (Adc == 2)
+                    samples[i].Value >>= 8;
+            }
+            bad[0] = ADS1263_DecodeFrames(&conv, frames.data(), n, code[0].data(), volts[0].data(), voltsd[0].data(), flags[0].data());
+            bad[1] = ADS1263_DecodeFrames_Scalar(&conv, frames.data(), n, code[1].data(), volts[1].data(), voltsd[1].data(), flags[1].data());
+            ADS1263_ConvertSamples(&conv, samples.data(), n, code[2].data(), volts[2].data(), voltsd[2].data());
+
+            snprintf(what, sizeof(what), "convert %s ADC%d %d frames, %d flagged", ADS1263_ConvertKernel(), Adc, n, flagged);
+            Check(bad[0] == flagged && bad[1] == flagged
+                && flags[0] == flags[1]
+                && code[0] == code[1] && code[2] == code[1]
+                && memcmp(volts[0].data(), volts[1].data(), n * sizeof(float)) == 0
+                && memcmp(volts[2].data(), volts[1].data(), n * sizeof(float)) == 0
+                && memcmp(voltsd[0].data(), voltsd[1].data(), n * sizeof(double)) == 0
+                && memcmp(voltsd[2].data(), voltsd[1].data(), n * sizeof(double)) == 0, what);
+        }
+    }
+}
+
+/**
+ * Vector decimator against the scalar reference, bit for bit, fed the same
+ * random codes in uneven chunks
+**/
+static void Check_Decimator()
+{
+    static const struct {
+        int Channels, CicOrder, CicDecimation, FirTaps, FirDecimation;
+        double NotchHz;
+    } Cases[] = {
+        { 1, 4, 16, 63, 4, 50 },
+        { 3, 3, 8, 31, 2, 60 },
+        { 4, 0, 1, 63, 4, 50 },
+        { 5, 5, 4, 0, 1, 50 },
+        { 8, 4, 16, 63, 4, 0 },
+        { 10, 2, 32, 127, 8, 60 },
+        { 16, 4, 16, 63, 4, 50 },
+    };
+    char what[96];
+    size_t k;
+    int i;
+
+    srand(263);
+    for (k = 0; k < sizeof(Cases) / sizeof(Cases[0]); k++) {
+        ADS1263_DECIM_CONFIG config;
+        ADS1263_DECIMATOR* dec[2];
+        const int Frames = 8192, Chunk = 37;
+        int C = Cases[k].Channels, done, n[2] = { 0, 0 };
+
+        memset(&config, 0, sizeof(config));
+        config.Channels = C;
+        config.Rate = 38400;
+        config.CicOrder = Cases[k].CicOrder;
+        config.CicDecimation = Cases[k].CicDecimation;
+        config.FirTaps = Cases[k].FirTaps;
+        config.FirDecimation = Cases[k].FirDecimation;
+        config.NotchHz = Cases[k].NotchHz;
+        config.NotchHarmonics = 3;
+        dec[0] = ADS1263_Decimator_Create(&config);
+        dec[1] = ADS1263_Decimator_Create(&config);
+        if (dec[0] == NULL || dec[1] == NULL) {
+            Check(0, "decimator create");
+            ADS1263_Decimator_Destroy(dec[0]);
+            ADS1263_Decimator_Destroy(dec[1]);
+            continue;
+        }
+
+        std::vector<int32_t> codes((size_t)Frames * C);
+        std::vector<double> out[2] = { std::vector<double>((size_t)Frames * C), std::vector<double>((size_t)Frames * C) };
+        for (i = 0; i < Frames * C; i++)
+            codes[i] = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand()) >> (rand() % 8);
+        for (done = 0; done < Frames; done += Chunk) {
+            int f = Frames - done < Chunk ? Frames - done : Chunk;
+            n[0] += ADS1263_Decimator_Process(dec[0], &codes[(size_t)done * C], f, &out[0][(size_t)n[0] * C], Frames - n[0]);
+            n[1] += ADS1263_Decimator_Process_Scalar(dec[1], &codes[(size_t)done * C], f, &out[1][(size_t)n[1] * C], Frames - n[1]);
+        }
+
+        snprintf(what, sizeof(what), "decimator %s %d channels, CIC %d/%d, FIR %d/%d, notch %.0f Hz, %d outputs",
+            ADS1263_ConvertKernel(), C, Cases[k].CicOrder, Cases[k].CicDecimation, Cases[k].FirTaps, Cases[k].FirDecimation,
+            Cases[k].NotchHz, n[0]);
+        Check(n[0] > 0 && n[0] == n[1] && memcmp(out[0].data(), out[1].data(), (size_t)n[0] * C * sizeof(double)) == 0, what);
+        ADS1263_Decimator_Destroy(dec[0]);
+        ADS1263_Decimator_Destroy(dec[1]);
+    }
+}
+
+#ifdef SIM
+/**
+ * An ADC1 reader and an ADC2 reader on one handle, each frame through a
+ * DEV_Bus: every code must be the one of the channel asked for
+**/
+static void Check_Bus()
+{
+    static const double Volts[4] = { 0.5, 1.0, 1.5, 2.0 };
+    ADS1263_PORT_CONFIG config;
+    SIM_INPUT input;
+    SIM_ADS1263* sim = SIM_Create(1);
+    DEV_BUS* bus = DEV_Bus_Create(0);
+    ads1263_t* dev = NULL;
+    UDOUBLE ref[4];
+    int bad[2] = { 0, 0 }, i;
+
+    memset(&config, 0, sizeof(config));
+    config.Backend = DEV_BACKEND_SIM;
+    config.RstPin = 18;
+    config.CsPin = 22;
+    config.DrdyPin = 17;
+    config.Sim = sim;
+    config.Bus = bus;
+    if (sim != NULL && bus != NULL)
+        dev = ADS1263_Open(&config);
+    if (dev == NULL || ADS1263_Dev_init_Dual(dev, ADS1263_7200SPS, ADS1263_ADC2_400SPS) != 0) {
+        Check(0, "bus handle open");
+    }
+    else {
+        memset(&input, 0, sizeof(input));
+        for (i = 0; i < 4; i++) {
+            input.Offset = Volts[i];
+            SIM_SetInput(sim, i, &input);
+        }
+        // ADC1 reads AIN0 and AIN2, ADC2 AIN1 and AIN3: a mux write lost or
+        // crossed between the threads shows up as another channel's code
+        for (i = 0; i < 4; i++)
+            ref[i] = i % 2 ? ADS1263_Dev_GetChannalValue_ADC2(dev, i) : ADS1263_Dev_GetChannalValue(dev, i);
+
+        std::thread adc2([&]() {
+            for (int k = 0; k < 40; k++) {
+                int ch = k % 2 ? 3 : 1;
+                if (llabs((long long)ADS1263_Dev_GetChannalValue_ADC2(dev, ch) - (long long)ref[ch]) > (long long)(ref[ch] / 100))
+                    bad[1]++;
+            }
+        });
+        for (i = 0; i < 400; i++) {
+            int ch = i % 2 ? 2 : 0;
+            if (llabs((long long)ADS1263_Dev_GetChannalValue(dev, ch) - (long long)ref[ch]) > (long long)(ref[ch] / 100))
+                bad[0]++;
+        }
+        adc2.join();
+        Check(ref[0] != ref[2] && ref[1] != ref[3] && bad[0] == 0 && bad[1] == 0,
+            "bus ADC1 and ADC2 threads on one handle read their own channels");
+    }
+    ADS1263_Close(dev);
+    DEV_Bus_Destroy(bus);
+    SIM_Destroy(sim);
+}
+#endif
+
+static int Check_All()
+{
+    Check_Gpiochip();
+    Check_Gpiomem();
+    Check_Convert();
+    Check_Decimator();
+#ifdef SIM
+    Check_Bus();
+#endif
+    printf("%d check(s) failed \r\n", Check_Failed);
+    return Check_Failed != 0;
+}
+
+static void Bench_Usage(const char* Name)
 {
+    printf("usage: %s [-t ms per case] [-o results.jsonl] [-r recording] [-s speed] [-c] \r\n", Name);
+}
+
+int main(int argc, char** argv)
+{
+    const char* out = NULL;
+    static const struct option longopts[] = {
+        { "check", no_argument, NULL, 'c' },
+        { NULL, 0, NULL, 0 },
+    };
+    size_t i, j;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "t:o:r:s:ch", longopts, NULL)) != -1) {
+        if (opt == 'c') {
+            return Check_All();
+        }
+        else if (opt == 't') {
+            Bench_Case_ns = (uint64_t)atol(optarg) * 1000000ull;
+        }
+        else if (opt == 'o') {
+            out = optarg;
+        }
+        else if (opt == 'r') {
+            Bench_Replay = optarg;
+        }
+        else if (opt == 's') {
+            Bench_Speed = atof(optarg);
+        }
+        else {
+            Bench_Usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    // the driver reports on stdout, so results go to their own stream
+    Bench_Out = out != NULL ? fopen(out, "w") : stderr;
+    if (Bench_Out == NULL) {
+        printf("Open %s failed \r\n", out);
+        return 1;
+    }
+
+    if (DEV_Module_Init() != 0) {
+        return 1;
+    }
+#ifdef SIM
+    SIM_INPUT input = { SIM_WAVE_SINE, 0.5, 0.25, 50.0, 0.00001, 0 };
+    for (i = 0; i < SIM_INPUTS; i++)
+        SIM_SetInput(SIM_GetDefault(), i, &input);
+    if (Bench_Replay != NULL) {
+        SIM_REPLAY replay = { Bench_Replay, Bench_Speed, 1 };
+        if (SIM_Replay(SIM_GetDefault(), &replay) != 0) {
+            DEV_Module_Exit();
+            return 1;
+        }
+    }
+#endif
+    ADS1263_SetMode(0);
+
+    for (i = 0; i < sizeof(Bench_Rates) / sizeof(Bench_Rates[0]); i++) {
+        if (ADS1263_init_ADC1(Bench_Rates[i].Rate) != 0) {
+            printf("init ADC1 failed \r\n");
+            break;
+        }
+        for (j = 0; j < sizeof(Bench_Channels) / sizeof(Bench_Channels[0]); j++) {
+            Bench_GetChannalValue(Bench_Rates[i].Name, Bench_Channels[j]);
+            Bench_GetAll(Bench_Rates[i].Name, Bench_Channels[j]);
+            Bench_Stream(Bench_Rates[i].Name, Bench_Channels[j], ADS1263_READ_RDATA);
+            Bench_Stream(Bench_Rates[i].Name, Bench_Channels[j], ADS1263_READ_DIRECT);
+        }
+        Bench_RTD(Bench_Rates[i].Name, Bench_Rates[i].Rate);
+    }
+
+    // RTD leaves ADC1 set up for itself
+    if (ADS1263_init_ADC1(ADS1263_38400SPS) == 0) {
+        for (j = 0; j < sizeof(Bench_Channels) / sizeof(Bench_Channels[0]); j++)
+            Bench_ScanProfile(Bench_Channels[j]);
+    }
+
+    for (i = 0; i < sizeof(Bench_Rates2) / sizeof(Bench_Rates2[0]); i++) {
+        if (ADS1263_init_ADC2(Bench_Rates2[i].Rate) != 0) {
+            printf("init ADC2 failed \r\n");
+            break;
+        }
+        Bench_GetAll_ADC2(Bench_Rates2[i].Name);
+    }
+
+    for (j = 0; j < sizeof(Bench_Channels) / sizeof(Bench_Channels[0]); j++) {
+        Bench_Decimator(Bench_Channels[j], 1);
+        Bench_Decimator(Bench_Channels[j], 0);
+    }
 
-	return 0;
-}
\ No newline at end of file
+    DEV_Module_Exit();
+    if (Bench_Out != stderr)
+        fclose(Bench_Out);
+    return 0;
+}